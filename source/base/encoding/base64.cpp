@@ -0,0 +1,114 @@
+#include "base64.hpp"
+
+namespace encoding::base64 {
+
+static char constexpr Alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static uint8_t constexpr Invalid = 0xFF;
+
+struct Decode_table {
+    constexpr Decode_table() noexcept : values{} {
+        for (uint32_t i = 0; i < 256; ++i) {
+            values[i] = Invalid;
+        }
+
+        for (uint32_t i = 0; i < 64; ++i) {
+            values[uint8_t(Alphabet[i])] = uint8_t(i);
+        }
+    }
+
+    uint8_t values[256];
+};
+
+static Decode_table constexpr Table;
+
+uint64_t encoded_size(uint64_t num_bytes) noexcept {
+    return ((num_bytes + 2) / 3) * 4;
+}
+
+void encode(uint8_t const* data, uint64_t num_bytes, std::string& text) noexcept {
+    uint64_t const start = text.size();
+
+    text.resize(start + encoded_size(num_bytes));
+
+    char* out = text.data() + start;
+
+    uint64_t i = 0;
+
+    for (; i + 3 <= num_bytes; i += 3, out += 4) {
+        uint32_t const v = (uint32_t(data[i]) << 16) | (uint32_t(data[i + 1]) << 8) |
+                           uint32_t(data[i + 2]);
+
+        out[0] = Alphabet[(v >> 18) & 0x3F];
+        out[1] = Alphabet[(v >> 12) & 0x3F];
+        out[2] = Alphabet[(v >> 6) & 0x3F];
+        out[3] = Alphabet[v & 0x3F];
+    }
+
+    if (uint64_t const rest = num_bytes - i; rest > 0) {
+        uint32_t v = uint32_t(data[i]) << 16;
+
+        if (2 == rest) {
+            v |= uint32_t(data[i + 1]) << 8;
+        }
+
+        out[0] = Alphabet[(v >> 18) & 0x3F];
+        out[1] = Alphabet[(v >> 12) & 0x3F];
+        out[2] = 2 == rest ? Alphabet[(v >> 6) & 0x3F] : '=';
+        out[3] = '=';
+    }
+}
+
+uint64_t decoded_size(uint64_t text_length) noexcept {
+    return (text_length / 4) * 3;
+}
+
+uint64_t decode(char const* text, uint64_t text_length, uint8_t* buffer) noexcept {
+    if (0 != text_length % 4) {
+        return 0;
+    }
+
+    uint64_t num_bytes = 0;
+
+    for (uint64_t i = 0; i < text_length; i += 4) {
+        uint8_t const a = Table.values[uint8_t(text[i])];
+        uint8_t const b = Table.values[uint8_t(text[i + 1])];
+
+        if (Invalid == (a | b)) {
+            return 0;
+        }
+
+        buffer[num_bytes++] = uint8_t((a << 2) | (b >> 4));
+
+        bool const last = i + 4 == text_length;
+
+        if (last && '=' == text[i + 2]) {
+            return '=' == text[i + 3] ? num_bytes : 0;
+        }
+
+        uint8_t const c = Table.values[uint8_t(text[i + 2])];
+
+        if (Invalid == c) {
+            return 0;
+        }
+
+        buffer[num_bytes++] = uint8_t((b << 4) | (c >> 2));
+
+        if (last && '=' == text[i + 3]) {
+            return num_bytes;
+        }
+
+        uint8_t const d = Table.values[uint8_t(text[i + 3])];
+
+        if (Invalid == d) {
+            return 0;
+        }
+
+        buffer[num_bytes++] = uint8_t((c << 6) | d);
+    }
+
+    return num_bytes;
+}
+
+}  // namespace encoding::base64
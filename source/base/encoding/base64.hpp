@@ -0,0 +1,22 @@
+#ifndef SU_BASE_ENCODING_BASE64_HPP
+#define SU_BASE_ENCODING_BASE64_HPP
+
+#include <cstdint>
+#include <string>
+
+namespace encoding::base64 {
+
+// Standard alphabet with '=' padding, RFC 4648
+uint64_t encoded_size(uint64_t num_bytes) noexcept;
+
+void encode(uint8_t const* data, uint64_t num_bytes, std::string& text) noexcept;
+
+// Upper bound, exact when the text carries no padding
+uint64_t decoded_size(uint64_t text_length) noexcept;
+
+// Returns the number of bytes written to buffer, or 0 for malformed text
+uint64_t decode(char const* text, uint64_t text_length, uint8_t* buffer) noexcept;
+
+}  // namespace encoding::base64
+
+#endif
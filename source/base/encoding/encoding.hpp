@@ -0,0 +1,126 @@
+#ifndef SU_BASE_ENCODING_ENCODING_HPP
+#define SU_BASE_ENCODING_ENCODING_HPP
+
+#include "math/quaternion.hpp"
+#include "math/vector2.inl"
+#include "math/vector3.inl"
+#include "math/vector4.inl"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace encoding {
+
+static inline int16_t snorm16(float x) noexcept {
+    return int16_t(std::lrint(std::clamp(x, -1.f, 1.f) * 32767.f));
+}
+
+static inline float snorm16_to_float(int16_t x) noexcept {
+    return std::max(float(x) / 32767.f, -1.f);
+}
+
+static inline uint32_t unorm(float x, uint32_t num_bits) noexcept {
+    float const max = float((1u << num_bits) - 1);
+    return uint32_t(std::lrint(std::clamp(x, 0.f, 1.f) * max));
+}
+
+static inline float unorm_to_float(uint32_t x, uint32_t num_bits) noexcept {
+    return float(x) / float((1u << num_bits) - 1);
+}
+
+// Unit vector to [-1, 1]^2
+// http://jcgt.org/published/0003/02/01/
+static inline float2 octahedral(float3 const& v) noexcept {
+    float const  s = std::abs(v[0]) + std::abs(v[1]) + std::abs(v[2]);
+    float2 const p(v[0] / s, v[1] / s);
+
+    if (v[2] < 0.f) {
+        return float2((1.f - std::abs(p[1])) * std::copysign(1.f, p[0]),
+                      (1.f - std::abs(p[0])) * std::copysign(1.f, p[1]));
+    }
+
+    return p;
+}
+
+static inline float3 octahedral_to_float3(float2 const& p) noexcept {
+    float3 v(p[0], p[1], 1.f - std::abs(p[0]) - std::abs(p[1]));
+
+    if (v[2] < 0.f) {
+        float const x = v[0];
+
+        v[0] = (1.f - std::abs(v[1])) * std::copysign(1.f, x);
+        v[1] = (1.f - std::abs(x)) * std::copysign(1.f, v[1]);
+    }
+
+    return math::normalize(v);
+}
+
+// Tangent frame in 4 x snorm16.
+// The quaternion must have the bitangent sign in the sign of w, as Model::tangent_space() does.
+// w is kept away from zero by one quantization step, so that the sign survives.
+static inline short4 qtangent(Quaternion const& q) noexcept {
+    static float constexpr bias = 1.f / 32767.f;
+
+    Quaternion r = q;
+
+    if (std::abs(r[3]) < bias) {
+        float const renormalization = std::sqrt(1.f - bias * bias);
+
+        r[0] *= renormalization;
+        r[1] *= renormalization;
+        r[2] *= renormalization;
+        r[3] = std::signbit(r[3]) ? -bias : bias;
+    }
+
+    return short4(snorm16(r[0]), snorm16(r[1]), snorm16(r[2]), snorm16(r[3]));
+}
+
+// Tangent frame in 32 bits:
+// normal octahedral in 2 x 11 bits, tangent angle in 9 bits and bitangent sign in the top bit.
+// The angle is measured around the decoded normal, relative to math::tangent(n).
+static uint32_t constexpr Octahedral_normal_bits = 11;
+static uint32_t constexpr Octahedral_angle_bits  = 9;
+
+static inline float3 octahedral_normal(uint32_t frame) noexcept {
+    uint32_t const mask = (1u << Octahedral_normal_bits) - 1;
+
+    float const u = unorm_to_float(frame & mask, Octahedral_normal_bits);
+    float const v = unorm_to_float((frame >> Octahedral_normal_bits) & mask,
+                                   Octahedral_normal_bits);
+
+    return octahedral_to_float3(float2(2.f * u - 1.f, 2.f * v - 1.f));
+}
+
+static inline uint32_t octahedral_tangent_frame(float3 const& n, float3 const& t,
+                                                float bitangent_sign) noexcept {
+    static float constexpr Pi = 3.14159265358979323846f;
+
+    float2 const o = octahedral(n);
+
+    uint32_t const u = unorm(0.5f * o[0] + 0.5f, Octahedral_normal_bits);
+    uint32_t const v = unorm(0.5f * o[1] + 0.5f, Octahedral_normal_bits);
+
+    uint32_t frame = u | (v << Octahedral_normal_bits);
+
+    // Reference frame from the normal as the decoder will see it
+    float3 const dn = octahedral_normal(frame);
+    float3 const t0 = math::tangent(dn);
+    float3 const b0 = math::cross(dn, t0);
+
+    float const angle = std::atan2(math::dot(t, b0), math::dot(t, t0));
+
+    uint32_t const a = unorm((angle + Pi) / (2.f * Pi), Octahedral_angle_bits);
+
+    frame |= a << (2 * Octahedral_normal_bits);
+
+    if (bitangent_sign < 0.f) {
+        frame |= 0x80000000;
+    }
+
+    return frame;
+}
+
+}  // namespace encoding
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef SU_BASE_HASH_HASH_HPP
+#define SU_BASE_HASH_HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace hash {
+
+static uint64_t constexpr Fnv_offset_basis = 0xcbf29ce484222325ull;
+static uint64_t constexpr Fnv_prime        = 0x00000100000001B3ull;
+
+// 64-bit FNV-1a
+// http://www.isthe.com/chongo/tech/comp/fnv/index.html
+
+static inline uint64_t fnv_1a(void const* data, size_t size,
+                              uint64_t seed = Fnv_offset_basis) noexcept {
+    uint8_t const* bytes = reinterpret_cast<uint8_t const*>(data);
+
+    uint64_t h = seed;
+
+    for (size_t i = 0; i < size; ++i) {
+        h ^= uint64_t(bytes[i]);
+        h *= Fnv_prime;
+    }
+
+    return h;
+}
+
+template <typename T>
+static inline uint64_t fnv_1a(T const& value, uint64_t seed) noexcept {
+    return fnv_1a(&value, sizeof(T), seed);
+}
+
+// Same as boost::hash_combine, widened to 64 bit
+
+static inline uint64_t combine(uint64_t seed, uint64_t value) noexcept {
+    return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 12) + (seed >> 4));
+}
+
+}  // namespace hash
+
+#endif
@@ -0,0 +1,150 @@
+#include "async_writer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace io {
+
+Async_writer::Async_writer(std::ostream& sink, size_t buffer_size) noexcept
+    : sink_(sink),
+      buffer_size_(std::clamp(buffer_size, size_t(1), Max_buffer_size)),
+      buffers_{new char[buffer_size_], new char[buffer_size_]} {
+    setp(buffers_[0], buffers_[0] + buffer_size_);
+
+    thread_ = std::thread(&loop, std::ref(*this));
+}
+
+Async_writer::~Async_writer() noexcept {
+    sync();
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+
+    wake_signal_.notify_one();
+
+    thread_.join();
+
+    delete[] buffers_[1];
+    delete[] buffers_[0];
+}
+
+Async_writer::int_type Async_writer::overflow(int_type c) noexcept {
+    submit();
+
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+        return traits_type::not_eof(c);
+    }
+
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+
+    return c;
+}
+
+std::streamsize Async_writer::xsputn(char const* s, std::streamsize n) noexcept {
+    std::streamsize written = 0;
+
+    while (written < n) {
+        if (pptr() == epptr()) {
+            submit();
+        }
+
+        std::streamsize const count = std::min(n - written, std::streamsize(epptr() - pptr()));
+
+        std::memcpy(pptr(), s + written, size_t(count));
+
+        pbump(int(count));
+
+        written += count;
+    }
+
+    return n;
+}
+
+int Async_writer::sync() noexcept {
+    submit();
+
+    wait();
+
+    sink_.flush();
+
+    return failed_ || !sink_ ? -1 : 0;
+}
+
+Async_writer::pos_type Async_writer::seekoff(off_type off, std::ios_base::seekdir dir,
+                                             std::ios_base::openmode which) noexcept {
+    if (0 != off || std::ios_base::cur != dir || !(which & std::ios_base::out)) {
+        return pos_type(off_type(-1));
+    }
+
+    return pos_type(off_type(submitted_ + uint64_t(pptr() - pbase())));
+}
+
+void Async_writer::submit() noexcept {
+    size_t const size = size_t(pptr() - pbase());
+
+    if (0 == size) {
+        return;
+    }
+
+    wait();
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        pending_      = pbase();
+        pending_size_ = size;
+    }
+
+    wake_signal_.notify_one();
+
+    submitted_ += size;
+
+    current_ = 1 - current_;
+
+    setp(buffers_[current_], buffers_[current_] + buffer_size_);
+}
+
+void Async_writer::wait() noexcept {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    done_signal_.wait(lock, [this]() { return nullptr == pending_; });
+}
+
+void Async_writer::loop(Async_writer& writer) noexcept {
+    for (;;) {
+        std::unique_lock<std::mutex> lock(writer.mutex_);
+
+        writer.wake_signal_.wait(lock,
+                                 [&writer]() { return writer.quit_ || nullptr != writer.pending_; });
+
+        if (!writer.pending_) {
+            break;
+        }
+
+        char const*  data = writer.pending_;
+        size_t const size = writer.pending_size_;
+
+        lock.unlock();
+
+        bool const failed = !writer.sink_.write(data, std::streamsize(size));
+
+        lock.lock();
+
+        writer.failed_ |= failed;
+        writer.pending_ = nullptr;
+
+        lock.unlock();
+
+        writer.done_signal_.notify_all();
+    }
+}
+
+Async_ostream::Async_ostream(std::ostream& sink, size_t buffer_size) noexcept
+    : std::ostream(nullptr), writer_(sink, buffer_size) {
+    rdbuf(&writer_);
+}
+
+}  // namespace io
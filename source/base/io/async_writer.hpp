@@ -0,0 +1,81 @@
+#ifndef SU_BASE_IO_ASYNC_WRITER_HPP
+#define SU_BASE_IO_ASYNC_WRITER_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <thread>
+
+namespace io {
+
+// Double buffered: a full buffer is written to sink on a background thread, while the caller fills
+// the other one. tellp() works, seeking does not.
+class Async_writer : public std::streambuf {
+  public:
+    static size_t constexpr Default_buffer_size = 1 << 22;
+
+    // pbump() takes an int
+    static size_t constexpr Max_buffer_size = 1 << 30;
+
+    Async_writer(std::ostream& sink, size_t buffer_size = Default_buffer_size) noexcept;
+
+    ~Async_writer() noexcept override;
+
+  protected:
+    int_type overflow(int_type c) noexcept override;
+
+    std::streamsize xsputn(char const* s, std::streamsize n) noexcept override;
+
+    // Waits until everything is in sink, and flushes it
+    int sync() noexcept override;
+
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                     std::ios_base::openmode which) noexcept override;
+
+  private:
+    // Hands the current buffer to the background thread and continues with the other one
+    void submit() noexcept;
+
+    void wait() noexcept;
+
+    static void loop(Async_writer& writer) noexcept;
+
+    std::ostream& sink_;
+
+    size_t const buffer_size_;
+
+    char* buffers_[2];
+
+    uint32_t current_ = 0;
+
+    // Bytes handed to the background thread so far
+    uint64_t submitted_ = 0;
+
+    char const* pending_      = nullptr;
+    size_t      pending_size_ = 0;
+
+    bool quit_   = false;
+    bool failed_ = false;
+
+    std::mutex              mutex_;
+    std::condition_variable wake_signal_;
+    std::condition_variable done_signal_;
+
+    std::thread thread_;
+};
+
+// std::ostream on top of an Async_writer
+class Async_ostream : public std::ostream {
+  public:
+    Async_ostream(std::ostream& sink,
+                  size_t buffer_size = Async_writer::Default_buffer_size) noexcept;
+
+  private:
+    Async_writer writer_;
+};
+
+}  // namespace io
+
+#endif
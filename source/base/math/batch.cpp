@@ -0,0 +1,316 @@
+#include "batch.hpp"
+#include "aabb.inl"
+#include "batch_kernels.hpp"
+#include "matrix3x3.inl"
+#include "quaternion.inl"
+#include "vector3.inl"
+#include "vector4.inl"
+
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+
+#if defined(SU_BATCH_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace math::batch {
+
+static Kernels constexpr Scalar_kernels = {
+    scalar::normalize, scalar::dot,     scalar::cross,   scalar::transform,
+    scalar::scale,     scalar::translate, scalar::min_max, scalar::tangent_space};
+
+static inline float* data(float3* v) noexcept {
+    return reinterpret_cast<float*>(v);
+}
+
+static inline float* data(float4* v) noexcept {
+    return reinterpret_cast<float*>(v);
+}
+
+static inline float const* data(float3 const* v) noexcept {
+    return reinterpret_cast<float const*>(v);
+}
+
+static inline float const* data(float4 const* v) noexcept {
+    return reinterpret_cast<float const*>(v);
+}
+
+static Instruction_set best_supported() noexcept {
+#ifdef SU_BATCH_X86
+#ifdef _MSC_VER
+    int info[4];
+
+    __cpuid(info, 0);
+
+    int const num_ids = info[0];
+
+    bool sse4 = false;
+    bool avx2 = false;
+
+    if (num_ids >= 1) {
+        __cpuid(info, 1);
+
+        sse4 = 0 != (info[2] & (1 << 19));
+
+        bool const os_avx = 0 != (info[2] & (1 << 27)) && 0 != (info[2] & (1 << 28)) &&
+                            6 == (_xgetbv(0) & 6);
+
+        if (os_avx && num_ids >= 7) {
+            __cpuidex(info, 7, 0);
+
+            avx2 = 0 != (info[1] & (1 << 5));
+        }
+    }
+#else
+    __builtin_cpu_init();
+
+    bool const sse4 = __builtin_cpu_supports("sse4.1");
+    bool const avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+    if (avx2) {
+        return Instruction_set::AVX2;
+    }
+
+    if (sse4) {
+        return Instruction_set::SSE4;
+    }
+#endif
+
+    return Instruction_set::Scalar;
+}
+
+static std::atomic<Instruction_set> current_set = best_supported();
+
+static Kernels const& kernels() noexcept {
+#ifdef SU_BATCH_X86
+    switch (current_set.load(std::memory_order_relaxed)) {
+        case Instruction_set::AVX2:
+            return avx2_kernels();
+        case Instruction_set::SSE4:
+            return sse4_kernels();
+        default:
+            break;
+    }
+#endif
+
+    return Scalar_kernels;
+}
+
+Instruction_set instruction_set() noexcept {
+    return current_set.load(std::memory_order_relaxed);
+}
+
+void set_instruction_set(Instruction_set set) noexcept {
+    Instruction_set const best = best_supported();
+
+    current_set = uint32_t(set) <= uint32_t(best) ? set : best;
+}
+
+char const* name(Instruction_set set) noexcept {
+    switch (set) {
+        case Instruction_set::AVX2:
+            return "AVX2";
+        case Instruction_set::SSE4:
+            return "SSE4.1";
+        default:
+            return "Scalar";
+    }
+}
+
+uint32_t normalize(float3* v, uint32_t count, float min_length, float tolerance,
+                   uint8_t* invalid) noexcept {
+    return kernels().normalize(data(v), count, min_length, tolerance, invalid);
+}
+
+uint32_t normalize(float4* v, uint32_t count, float min_length, float tolerance,
+                   uint8_t* invalid) noexcept {
+    return kernels().normalize(data(v), count, min_length, tolerance, invalid);
+}
+
+void dot(float3 const* a, float3 const* b, float* result, uint32_t count) noexcept {
+    kernels().dot(data(a), data(b), result, count);
+}
+
+void dot(float3 const* a, float4 const* b, float* result, uint32_t count) noexcept {
+    kernels().dot(data(a), data(b), result, count);
+}
+
+void cross(float3 const* a, float3 const* b, float3* result, uint32_t count) noexcept {
+    kernels().cross(data(a), data(b), data(result), count);
+}
+
+void transform(float3x3 const& m, float3* v, uint32_t count) noexcept {
+    kernels().transform(m, data(v), count);
+}
+
+void transform(float3x3 const& m, float4* v, uint32_t count) noexcept {
+    kernels().transform(m, data(v), count);
+}
+
+void scale(float3* v, uint32_t count, float3 const& s) noexcept {
+    kernels().scale(data(v), count, s);
+}
+
+void translate(float3* v, uint32_t count, float3 const& offset) noexcept {
+    kernels().translate(data(v), count, offset);
+}
+
+AABB aabb(float3 const* v, uint32_t count) noexcept {
+    AABB box = AABB::empty();
+
+    if (count > 0) {
+        kernels().min_max(data(v), count, box.bounds[0], box.bounds[1]);
+    }
+
+    return box;
+}
+
+void tangent_space(float4 const* tangents_and_bitangent_signs, float3 const* normals,
+                   Quaternion* result, uint32_t count) noexcept {
+    kernels().tangent_space(data(tangents_and_bitangent_signs), data(normals), data(result), count);
+}
+
+namespace scalar {
+
+uint32_t normalize(float* v, uint32_t count, float min_length, float tolerance,
+                   uint8_t* invalid) noexcept {
+    uint32_t num_invalid = 0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        float* e = v + i * 4;
+
+        float const l = std::sqrt(e[0] * e[0] + e[1] * e[1] + e[2] * e[2]);
+
+        if (!(l >= min_length) || !(l <= FLT_MAX)) {
+            invalid[i] = 1;
+            ++num_invalid;
+            continue;
+        }
+
+        invalid[i] = 0;
+
+        if (l < 1.f - tolerance || l > 1.f + tolerance) {
+            float const il = 1.f / l;
+
+            e[0] *= il;
+            e[1] *= il;
+            e[2] *= il;
+        }
+    }
+
+    return num_invalid;
+}
+
+void dot(float const* a, float const* b, float* result, uint32_t count) noexcept {
+    for (uint32_t i = 0; i < count; ++i) {
+        float const* x = a + i * 4;
+        float const* y = b + i * 4;
+
+        result[i] = x[0] * y[0] + x[1] * y[1] + x[2] * y[2];
+    }
+}
+
+void cross(float const* a, float const* b, float* result, uint32_t count) noexcept {
+    for (uint32_t i = 0; i < count; ++i) {
+        float const* x = a + i * 4;
+        float const* y = b + i * 4;
+
+        float* r = result + i * 4;
+
+        float const r0 = x[1] * y[2] - x[2] * y[1];
+        float const r1 = x[2] * y[0] - x[0] * y[2];
+        float const r2 = x[0] * y[1] - x[1] * y[0];
+
+        r[0] = r0;
+        r[1] = r1;
+        r[2] = r2;
+        r[3] = 0.f;
+    }
+}
+
+void transform(float3x3 const& m, float* v, uint32_t count) noexcept {
+    for (uint32_t i = 0; i < count; ++i) {
+        float* e = v + i * 4;
+
+        float3 const r = transform_vector(m, float3(e[0], e[1], e[2]));
+
+        e[0] = r[0];
+        e[1] = r[1];
+        e[2] = r[2];
+    }
+}
+
+void scale(float* v, uint32_t count, float3 const& s) noexcept {
+    for (uint32_t i = 0; i < count; ++i) {
+        float* e = v + i * 4;
+
+        e[0] *= s[0];
+        e[1] *= s[1];
+        e[2] *= s[2];
+    }
+}
+
+void translate(float* v, uint32_t count, float3 const& offset) noexcept {
+    for (uint32_t i = 0; i < count; ++i) {
+        float* e = v + i * 4;
+
+        e[0] += offset[0];
+        e[1] += offset[1];
+        e[2] += offset[2];
+    }
+}
+
+void min_max(float const* v, uint32_t count, float3& min, float3& max) noexcept {
+    for (uint32_t i = 0; i < count; ++i) {
+        float3 const p(v[i * 4 + 0], v[i * 4 + 1], v[i * 4 + 2]);
+
+        min = math::min(min, p);
+        max = math::max(max, p);
+    }
+}
+
+void tangent_space(float const* tangents, float const* normals, float* result,
+                   uint32_t count) noexcept {
+    static float const renormalization = std::sqrt(1.f -
+                                                   Tangent_space_threshold *
+                                                       Tangent_space_threshold);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        float const* tbs = tangents + i * 4;
+
+        float3 const t(tbs[0], tbs[1], tbs[2]);
+        float3 const n(normals[i * 4 + 0], normals[i * 4 + 1], normals[i * 4 + 2]);
+
+        float3 const b = cross(n, t);
+
+        Quaternion q = quaternion::create(float3x3(t, b, n));
+
+        if (std::abs(q[3]) < Tangent_space_threshold) {
+            q[0] *= renormalization;
+            q[1] *= renormalization;
+            q[2] *= renormalization;
+            q[3] = q[3] < 0.f ? -Tangent_space_threshold : Tangent_space_threshold;
+        }
+
+        if (q[3] < 0.f) {
+            q = -q;
+        }
+
+        if (tbs[3] < 0.f) {
+            q[3] = -q[3];
+        }
+
+        float* r = result + i * 4;
+
+        r[0] = q[0];
+        r[1] = q[1];
+        r[2] = q[2];
+        r[3] = q[3];
+    }
+}
+
+}  // namespace scalar
+
+}  // namespace math::batch
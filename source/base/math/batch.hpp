@@ -0,0 +1,58 @@
+#ifndef SU_BASE_MATH_BATCH_HPP
+#define SU_BASE_MATH_BATCH_HPP
+
+#include "aabb.hpp"
+#include "matrix.hpp"
+#include "quaternion.hpp"
+#include "vector.hpp"
+
+#include <cstdint>
+
+// Kernels over whole arrays of float3/float4 elements.
+// The implementation is picked once at runtime: AVX2, SSE4.1 or scalar.
+// Only xyz are read; where float4 arrays are modified, the fourth component is preserved.
+
+namespace math::batch {
+
+enum class Instruction_set { Scalar, SSE4, AVX2 };
+
+Instruction_set instruction_set() noexcept;
+
+// Falls back to the best supported instruction set if the requested one is not available
+void set_instruction_set(Instruction_set set) noexcept;
+
+char const* name(Instruction_set set) noexcept;
+
+// Normalizes vectors whose length is not within 1 +- tolerance.
+// Vectors shorter than min_length or not finite are left alone and flagged in invalid.
+// Returns the number of invalid vectors.
+uint32_t normalize(float3* v, uint32_t count, float min_length, float tolerance,
+                   uint8_t* invalid) noexcept;
+
+uint32_t normalize(float4* v, uint32_t count, float min_length, float tolerance,
+                   uint8_t* invalid) noexcept;
+
+void dot(float3 const* a, float3 const* b, float* result, uint32_t count) noexcept;
+
+void dot(float3 const* a, float4 const* b, float* result, uint32_t count) noexcept;
+
+void cross(float3 const* a, float3 const* b, float3* result, uint32_t count) noexcept;
+
+// v = v * m, like transform_vector()
+void transform(float3x3 const& m, float3* v, uint32_t count) noexcept;
+
+void transform(float3x3 const& m, float4* v, uint32_t count) noexcept;
+
+void scale(float3* v, uint32_t count, float3 const& s) noexcept;
+
+void translate(float3* v, uint32_t count, float3 const& offset) noexcept;
+
+AABB aabb(float3 const* v, uint32_t count) noexcept;
+
+// Same as Model::tangent_space(): tangent frame as quaternion, bitangent sign in the sign of w
+void tangent_space(float4 const* tangents_and_bitangent_signs, float3 const* normals,
+                   Quaternion* result, uint32_t count) noexcept;
+
+}  // namespace math::batch
+
+#endif
@@ -0,0 +1,339 @@
+#include "batch_kernels.hpp"
+#include "vector3.inl"
+
+#ifdef SU_BATCH_X86
+
+#include <immintrin.h>
+#include <cfloat>
+#include <cmath>
+
+// Compiled without -mavx2, the instruction set is only enabled for these functions.
+// No FMA on purpose, so that results are identical to the SSE4.1 and scalar kernels.
+#if defined(__GNUC__) || defined(__clang__)
+#define SU_TARGET __attribute__((target("avx2")))
+#else
+#define SU_TARGET
+#endif
+
+// Eight elements per iteration. Two elements are loaded per register and transposed within the
+// 128 bit lanes, so that x holds the elements in the order 0 2 4 6 1 3 5 7.
+// The remainder goes through the scalar kernels.
+
+namespace math::batch::avx2 {
+
+SU_TARGET static inline void transpose(__m256& a, __m256& b, __m256& c, __m256& d) noexcept {
+    __m256 const t0 = _mm256_unpacklo_ps(a, b);
+    __m256 const t1 = _mm256_unpackhi_ps(a, b);
+    __m256 const t2 = _mm256_unpacklo_ps(c, d);
+    __m256 const t3 = _mm256_unpackhi_ps(c, d);
+
+    a = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    b = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    c = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    d = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+SU_TARGET static void load(float const* e, __m256& x, __m256& y, __m256& z, __m256& w) noexcept {
+    x = _mm256_loadu_ps(e);
+    y = _mm256_loadu_ps(e + 8);
+    z = _mm256_loadu_ps(e + 16);
+    w = _mm256_loadu_ps(e + 24);
+
+    transpose(x, y, z, w);
+}
+
+SU_TARGET static void store(float* e, __m256 x, __m256 y, __m256 z, __m256 w) noexcept {
+    transpose(x, y, z, w);
+
+    _mm256_storeu_ps(e, x);
+    _mm256_storeu_ps(e + 8, y);
+    _mm256_storeu_ps(e + 16, z);
+    _mm256_storeu_ps(e + 24, w);
+}
+
+// From register order back to element order
+SU_TARGET static inline __m256 in_order(__m256 v) noexcept {
+    return _mm256_permutevar8x32_ps(v, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+SU_TARGET static inline __m256 dot(__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by,
+                                   __m256 bz) noexcept {
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)),
+                         _mm256_mul_ps(az, bz));
+}
+
+SU_TARGET static uint32_t normalize(float* v, uint32_t count, float min_length, float tolerance,
+                                    uint8_t* invalid) noexcept {
+    __m256 const min_l = _mm256_set1_ps(min_length);
+    __m256 const max_l = _mm256_set1_ps(FLT_MAX);
+    __m256 const lower = _mm256_set1_ps(1.f - tolerance);
+    __m256 const upper = _mm256_set1_ps(1.f + tolerance);
+    __m256 const one   = _mm256_set1_ps(1.f);
+
+    uint32_t num_invalid = 0;
+
+    uint32_t const end = count & ~7u;
+
+    for (uint32_t i = 0; i < end; i += 8) {
+        float* e = v + i * 4;
+
+        __m256 x, y, z, w;
+        load(e, x, y, z, w);
+
+        __m256 const l = _mm256_sqrt_ps(dot(x, y, z, x, y, z));
+
+        __m256 const valid = _mm256_and_ps(_mm256_cmp_ps(l, min_l, _CMP_GE_OQ),
+                                           _mm256_cmp_ps(l, max_l, _CMP_LE_OQ));
+        __m256 const off   = _mm256_or_ps(_mm256_cmp_ps(l, lower, _CMP_LT_OQ),
+                                        _mm256_cmp_ps(l, upper, _CMP_GT_OQ));
+        __m256 const mask  = _mm256_and_ps(valid, off);
+
+        __m256 const il = _mm256_div_ps(one, l);
+
+        x = _mm256_blendv_ps(x, _mm256_mul_ps(x, il), mask);
+        y = _mm256_blendv_ps(y, _mm256_mul_ps(y, il), mask);
+        z = _mm256_blendv_ps(z, _mm256_mul_ps(z, il), mask);
+
+        store(e, x, y, z, w);
+
+        int const bits = _mm256_movemask_ps(in_order(valid));
+
+        for (uint32_t j = 0; j < 8; ++j) {
+            uint8_t const flag = 0 == (bits & (1 << j)) ? 1 : 0;
+
+            invalid[i + j] = flag;
+            num_invalid += flag;
+        }
+    }
+
+    return num_invalid +
+           scalar::normalize(v + end * 4, count - end, min_length, tolerance, invalid + end);
+}
+
+SU_TARGET static void dot(float const* a, float const* b, float* result, uint32_t count) noexcept {
+    uint32_t const end = count & ~7u;
+
+    for (uint32_t i = 0; i < end; i += 8) {
+        __m256 ax, ay, az, aw;
+        load(a + i * 4, ax, ay, az, aw);
+
+        __m256 bx, by, bz, bw;
+        load(b + i * 4, bx, by, bz, bw);
+
+        _mm256_storeu_ps(result + i, in_order(dot(ax, ay, az, bx, by, bz)));
+    }
+
+    scalar::dot(a + end * 4, b + end * 4, result + end, count - end);
+}
+
+SU_TARGET static void cross(float const* a, float const* b, float* result,
+                            uint32_t count) noexcept {
+    uint32_t const end = count & ~7u;
+
+    for (uint32_t i = 0; i < end; i += 8) {
+        __m256 ax, ay, az, aw;
+        load(a + i * 4, ax, ay, az, aw);
+
+        __m256 bx, by, bz, bw;
+        load(b + i * 4, bx, by, bz, bw);
+
+        __m256 const x = _mm256_sub_ps(_mm256_mul_ps(ay, bz), _mm256_mul_ps(az, by));
+        __m256 const y = _mm256_sub_ps(_mm256_mul_ps(az, bx), _mm256_mul_ps(ax, bz));
+        __m256 const z = _mm256_sub_ps(_mm256_mul_ps(ax, by), _mm256_mul_ps(ay, bx));
+
+        store(result + i * 4, x, y, z, _mm256_setzero_ps());
+    }
+
+    scalar::cross(a + end * 4, b + end * 4, result + end * 4, count - end);
+}
+
+SU_TARGET static void transform(float3x3 const& m, float* v, uint32_t count) noexcept {
+    __m256 const m00 = _mm256_set1_ps(m.r[0][0]);
+    __m256 const m01 = _mm256_set1_ps(m.r[0][1]);
+    __m256 const m02 = _mm256_set1_ps(m.r[0][2]);
+    __m256 const m10 = _mm256_set1_ps(m.r[1][0]);
+    __m256 const m11 = _mm256_set1_ps(m.r[1][1]);
+    __m256 const m12 = _mm256_set1_ps(m.r[1][2]);
+    __m256 const m20 = _mm256_set1_ps(m.r[2][0]);
+    __m256 const m21 = _mm256_set1_ps(m.r[2][1]);
+    __m256 const m22 = _mm256_set1_ps(m.r[2][2]);
+
+    uint32_t const end = count & ~7u;
+
+    for (uint32_t i = 0; i < end; i += 8) {
+        float* e = v + i * 4;
+
+        __m256 x, y, z, w;
+        load(e, x, y, z, w);
+
+        __m256 const rx = dot(x, y, z, m00, m10, m20);
+        __m256 const ry = dot(x, y, z, m01, m11, m21);
+        __m256 const rz = dot(x, y, z, m02, m12, m22);
+
+        store(e, rx, ry, rz, w);
+    }
+
+    scalar::transform(m, v + end * 4, count - end);
+}
+
+SU_TARGET static void scale(float* v, uint32_t count, float3 const& s) noexcept {
+    __m256 const s8 = _mm256_setr_ps(s[0], s[1], s[2], 1.f, s[0], s[1], s[2], 1.f);
+
+    uint32_t const end = count & ~1u;
+
+    for (uint32_t i = 0; i < end; i += 2) {
+        float* e = v + i * 4;
+
+        _mm256_storeu_ps(e, _mm256_mul_ps(_mm256_loadu_ps(e), s8));
+    }
+
+    scalar::scale(v + end * 4, count - end, s);
+}
+
+SU_TARGET static void translate(float* v, uint32_t count, float3 const& offset) noexcept {
+    __m256 const o8 = _mm256_setr_ps(offset[0], offset[1], offset[2], 0.f, offset[0], offset[1],
+                                     offset[2], 0.f);
+
+    uint32_t const end = count & ~1u;
+
+    for (uint32_t i = 0; i < end; i += 2) {
+        float* e = v + i * 4;
+
+        _mm256_storeu_ps(e, _mm256_add_ps(_mm256_loadu_ps(e), o8));
+    }
+
+    scalar::translate(v + end * 4, count - end, offset);
+}
+
+SU_TARGET static void min_max(float const* v, uint32_t count, float3& min, float3& max) noexcept {
+    __m256 mn = _mm256_setr_ps(min[0], min[1], min[2], 0.f, min[0], min[1], min[2], 0.f);
+    __m256 mx = _mm256_setr_ps(max[0], max[1], max[2], 0.f, max[0], max[1], max[2], 0.f);
+
+    uint32_t const end = count & ~1u;
+
+    for (uint32_t i = 0; i < end; i += 2) {
+        __m256 const p = _mm256_loadu_ps(v + i * 4);
+
+        // Same operand order as std::min/max in the scalar version, which ignores NaN in p
+        mn = _mm256_min_ps(p, mn);
+        mx = _mm256_max_ps(p, mx);
+    }
+
+    alignas(32) float r[8];
+
+    _mm256_store_ps(r, mn);
+    min = math::min(float3(r[0], r[1], r[2]), float3(r[4], r[5], r[6]));
+
+    _mm256_store_ps(r, mx);
+    max = math::max(float3(r[0], r[1], r[2]), float3(r[4], r[5], r[6]));
+
+    scalar::min_max(v + end * 4, count - end, min, max);
+}
+
+SU_TARGET static void tangent_space(float const* tangents, float const* normals, float* result,
+                                    uint32_t count) noexcept {
+    __m256 const one       = _mm256_set1_ps(1.f);
+    __m256 const half      = _mm256_set1_ps(0.5f);
+    __m256 const zero      = _mm256_setzero_ps();
+    __m256 const sign_mask = _mm256_set1_ps(-0.f);
+    __m256 const threshold = _mm256_set1_ps(Tangent_space_threshold);
+
+    __m256 const renormalization = _mm256_set1_ps(
+        std::sqrt(1.f - Tangent_space_threshold * Tangent_space_threshold));
+
+    uint32_t const end = count & ~7u;
+
+    for (uint32_t i = 0; i < end; i += 8) {
+        __m256 m00, m01, m02, bitangent_sign;
+        load(tangents + i * 4, m00, m01, m02, bitangent_sign);
+
+        __m256 m20, m21, m22, nw;
+        load(normals + i * 4, m20, m21, m22, nw);
+
+        // b = cross(n, t)
+        __m256 const m10 = _mm256_sub_ps(_mm256_mul_ps(m21, m02), _mm256_mul_ps(m22, m01));
+        __m256 const m11 = _mm256_sub_ps(_mm256_mul_ps(m22, m00), _mm256_mul_ps(m20, m02));
+        __m256 const m12 = _mm256_sub_ps(_mm256_mul_ps(m20, m01), _mm256_mul_ps(m21, m00));
+
+        // All four branches of quaternion::create(), blended
+        __m256 const neg_z  = _mm256_cmp_ps(m22, zero, _CMP_LT_OQ);
+        __m256 const x_gt_y = _mm256_cmp_ps(m00, m11, _CMP_GT_OQ);
+        __m256 const x_lt_y = _mm256_cmp_ps(m00, _mm256_xor_ps(m11, sign_mask), _CMP_LT_OQ);
+
+        __m256 const ta = _mm256_sub_ps(_mm256_sub_ps(_mm256_add_ps(one, m00), m11), m22);
+        __m256 const tb = _mm256_sub_ps(_mm256_add_ps(_mm256_sub_ps(one, m00), m11), m22);
+        __m256 const tc = _mm256_add_ps(_mm256_sub_ps(_mm256_sub_ps(one, m00), m11), m22);
+        __m256 const td = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(one, m00), m11), m22);
+
+        __m256 const s01 = _mm256_add_ps(m01, m10);
+        __m256 const s20 = _mm256_add_ps(m20, m02);
+        __m256 const s12 = _mm256_add_ps(m12, m21);
+        __m256 const d21 = _mm256_sub_ps(m21, m12);
+        __m256 const d02 = _mm256_sub_ps(m02, m20);
+        __m256 const d10 = _mm256_sub_ps(m10, m01);
+
+        // neg_z: a (x_gt_y) or b, else: c (x_lt_y) or d
+        __m256 const qx_neg = _mm256_blendv_ps(s01, ta, x_gt_y);
+        __m256 const qy_neg = _mm256_blendv_ps(tb, s01, x_gt_y);
+        __m256 const qz_neg = _mm256_blendv_ps(s12, s20, x_gt_y);
+        __m256 const qw_neg = _mm256_blendv_ps(d02, d21, x_gt_y);
+        __m256 const t_neg  = _mm256_blendv_ps(tb, ta, x_gt_y);
+
+        __m256 const qx_pos = _mm256_blendv_ps(d21, s20, x_lt_y);
+        __m256 const qy_pos = _mm256_blendv_ps(d02, s12, x_lt_y);
+        __m256 const qz_pos = _mm256_blendv_ps(d10, tc, x_lt_y);
+        __m256 const qw_pos = _mm256_blendv_ps(td, d10, x_lt_y);
+        __m256 const t_pos  = _mm256_blendv_ps(td, tc, x_lt_y);
+
+        __m256 const t = _mm256_blendv_ps(t_pos, t_neg, neg_z);
+
+        __m256 const s = _mm256_div_ps(half, _mm256_sqrt_ps(t));
+
+        __m256 qx = _mm256_mul_ps(s, _mm256_blendv_ps(qx_pos, qx_neg, neg_z));
+        __m256 qy = _mm256_mul_ps(s, _mm256_blendv_ps(qy_pos, qy_neg, neg_z));
+        __m256 qz = _mm256_mul_ps(s, _mm256_blendv_ps(qz_pos, qz_neg, neg_z));
+        __m256 qw = _mm256_mul_ps(s, _mm256_blendv_ps(qw_pos, qw_neg, neg_z));
+
+        __m256 const small = _mm256_cmp_ps(_mm256_andnot_ps(sign_mask, qw), threshold,
+                                           _CMP_LT_OQ);
+
+        qx = _mm256_blendv_ps(qx, _mm256_mul_ps(qx, renormalization), small);
+        qy = _mm256_blendv_ps(qy, _mm256_mul_ps(qy, renormalization), small);
+        qz = _mm256_blendv_ps(qz, _mm256_mul_ps(qz, renormalization), small);
+
+        __m256 const clamped_w = _mm256_or_ps(
+            threshold, _mm256_and_ps(_mm256_cmp_ps(qw, zero, _CMP_LT_OQ), sign_mask));
+
+        qw = _mm256_blendv_ps(qw, clamped_w, small);
+
+        __m256 const flip = _mm256_and_ps(_mm256_cmp_ps(qw, zero, _CMP_LT_OQ), sign_mask);
+
+        qx = _mm256_xor_ps(qx, flip);
+        qy = _mm256_xor_ps(qy, flip);
+        qz = _mm256_xor_ps(qz, flip);
+        qw = _mm256_xor_ps(qw, flip);
+
+        qw = _mm256_xor_ps(
+            qw, _mm256_and_ps(_mm256_cmp_ps(bitangent_sign, zero, _CMP_LT_OQ), sign_mask));
+
+        store(result + i * 4, qx, qy, qz, qw);
+    }
+
+    scalar::tangent_space(tangents + end * 4, normals + end * 4, result + end * 4, count - end);
+}
+
+}  // namespace math::batch::avx2
+
+namespace math::batch {
+
+Kernels const& avx2_kernels() noexcept {
+    static Kernels constexpr kernels = {
+        avx2::normalize, avx2::dot,     avx2::cross,   avx2::transform,
+        avx2::scale,     avx2::translate, avx2::min_max, avx2::tangent_space};
+
+    return kernels;
+}
+
+}  // namespace math::batch
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef SU_BASE_MATH_BATCH_KERNELS_HPP
+#define SU_BASE_MATH_BATCH_KERNELS_HPP
+
+#include "matrix3x3.hpp"
+#include "vector3.hpp"
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SU_BATCH_X86
+#endif
+
+// Every element is 4 floats and 16 byte aligned, the layout of float3 and float4
+
+namespace math::batch {
+
+struct Kernels {
+    uint32_t (*normalize)(float* v, uint32_t count, float min_length, float tolerance,
+                          uint8_t* invalid) noexcept;
+
+    void (*dot)(float const* a, float const* b, float* result, uint32_t count) noexcept;
+
+    void (*cross)(float const* a, float const* b, float* result, uint32_t count) noexcept;
+
+    void (*transform)(float3x3 const& m, float* v, uint32_t count) noexcept;
+
+    void (*scale)(float* v, uint32_t count, float3 const& s) noexcept;
+
+    void (*translate)(float* v, uint32_t count, float3 const& offset) noexcept;
+
+    void (*min_max)(float const* v, uint32_t count, float3& min, float3& max) noexcept;
+
+    void (*tangent_space)(float const* tangents, float const* normals, float* result,
+                          uint32_t count) noexcept;
+};
+
+namespace scalar {
+
+uint32_t normalize(float* v, uint32_t count, float min_length, float tolerance,
+                   uint8_t* invalid) noexcept;
+
+void dot(float const* a, float const* b, float* result, uint32_t count) noexcept;
+
+void cross(float const* a, float const* b, float* result, uint32_t count) noexcept;
+
+void transform(float3x3 const& m, float* v, uint32_t count) noexcept;
+
+void scale(float* v, uint32_t count, float3 const& s) noexcept;
+
+void translate(float* v, uint32_t count, float3 const& offset) noexcept;
+
+void min_max(float const* v, uint32_t count, float3& min, float3& max) noexcept;
+
+void tangent_space(float const* tangents, float const* normals, float* result,
+                   uint32_t count) noexcept;
+
+}  // namespace scalar
+
+#ifdef SU_BATCH_X86
+
+Kernels const& sse4_kernels() noexcept;
+
+Kernels const& avx2_kernels() noexcept;
+
+#endif
+
+// Constants shared by all tangent_space implementations
+static float constexpr Tangent_space_threshold = 0.000001f;
+
+}  // namespace math::batch
+
+#endif
@@ -0,0 +1,302 @@
+#include "batch_kernels.hpp"
+#include "vector3.inl"
+
+#ifdef SU_BATCH_X86
+
+#include <smmintrin.h>
+#include <cfloat>
+#include <cmath>
+
+// Compiled without -msse4.1, the instruction set is only enabled for these functions
+#if defined(__GNUC__) || defined(__clang__)
+#define SU_TARGET __attribute__((target("sse4.1")))
+#else
+#define SU_TARGET
+#endif
+
+// Four elements per iteration: transposed to x, y, z, w registers, computed, transposed back.
+// The remainder goes through the scalar kernels.
+
+namespace math::batch::sse4 {
+
+SU_TARGET static void load(float const* e, __m128& x, __m128& y, __m128& z, __m128& w) noexcept {
+    x = _mm_load_ps(e);
+    y = _mm_load_ps(e + 4);
+    z = _mm_load_ps(e + 8);
+    w = _mm_load_ps(e + 12);
+
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+}
+
+SU_TARGET static void store(float* e, __m128 x, __m128 y, __m128 z, __m128 w) noexcept {
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+
+    _mm_store_ps(e, x);
+    _mm_store_ps(e + 4, y);
+    _mm_store_ps(e + 8, z);
+    _mm_store_ps(e + 12, w);
+}
+
+SU_TARGET static inline __m128 dot(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by,
+                                   __m128 bz) noexcept {
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+}
+
+SU_TARGET static uint32_t normalize(float* v, uint32_t count, float min_length, float tolerance,
+                                    uint8_t* invalid) noexcept {
+    __m128 const min_l = _mm_set1_ps(min_length);
+    __m128 const max_l = _mm_set1_ps(FLT_MAX);
+    __m128 const lower = _mm_set1_ps(1.f - tolerance);
+    __m128 const upper = _mm_set1_ps(1.f + tolerance);
+    __m128 const one   = _mm_set1_ps(1.f);
+
+    uint32_t num_invalid = 0;
+
+    uint32_t const end = count & ~3u;
+
+    for (uint32_t i = 0; i < end; i += 4) {
+        float* e = v + i * 4;
+
+        __m128 x, y, z, w;
+        load(e, x, y, z, w);
+
+        __m128 const l = _mm_sqrt_ps(dot(x, y, z, x, y, z));
+
+        __m128 const valid = _mm_and_ps(_mm_cmpge_ps(l, min_l), _mm_cmple_ps(l, max_l));
+        __m128 const off   = _mm_or_ps(_mm_cmplt_ps(l, lower), _mm_cmpgt_ps(l, upper));
+        __m128 const mask  = _mm_and_ps(valid, off);
+
+        __m128 const il = _mm_div_ps(one, l);
+
+        x = _mm_blendv_ps(x, _mm_mul_ps(x, il), mask);
+        y = _mm_blendv_ps(y, _mm_mul_ps(y, il), mask);
+        z = _mm_blendv_ps(z, _mm_mul_ps(z, il), mask);
+
+        store(e, x, y, z, w);
+
+        int const bits = _mm_movemask_ps(valid);
+
+        for (uint32_t j = 0; j < 4; ++j) {
+            uint8_t const flag = 0 == (bits & (1 << j)) ? 1 : 0;
+
+            invalid[i + j] = flag;
+            num_invalid += flag;
+        }
+    }
+
+    return num_invalid +
+           scalar::normalize(v + end * 4, count - end, min_length, tolerance, invalid + end);
+}
+
+SU_TARGET static void dot(float const* a, float const* b, float* result, uint32_t count) noexcept {
+    uint32_t const end = count & ~3u;
+
+    for (uint32_t i = 0; i < end; i += 4) {
+        __m128 ax, ay, az, aw;
+        load(a + i * 4, ax, ay, az, aw);
+
+        __m128 bx, by, bz, bw;
+        load(b + i * 4, bx, by, bz, bw);
+
+        _mm_storeu_ps(result + i, dot(ax, ay, az, bx, by, bz));
+    }
+
+    scalar::dot(a + end * 4, b + end * 4, result + end, count - end);
+}
+
+SU_TARGET static void cross(float const* a, float const* b, float* result,
+                            uint32_t count) noexcept {
+    uint32_t const end = count & ~3u;
+
+    for (uint32_t i = 0; i < end; i += 4) {
+        __m128 ax, ay, az, aw;
+        load(a + i * 4, ax, ay, az, aw);
+
+        __m128 bx, by, bz, bw;
+        load(b + i * 4, bx, by, bz, bw);
+
+        __m128 const x = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+        __m128 const y = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz));
+        __m128 const z = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx));
+
+        store(result + i * 4, x, y, z, _mm_setzero_ps());
+    }
+
+    scalar::cross(a + end * 4, b + end * 4, result + end * 4, count - end);
+}
+
+SU_TARGET static void transform(float3x3 const& m, float* v, uint32_t count) noexcept {
+    __m128 const m00 = _mm_set1_ps(m.r[0][0]);
+    __m128 const m01 = _mm_set1_ps(m.r[0][1]);
+    __m128 const m02 = _mm_set1_ps(m.r[0][2]);
+    __m128 const m10 = _mm_set1_ps(m.r[1][0]);
+    __m128 const m11 = _mm_set1_ps(m.r[1][1]);
+    __m128 const m12 = _mm_set1_ps(m.r[1][2]);
+    __m128 const m20 = _mm_set1_ps(m.r[2][0]);
+    __m128 const m21 = _mm_set1_ps(m.r[2][1]);
+    __m128 const m22 = _mm_set1_ps(m.r[2][2]);
+
+    uint32_t const end = count & ~3u;
+
+    for (uint32_t i = 0; i < end; i += 4) {
+        float* e = v + i * 4;
+
+        __m128 x, y, z, w;
+        load(e, x, y, z, w);
+
+        __m128 const rx = dot(x, y, z, m00, m10, m20);
+        __m128 const ry = dot(x, y, z, m01, m11, m21);
+        __m128 const rz = dot(x, y, z, m02, m12, m22);
+
+        store(e, rx, ry, rz, w);
+    }
+
+    scalar::transform(m, v + end * 4, count - end);
+}
+
+SU_TARGET static void scale(float* v, uint32_t count, float3 const& s) noexcept {
+    __m128 const s4 = _mm_setr_ps(s[0], s[1], s[2], 1.f);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        float* e = v + i * 4;
+
+        _mm_store_ps(e, _mm_mul_ps(_mm_load_ps(e), s4));
+    }
+}
+
+SU_TARGET static void translate(float* v, uint32_t count, float3 const& offset) noexcept {
+    __m128 const o4 = _mm_setr_ps(offset[0], offset[1], offset[2], 0.f);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        float* e = v + i * 4;
+
+        _mm_store_ps(e, _mm_add_ps(_mm_load_ps(e), o4));
+    }
+}
+
+SU_TARGET static void min_max(float const* v, uint32_t count, float3& min, float3& max) noexcept {
+    __m128 mn = _mm_setr_ps(min[0], min[1], min[2], 0.f);
+    __m128 mx = _mm_setr_ps(max[0], max[1], max[2], 0.f);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        __m128 const p = _mm_load_ps(v + i * 4);
+
+        // Same operand order as std::min/max in the scalar version, which ignores NaN in p
+        mn = _mm_min_ps(p, mn);
+        mx = _mm_max_ps(p, mx);
+    }
+
+    alignas(16) float r[4];
+
+    _mm_store_ps(r, mn);
+    min = float3(r[0], r[1], r[2]);
+
+    _mm_store_ps(r, mx);
+    max = float3(r[0], r[1], r[2]);
+}
+
+SU_TARGET static void tangent_space(float const* tangents, float const* normals, float* result,
+                                    uint32_t count) noexcept {
+    __m128 const one       = _mm_set1_ps(1.f);
+    __m128 const half      = _mm_set1_ps(0.5f);
+    __m128 const zero      = _mm_setzero_ps();
+    __m128 const sign_mask = _mm_set1_ps(-0.f);
+    __m128 const threshold = _mm_set1_ps(Tangent_space_threshold);
+
+    __m128 const renormalization = _mm_set1_ps(
+        std::sqrt(1.f - Tangent_space_threshold * Tangent_space_threshold));
+
+    uint32_t const end = count & ~3u;
+
+    for (uint32_t i = 0; i < end; i += 4) {
+        __m128 m00, m01, m02, bitangent_sign;
+        load(tangents + i * 4, m00, m01, m02, bitangent_sign);
+
+        __m128 m20, m21, m22, nw;
+        load(normals + i * 4, m20, m21, m22, nw);
+
+        // b = cross(n, t)
+        __m128 const m10 = _mm_sub_ps(_mm_mul_ps(m21, m02), _mm_mul_ps(m22, m01));
+        __m128 const m11 = _mm_sub_ps(_mm_mul_ps(m22, m00), _mm_mul_ps(m20, m02));
+        __m128 const m12 = _mm_sub_ps(_mm_mul_ps(m20, m01), _mm_mul_ps(m21, m00));
+
+        // All four branches of quaternion::create(), blended
+        __m128 const neg_z  = _mm_cmplt_ps(m22, zero);
+        __m128 const x_gt_y = _mm_cmpgt_ps(m00, m11);
+        __m128 const x_lt_y = _mm_cmplt_ps(m00, _mm_xor_ps(m11, sign_mask));
+
+        __m128 const ta = _mm_sub_ps(_mm_sub_ps(_mm_add_ps(one, m00), m11), m22);
+        __m128 const tb = _mm_sub_ps(_mm_add_ps(_mm_sub_ps(one, m00), m11), m22);
+        __m128 const tc = _mm_add_ps(_mm_sub_ps(_mm_sub_ps(one, m00), m11), m22);
+        __m128 const td = _mm_add_ps(_mm_add_ps(_mm_add_ps(one, m00), m11), m22);
+
+        __m128 const s01 = _mm_add_ps(m01, m10);
+        __m128 const s20 = _mm_add_ps(m20, m02);
+        __m128 const s12 = _mm_add_ps(m12, m21);
+        __m128 const d21 = _mm_sub_ps(m21, m12);
+        __m128 const d02 = _mm_sub_ps(m02, m20);
+        __m128 const d10 = _mm_sub_ps(m10, m01);
+
+        // neg_z: a (x_gt_y) or b, else: c (x_lt_y) or d
+        __m128 const qx_neg = _mm_blendv_ps(s01, ta, x_gt_y);
+        __m128 const qy_neg = _mm_blendv_ps(tb, s01, x_gt_y);
+        __m128 const qz_neg = _mm_blendv_ps(s12, s20, x_gt_y);
+        __m128 const qw_neg = _mm_blendv_ps(d02, d21, x_gt_y);
+        __m128 const t_neg  = _mm_blendv_ps(tb, ta, x_gt_y);
+
+        __m128 const qx_pos = _mm_blendv_ps(d21, s20, x_lt_y);
+        __m128 const qy_pos = _mm_blendv_ps(d02, s12, x_lt_y);
+        __m128 const qz_pos = _mm_blendv_ps(d10, tc, x_lt_y);
+        __m128 const qw_pos = _mm_blendv_ps(td, d10, x_lt_y);
+        __m128 const t_pos  = _mm_blendv_ps(td, tc, x_lt_y);
+
+        __m128 const t = _mm_blendv_ps(t_pos, t_neg, neg_z);
+
+        __m128 const s = _mm_div_ps(half, _mm_sqrt_ps(t));
+
+        __m128 qx = _mm_mul_ps(s, _mm_blendv_ps(qx_pos, qx_neg, neg_z));
+        __m128 qy = _mm_mul_ps(s, _mm_blendv_ps(qy_pos, qy_neg, neg_z));
+        __m128 qz = _mm_mul_ps(s, _mm_blendv_ps(qz_pos, qz_neg, neg_z));
+        __m128 qw = _mm_mul_ps(s, _mm_blendv_ps(qw_pos, qw_neg, neg_z));
+
+        __m128 const small = _mm_cmplt_ps(_mm_andnot_ps(sign_mask, qw), threshold);
+
+        qx = _mm_blendv_ps(qx, _mm_mul_ps(qx, renormalization), small);
+        qy = _mm_blendv_ps(qy, _mm_mul_ps(qy, renormalization), small);
+        qz = _mm_blendv_ps(qz, _mm_mul_ps(qz, renormalization), small);
+
+        __m128 const clamped_w = _mm_or_ps(threshold,
+                                           _mm_and_ps(_mm_cmplt_ps(qw, zero), sign_mask));
+
+        qw = _mm_blendv_ps(qw, clamped_w, small);
+
+        __m128 const flip = _mm_and_ps(_mm_cmplt_ps(qw, zero), sign_mask);
+
+        qx = _mm_xor_ps(qx, flip);
+        qy = _mm_xor_ps(qy, flip);
+        qz = _mm_xor_ps(qz, flip);
+        qw = _mm_xor_ps(qw, flip);
+
+        qw = _mm_xor_ps(qw, _mm_and_ps(_mm_cmplt_ps(bitangent_sign, zero), sign_mask));
+
+        store(result + i * 4, qx, qy, qz, qw);
+    }
+
+    scalar::tangent_space(tangents + end * 4, normals + end * 4, result + end * 4, count - end);
+}
+
+}  // namespace math::batch::sse4
+
+namespace math::batch {
+
+Kernels const& sse4_kernels() noexcept {
+    static Kernels constexpr kernels = {
+        sse4::normalize, sse4::dot,     sse4::cross,   sse4::transform,
+        sse4::scale,     sse4::translate, sse4::min_max, sse4::tangent_space};
+
+    return kernels;
+}
+
+}  // namespace math::batch
+
+#endif
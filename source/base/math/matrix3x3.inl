@@ -308,6 +308,11 @@ static inline Matrix3x3f_a operator*(Matrix3x3f_a const& a, Matrix3x3f_a const&
                         a.r[2][0] * b.r[0][2] + a.r[2][1] * b.r[1][2] + a.r[2][2] * b.r[2][2]);
 }
 
+static inline Matrix3x3f_a transposed(Matrix3x3f_a const& m) {
+    return Matrix3x3f_a(m.r[0][0], m.r[1][0], m.r[2][0], m.r[0][1], m.r[1][1], m.r[2][1], m.r[0][2],
+                        m.r[1][2], m.r[2][2]);
+}
+
 static inline Vector3f_a transform_vector(Matrix3x3f_a const& m, Vector3f_a const& v) {
     return Vector3f_a(v[0] * m.r[0][0] + v[1] * m.r[1][0] + v[2] * m.r[2][0],
                       v[0] * m.r[0][1] + v[1] * m.r[1][1] + v[2] * m.r[2][1],
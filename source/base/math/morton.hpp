@@ -0,0 +1,28 @@
+#ifndef SU_BASE_MATH_MORTON_HPP
+#define SU_BASE_MATH_MORTON_HPP
+
+#include <cstdint>
+
+namespace math::morton {
+
+// Spreads the lowest 21 bits of x, so that there are two zero bits between each of them
+static inline uint64_t constexpr expand_bits(uint32_t x) noexcept {
+    uint64_t v = uint64_t(x) & 0x1FFFFF;
+
+    v = (v | (v << 32)) & 0x001F00000000FFFFull;
+    v = (v | (v << 16)) & 0x001F0000FF0000FFull;
+    v = (v | (v << 8)) & 0x100F00F00F00F00Full;
+    v = (v | (v << 4)) & 0x10C30C30C30C30C3ull;
+    v = (v | (v << 2)) & 0x1249249249249249ull;
+
+    return v;
+}
+
+// 63 bit code of three 21 bit coordinates
+static inline uint64_t constexpr encode(uint32_t x, uint32_t y, uint32_t z) noexcept {
+    return expand_bits(x) | (expand_bits(y) << 1) | (expand_bits(z) << 2);
+}
+
+}  // namespace math::morton
+
+#endif
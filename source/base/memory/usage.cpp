@@ -0,0 +1,39 @@
+#include "usage.hpp"
+
+#ifdef _WIN32
+// clang-format off
+#include <windows.h>
+#include <psapi.h>
+// clang-format on
+#else
+#include <sys/resource.h>
+#endif
+
+namespace memory {
+
+size_t peak_resident_size() noexcept {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+
+    if (0 != getrusage(RUSAGE_SELF, &usage)) {
+        return 0;
+    }
+
+#ifdef __APPLE__
+    return size_t(usage.ru_maxrss);
+#else
+    // Kilobytes
+    return size_t(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+}  // namespace memory
@@ -0,0 +1,13 @@
+#ifndef SU_BASE_MEMORY_USAGE_HPP
+#define SU_BASE_MEMORY_USAGE_HPP
+
+#include <cstddef>
+
+namespace memory {
+
+// Largest resident set of the process so far in bytes, 0 if unknown
+size_t peak_resident_size() noexcept;
+
+}  // namespace memory
+
+#endif
@@ -0,0 +1,132 @@
+#include "radix_sort.hpp"
+#include "memory/align.hpp"
+#include "thread/thread_pool.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace sort {
+
+static uint32_t constexpr Radix_bits = 8;
+static uint32_t constexpr Radix_size = 1 << Radix_bits;
+static uint64_t constexpr Radix_mask = Radix_size - 1;
+
+// Below this size the bookkeeping of the parallel passes costs more than it saves
+static uint32_t constexpr Min_parallel_count = 1 << 16;
+
+void radix_sort(uint64_t* keys, uint32_t* values, uint64_t* keys_temp, uint32_t* values_temp,
+                uint32_t count, uint32_t num_key_bits, thread::Pool& threads) noexcept {
+    if (count < 2) {
+        return;
+    }
+
+    uint32_t const num_threads = count < Min_parallel_count ? 1 : threads.num_threads();
+
+    // One histogram per thread, each thread owns the same chunk of the input in every pass
+    memory::Buffer<uint32_t> histograms(num_threads * Radix_size);
+
+    uint64_t* source_keys   = keys;
+    uint32_t* source_values = values;
+    uint64_t* target_keys   = keys_temp;
+    uint32_t* target_values = values_temp;
+
+    uint32_t const num_passes = (std::min(num_key_bits, 64u) + Radix_bits - 1) / Radix_bits;
+
+    for (uint32_t p = 0; p < num_passes; ++p) {
+        uint32_t const shift = p * Radix_bits;
+
+        auto count_digits = [&](uint32_t id, int32_t begin, int32_t end) noexcept {
+            uint32_t* histogram = histograms.data() + id * Radix_size;
+
+            std::memset(histogram, 0, Radix_size * sizeof(uint32_t));
+
+            for (int32_t i = begin; i < end; ++i) {
+                ++histogram[(source_keys[i] >> shift) & Radix_mask];
+            }
+        };
+
+        if (1 == num_threads) {
+            count_digits(0, 0, int32_t(count));
+        } else {
+            std::memset(histograms.data(), 0, num_threads * Radix_size * sizeof(uint32_t));
+
+            threads.run_range(count_digits, 0, int32_t(count));
+        }
+
+        // A pass where every key has the same digit would only copy the data
+        bool skip = false;
+
+        for (uint32_t d = 0; d < Radix_size; ++d) {
+            uint32_t total = 0;
+
+            for (uint32_t t = 0; t < num_threads; ++t) {
+                total += histograms[t * Radix_size + d];
+            }
+
+            if (total == count) {
+                skip = true;
+                break;
+            }
+
+            if (total > 0) {
+                break;
+            }
+        }
+
+        if (skip) {
+            continue;
+        }
+
+        // Exclusive prefix sum, ordered by digit first and chunk second, to keep the sort stable
+        uint32_t offset = 0;
+
+        for (uint32_t d = 0; d < Radix_size; ++d) {
+            for (uint32_t t = 0; t < num_threads; ++t) {
+                uint32_t& h = histograms[t * Radix_size + d];
+
+                uint32_t const c = h;
+
+                h = offset;
+
+                offset += c;
+            }
+        }
+
+        auto scatter = [&](uint32_t id, int32_t begin, int32_t end) noexcept {
+            uint32_t* histogram = histograms.data() + id * Radix_size;
+
+            for (int32_t i = begin; i < end; ++i) {
+                uint64_t const key = source_keys[i];
+
+                uint32_t const o = histogram[(key >> shift) & Radix_mask]++;
+
+                target_keys[o]   = key;
+                target_values[o] = source_values[i];
+            }
+        };
+
+        if (1 == num_threads) {
+            scatter(0, 0, int32_t(count));
+        } else {
+            threads.run_range(scatter, 0, int32_t(count));
+        }
+
+        std::swap(source_keys, target_keys);
+        std::swap(source_values, target_values);
+    }
+
+    if (source_keys != keys) {
+        std::copy(source_keys, source_keys + count, keys);
+        std::copy(source_values, source_values + count, values);
+    }
+}
+
+void radix_sort(uint64_t* keys, uint32_t* values, uint32_t count, uint32_t num_key_bits,
+                thread::Pool& threads) noexcept {
+    memory::Buffer<uint64_t> keys_temp(count);
+    memory::Buffer<uint32_t> values_temp(count);
+
+    radix_sort(keys, values, keys_temp.data(), values_temp.data(), count, num_key_bits, threads);
+}
+
+}  // namespace sort
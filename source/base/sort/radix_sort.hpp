@@ -0,0 +1,22 @@
+#ifndef SU_BASE_SORT_RADIX_SORT_HPP
+#define SU_BASE_SORT_RADIX_SORT_HPP
+
+#include <cstdint>
+
+namespace thread {
+class Pool;
+}
+
+namespace sort {
+
+// Stable LSD radix sort of keys, with values moved along. Only the lowest num_key_bits of the keys
+// are considered. The temp buffers must hold count elements each.
+void radix_sort(uint64_t* keys, uint32_t* values, uint64_t* keys_temp, uint32_t* values_temp,
+                uint32_t count, uint32_t num_key_bits, thread::Pool& threads) noexcept;
+
+void radix_sort(uint64_t* keys, uint32_t* values, uint32_t count, uint32_t num_key_bits,
+                thread::Pool& threads) noexcept;
+
+}  // namespace sort
+
+#endif
@@ -0,0 +1,185 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+namespace thread {
+
+uint32_t Pool::num_threads(int32_t request) noexcept {
+    uint32_t const available_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    if (request <= 0) {
+        int32_t const num_threads = int32_t(available_threads) + request;
+
+        return uint32_t(std::max(num_threads, 1));
+    }
+
+    return std::min(available_threads, uint32_t(request));
+}
+
+Pool::Pool(uint32_t num_threads) noexcept
+    : num_threads_(std::max(num_threads, 1u)), uniques_(new Unique[num_threads_]) {
+    threads_.reserve(num_threads_);
+
+    for (uint32_t i = 0; i < num_threads_; ++i) {
+        threads_.emplace_back(&loop, std::ref(*this), i);
+    }
+
+    async_thread_ = std::thread(&async_loop, std::ref(*this));
+}
+
+Pool::~Pool() noexcept {
+    quit_ = true;
+
+    wake_all(0, 0);
+
+    for (auto& t : threads_) {
+        t.join();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(async_mutex_);
+        async_wake_signal_.notify_one();
+    }
+
+    async_thread_.join();
+
+    delete[] uniques_;
+}
+
+uint32_t Pool::num_threads() const noexcept {
+    return num_threads_;
+}
+
+void Pool::run_parallel(Program&& program) noexcept {
+    program_ = std::move(program);
+
+    wake_all(0, 0);
+
+    wait_all();
+
+    program_ = nullptr;
+}
+
+void Pool::run_range(Range_program&& program, int32_t begin, int32_t end) noexcept {
+    if (begin >= end) {
+        return;
+    }
+
+    range_program_ = std::move(program);
+
+    wake_all(begin, end);
+
+    wait_all();
+
+    range_program_ = nullptr;
+}
+
+void Pool::run_async(Async_program&& program) noexcept {
+    std::unique_lock<std::mutex> lock(async_mutex_);
+
+    async_programs_.push_back(std::move(program));
+
+    async_wake_signal_.notify_one();
+}
+
+void Pool::wait_async() noexcept {
+    std::unique_lock<std::mutex> lock(async_mutex_);
+
+    async_done_signal_.wait(lock, [this]() { return async_programs_.empty() && !async_busy_; });
+}
+
+void Pool::wake_all(int32_t begin, int32_t end) noexcept {
+    int32_t const range = end - begin;
+
+    int32_t const step = (range + int32_t(num_threads_) - 1) / int32_t(num_threads_);
+
+    int32_t r = begin;
+
+    for (uint32_t i = 0; i < num_threads_; ++i) {
+        Unique& u = uniques_[i];
+
+        std::unique_lock<std::mutex> lock(u.mutex);
+
+        u.begin = std::min(r, end);
+        u.end   = std::min(r + step, end);
+        u.wake  = true;
+
+        lock.unlock();
+
+        u.wake_signal.notify_one();
+
+        r += step;
+    }
+}
+
+void Pool::wait_all() noexcept {
+    for (uint32_t i = 0; i < num_threads_; ++i) {
+        Unique& u = uniques_[i];
+
+        std::unique_lock<std::mutex> lock(u.mutex);
+
+        u.done_signal.wait(lock, [&u]() { return !u.wake; });
+    }
+}
+
+void Pool::loop(Pool& pool, uint32_t id) noexcept {
+    Unique& u = pool.uniques_[id];
+
+    for (;;) {
+        std::unique_lock<std::mutex> lock(u.mutex);
+
+        u.wake_signal.wait(lock, [&u]() { return u.wake; });
+
+        if (pool.quit_) {
+            break;
+        }
+
+        lock.unlock();
+
+        if (pool.program_) {
+            pool.program_(id);
+        } else if (pool.range_program_ && u.begin < u.end) {
+            pool.range_program_(id, u.begin, u.end);
+        }
+
+        lock.lock();
+
+        u.wake = false;
+
+        lock.unlock();
+
+        u.done_signal.notify_one();
+    }
+}
+
+void Pool::async_loop(Pool& pool) noexcept {
+    for (;;) {
+        std::unique_lock<std::mutex> lock(pool.async_mutex_);
+
+        pool.async_wake_signal_.wait(
+            lock, [&pool]() { return pool.quit_ || !pool.async_programs_.empty(); });
+
+        if (pool.async_programs_.empty()) {
+            break;
+        }
+
+        Async_program program = std::move(pool.async_programs_.front());
+        pool.async_programs_.pop_front();
+
+        pool.async_busy_ = true;
+
+        lock.unlock();
+
+        program();
+
+        lock.lock();
+
+        pool.async_busy_ = false;
+
+        lock.unlock();
+
+        pool.async_done_signal_.notify_all();
+    }
+}
+
+}  // namespace thread
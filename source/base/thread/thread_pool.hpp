@@ -0,0 +1,86 @@
+#ifndef SU_BASE_THREAD_THREAD_POOL_HPP
+#define SU_BASE_THREAD_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace thread {
+
+class Pool {
+  public:
+    using Program       = std::function<void(uint32_t)>;
+    using Range_program = std::function<void(uint32_t, int32_t, int32_t)>;
+    using Async_program = std::function<void()>;
+
+    // request <= 0 means all available logical CPUs minus |request|
+    static uint32_t num_threads(int32_t request) noexcept;
+
+    Pool(uint32_t num_threads) noexcept;
+
+    ~Pool() noexcept;
+
+    uint32_t num_threads() const noexcept;
+
+    // Calls program(id) once on every thread
+    void run_parallel(Program&& program) noexcept;
+
+    // Splits [begin, end) into one contiguous range per thread, in ascending order of thread id.
+    // Passing the same interval twice yields the same split.
+    void run_range(Range_program&& program, int32_t begin, int32_t end) noexcept;
+
+    // Queues program on a separate thread, concurrent to everything else
+    void run_async(Async_program&& program) noexcept;
+
+    void wait_async() noexcept;
+
+  private:
+    struct Unique {
+        int32_t begin;
+        int32_t end;
+
+        bool wake = false;
+
+        std::mutex              mutex;
+        std::condition_variable wake_signal;
+        std::condition_variable done_signal;
+    };
+
+    void wake_all(int32_t begin, int32_t end) noexcept;
+
+    void wait_all() noexcept;
+
+    static void loop(Pool& pool, uint32_t id) noexcept;
+
+    static void async_loop(Pool& pool) noexcept;
+
+    uint32_t const num_threads_;
+
+    std::atomic<bool> quit_ = false;
+
+    Unique* uniques_;
+
+    Program       program_;
+    Range_program range_program_;
+
+    std::vector<std::thread> threads_;
+
+    std::deque<Async_program> async_programs_;
+
+    bool async_busy_ = false;
+
+    std::mutex              async_mutex_;
+    std::condition_variable async_wake_signal_;
+    std::condition_variable async_done_signal_;
+
+    std::thread async_thread_;
+};
+
+}  // namespace thread
+
+#endif
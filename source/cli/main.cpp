@@ -2,15 +2,29 @@
 #include "base/math/aabb.inl"
 #include "base/math/print.hpp"
 #include "base/math/vector3.inl"
+#include "base/memory/usage.hpp"
+#include "base/thread/thread_pool.hpp"
 #include "core/model/model.hpp"
 #include "core/model/model_exporter_json.hpp"
+#include "core/model/model_exporter_package.hpp"
 #include "core/model/model_exporter_sub.hpp"
 #include "core/model/model_importer_assimp.hpp"
 #include "core/model/model_importer_json.hpp"
+#include "core/model/model_lights.hpp"
+#include "core/model/model_tiling.hpp"
+#include "core/texture/texture_deduplication.hpp"
+#include "core/texture/texture_processor.hpp"
 #include "options/options.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
+#include <sstream>
+#include <vector>
+
+static bool convert(std::string const& input, std::string const& output,
+                    options::Options const& args, model::Exporter_package* package,
+                    texture::Processor& processor, thread::Pool& threads) noexcept;
 
 static std::string autocomplete(std::string const& source, std::string const& addition) noexcept;
 
@@ -20,41 +34,92 @@ static std::string extract_filename(std::string const& filename) noexcept;
 
 static std::string discard_extension(std::string const& filename) noexcept;
 
+static std::string directory(std::string const& filename) noexcept;
+
+static void print_peak_resident_size(char const* stage) noexcept;
+
 int main(int argc, char* argv[]) noexcept {
     auto const args = options::parse(argc, argv);
 
-    if (args.input.empty()) {
+    if (args.inputs.empty()) {
         std::cout << "No input file specified" << std::endl;
 
         return 0;
     }
 
-    std::cout << args.input << std::endl;
+    auto const start = std::chrono::high_resolution_clock::now();
+
+    thread::Pool threads(thread::Pool::num_threads(args.threads));
+
+    bool const packaged = !args.package.empty();
+
+    model::Exporter_package package;
+
+    if (packaged && !package.open(args.package, std::max(args.alignment, 64u))) {
+        std::cout << "Could not open package " << args.package << std::endl;
+
+        return 0;
+    }
+
+    texture::Processor::Settings texture_settings;
+
+    texture_settings.bc1_for_opaque_color = args.textures_bc1;
+
+    // Shared by all inputs, so that their DDS files neither collide nor get converted twice
+    texture::Processor processor(texture_settings);
+
+    for (size_t i = 0, len = args.inputs.size(); i < len; ++i) {
+        // Several inputs can't share an output name, but can share an extension
+        std::string const output = (0 == i || '.' == args.output[0]) ? args.output : "";
+
+        convert(args.inputs[i], output, args, packaged ? &package : nullptr, processor, threads);
+    }
+
+    if (packaged) {
+        if (!package.close()) {
+            std::cout << "Could not write package " << args.package << std::endl;
+        }
+
+        std::cout << "#models:    " << package.num_models() << " (" << package.num_blobs()
+                  << " blobs, " << package.bytes_saved() << " bytes saved)" << std::endl;
+    }
+
+    print_peak_resident_size("total");
+
+    std::cout << chrono::seconds_since(start) << " s" << std::endl;
+
+    return 0;
+}
+
+bool convert(std::string const& input, std::string const& output, options::Options const& args,
+             model::Exporter_package* package, texture::Processor& processor,
+             thread::Pool& threads) noexcept {
+    std::cout << input << std::endl;
 
-    for (size_t i = 0, len = args.input.size(); i < len; ++i) {
+    for (size_t i = 0, len = input.size(); i < len; ++i) {
         std::cout << "=";
     }
 
     std::cout << std::endl;
 
-    auto const start = std::chrono::high_resolution_clock::now();
-
     model::Model* model = nullptr;
 
-    if ("json" == suffix(args.input)) {
+    if ("json" == suffix(input)) {
         model::Importer_json importer;
 
-        model = importer.read(args.input);
+        model = importer.read(input);
     } else {
-        model::Importer_assimp importer;
+        model::Importer_assimp importer(args.profile, args.report_pp_timing);
 
-        model = importer.read(args.input);
+        model = importer.read(input);
     }
 
     if (!model) {
-        return 0;
+        return false;
     }
 
+    print_peak_resident_size("import");
+
     std::cout << "#triangles: " << model->num_indices() / 3 << std::endl;
     std::cout << "#vertices:  " << model->num_vertices() << std::endl;
     std::cout << "#parts:     " << model->num_parts() << std::endl;
@@ -70,35 +135,156 @@ int main(int argc, char* argv[]) noexcept {
 
     model->try_to_fix_tangent_space();
 
+    if (args.instances) {
+        uint32_t const num_removed = model->find_instances();
+
+        std::cout << "#instances: " << model->num_instances() << " (" << num_removed
+                  << " parts removed)" << std::endl;
+    }
+
+    if (args.merge_parts) {
+        uint32_t const num_removed = model->merge_parts(args.merge_parts_spatially, threads);
+
+        std::cout << "#parts:     " << model->num_parts() << " (" << num_removed
+                  << " parts merged away)" << std::endl;
+    }
+
+    if (args.sort) {
+        model->sort_spatially(threads);
+    }
+
     AABB const box = model->aabb();
 
     std::cout << "AABB: {\n    " << box.bounds[0] << ",\n    " << box.bounds[1] << "}" << std::endl;
 
-    std::string const out = discard_extension(
-        args.output.empty() ? args.input : autocomplete(args.output, args.input));
+    std::string const out = discard_extension(output.empty() ? input
+                                                             : autocomplete(output, input));
 
-    std::string ext = suffix(args.output);
+    std::string ext = suffix(output);
 
     if (ext.empty()) {
         ext = "sub";
     }
 
-    model::Exporter_json exporter;
+    bool const tiled = !package && "sub" == ext && args.tile_size > 0.f;
+
+    // One .sub file, alone or in the package
+    bool const single_sub = package || ("sub" == ext && !tiled);
 
-    if ("sub" == ext) {
-        model::Exporter_sub exporter_sub;
-        exporter_sub.write(out, *model);
-    } else if ("json" == ext) {
-        exporter.write(out, *model);
+    if (single_sub) {
+        // Keeps the indices of every part within 16 bits of its base vertex
+        if (uint32_t const num_added = model->localize_parts(0x10000); num_added > 0) {
+            std::cout << "#parts:     " << model->num_parts() << " (" << num_added
+                      << " parts split off)" << std::endl;
+        }
     }
 
-    exporter.write_materials(out, extract_filename(out) + "." + ext, *model);
+    // After localizing, which gives split parts new instances, and before the textures are
+    // converted to formats that can't be read back. Tiles renumber the triangles, so they get no
+    // lights.
+    model::Lights lights;
 
-    delete model;
+    if (args.lights && single_sub) {
+        lights = model::gather_lights(*model, directory(input), args.lights_per_triangle, threads);
 
-    std::cout << chrono::seconds_since(start) << " s" << std::endl;
+        std::cout << "#lights:    " << lights.triangles.size() << " triangles (power "
+                  << lights.total_power << ")" << std::endl;
+    }
 
-    return 0;
+    if (args.dedup_textures) {
+        texture::Deduplication const dedup = texture::deduplicate(*model, directory(input),
+                                                                  threads);
+
+        std::cout << "#textures:  " << dedup.num_files << " files, "
+                  << dedup.num_files - dedup.num_unique << " duplicates, " << dedup.bytes_saved
+                  << " bytes saved" << std::endl;
+    }
+
+    if (args.textures) {
+        uint32_t const num_converted = processor.process(*model, directory(input),
+                                                         directory(out), threads);
+
+        std::cout << "#textures:  " << num_converted << " converted" << std::endl;
+    }
+
+    model::Exporter_json exporter(args.json_arrays);
+
+    model::Exporter_sub::Settings settings;
+
+    settings.layout          = args.layout;
+    settings.tangent_space   = args.tangent_space;
+    settings.bvh             = args.bvh;
+    settings.triangles       = args.intersection_triangles;
+    settings.position_stream = args.position_stream;
+    settings.part_chunks     = args.part_chunks;
+    settings.alignment       = args.alignment;
+    settings.lights          = args.lights && single_sub ? &lights : nullptr;
+
+    if (package) {
+        // Without entities, so that models with the same materials share them
+        std::ostringstream materials;
+
+        if (model->materials()) {
+            threads.run_async([&exporter, &materials, model]() {
+                exporter.write_materials(materials, {}, *model);
+            });
+        }
+
+        std::ostringstream mesh;
+
+        model::Exporter_sub exporter_sub(settings);
+        exporter_sub.write(mesh, *model, threads);
+
+        threads.wait_async();
+
+        using Add_result = model::Exporter_package::Add_result;
+
+        switch (package->add(out, mesh.str(), materials.str())) {
+            case Add_result::Added:
+                break;
+            case Add_result::Duplicate_name:
+                std::cout << "Model " << out << " is already in the package." << std::endl;
+                break;
+            case Add_result::Write_error:
+                std::cout << "Could not write model " << out << " to the package." << std::endl;
+                delete model;
+                return false;
+        }
+
+        delete model;
+
+        return true;
+    }
+
+    std::vector<std::string> shape_names = {extract_filename(out) + "." + ext};
+
+    if (tiled) {
+        model::Tiling const tiling = model::tile(*model, args.tile_size, threads);
+
+        shape_names = model::write_tiles(out, *model, tiling, settings, threads);
+
+        std::cout << "#tiles:     " << shape_names.size() << std::endl;
+
+        exporter.write_materials(out, shape_names, *model);
+    } else {
+        // The materials file doesn't depend on the geometry, so both are written at the same time
+        threads.run_async([&exporter, &out, &shape_names, model]() {
+            exporter.write_materials(out, shape_names, *model);
+        });
+
+        if ("sub" == ext) {
+            model::Exporter_sub exporter_sub(settings);
+            exporter_sub.write(out, *model, threads);
+        } else if ("json" == ext) {
+            exporter.write(out, *model);
+        }
+
+        threads.wait_async();
+    }
+
+    delete model;
+
+    return true;
 }
 
 std::string autocomplete(std::string const& source, std::string const& addition) noexcept {
@@ -122,3 +308,18 @@ std::string extract_filename(std::string const& filename) noexcept {
 std::string discard_extension(std::string const& filename) noexcept {
     return filename.substr(0, filename.find_last_of('.'));
 }
+
+std::string directory(std::string const& filename) noexcept {
+    return filename.substr(0, filename.find_last_of('/') + 1);
+}
+
+void print_peak_resident_size(char const* stage) noexcept {
+    size_t const bytes = memory::peak_resident_size();
+
+    if (0 == bytes) {
+        return;
+    }
+
+    std::cout << "Peak RSS:   " << (bytes + (1 << 19)) / (1 << 20) << " MiB (" << stage << ")"
+              << std::endl;
+}
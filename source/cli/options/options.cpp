@@ -67,11 +67,84 @@ bool handle(std::string const& command, std::string const& parameter, Options& r
     if ("help" == command || "h" == command) {
         help();
     } else if ("in" == command || "i" == command) {
-        result.input = parameter;
+        if (!parameter.empty()) {
+            result.inputs.push_back(parameter);
+        }
     } else if ("out" == command || "o" == command) {
         result.output = parameter;
+    } else if ("align" == command) {
+        if ("page" == parameter) {
+            result.alignment = 4096;
+        } else if (uint32_t const alignment = uint32_t(std::atoi(parameter.data()));
+                   alignment >= 4 && 0 == (alignment & (alignment - 1))) {
+            result.alignment = alignment;
+        } else {
+            std::cout << "Alignment " << parameter << " is not a power of two >= 4.";
+        }
+    } else if ("bvh" == command) {
+        result.bvh = true;
     } else if ("center-bottom" == command) {
         result.origin = Model::Origin::Center_bottom;
+    } else if ("dedup-textures" == command) {
+        result.dedup_textures = true;
+    } else if ("instances" == command) {
+        result.instances = true;
+    } else if ("intersection-triangles" == command) {
+        result.intersection_triangles = true;
+    } else if ("json-arrays" == command) {
+        if ("text" == parameter) {
+            result.json_arrays = Exporter_json::Arrays::Text;
+        } else if ("sidecar" == parameter) {
+            result.json_arrays = Exporter_json::Arrays::Sidecar;
+        } else if ("base64" == parameter) {
+            result.json_arrays = Exporter_json::Arrays::Base64;
+        } else {
+            std::cout << "JSON array storage " << parameter << " does not exist.";
+        }
+    } else if ("layout" == command) {
+        if ("separate" == parameter) {
+            result.layout = Exporter_sub::Layout::Separate;
+        } else if ("interleaved" == parameter) {
+            result.layout = Exporter_sub::Layout::Interleaved;
+        } else if ("split-position" == parameter) {
+            result.layout = Exporter_sub::Layout::Split_position;
+        } else {
+            std::cout << "Layout " << parameter << " does not exist.";
+        }
+    } else if ("lights" == command) {
+        result.lights = true;
+
+        if ("per-triangle" == parameter) {
+            result.lights_per_triangle = true;
+        } else if (!parameter.empty()) {
+            std::cout << "Emission averaging " << parameter << " does not exist.";
+        }
+    } else if ("merge-parts" == command) {
+        result.merge_parts = true;
+
+        if ("spatial" == parameter) {
+            result.merge_parts_spatially = true;
+        } else if (!parameter.empty()) {
+            std::cout << "Merge order " << parameter << " does not exist.";
+        }
+    } else if ("package" == command) {
+        result.package = parameter;
+    } else if ("part-chunks" == command) {
+        result.part_chunks = true;
+    } else if ("position-stream" == command) {
+        result.position_stream = true;
+    } else if ("profile" == command) {
+        if ("fast" == parameter) {
+            result.profile = Importer_assimp::Profile::Fast;
+        } else if ("balanced" == parameter) {
+            result.profile = Importer_assimp::Profile::Balanced;
+        } else if ("thorough" == parameter) {
+            result.profile = Importer_assimp::Profile::Thorough;
+        } else {
+            std::cout << "Import profile " << parameter << " does not exist.";
+        }
+    } else if ("report-pp-timing" == command) {
+        result.report_pp_timing = true;
     } else if ("reverse-x" == command) {
         result.transformations.set(Model::Transformation::Reverse_X);
     } else if ("reverse-y" == command) {
@@ -86,10 +159,34 @@ bool handle(std::string const& command, std::string const& parameter, Options& r
         result.transformations.set(Model::Transformation::Reverse_Z);
     } else if ("scale" == command || "s" == command) {
         result.scale = float(std::atof(parameter.data()));
+    } else if ("sort" == command) {
+        result.sort = true;
     } else if ("swap-xy" == command || "swap-yx" == command) {
         result.transformations.set(Model::Transformation::Swap_XY);
     } else if ("swap-yz" == command || "swap-zy" == command) {
         result.transformations.set(Model::Transformation::Swap_YZ);
+    } else if ("tangent-space" == command) {
+        if ("quaternion" == parameter) {
+            result.tangent_space = Exporter_sub::Tangent_space::Quaternion;
+        } else if ("qtangent" == parameter) {
+            result.tangent_space = Exporter_sub::Tangent_space::QTangent;
+        } else if ("octahedral" == parameter) {
+            result.tangent_space = Exporter_sub::Tangent_space::Octahedral;
+        } else {
+            std::cout << "Tangent space encoding " << parameter << " does not exist.";
+        }
+    } else if ("textures" == command) {
+        result.textures = true;
+
+        if ("bc1" == parameter) {
+            result.textures_bc1 = true;
+        } else if (!parameter.empty() && "bc7" != parameter) {
+            std::cout << "Color texture format " << parameter << " does not exist.";
+        }
+    } else if ("tile" == command) {
+        result.tile_size = float(std::atof(parameter.data()));
+    } else if ("threads" == command || "t" == command) {
+        result.threads = std::atoi(parameter.data());
     } else {
         std::cout << "Option " << command << " does not exist.";
     }
@@ -124,12 +221,85 @@ Usage:
   it [OPTION...]
 
   -h, --help           Print help.
-  -i, --in     file    File name of the input model.
+  -i, --in     file... File names of the input models, converted one by one.
   -o, --out    file    File name of the output files, without extension.
+                       Only applies to the first input, unless it is just
+                       an extension like .json.
+      --align bytes    Alignment of the binary blocks in .sub files:
+                       a power of two >= 4 (default 64), or page for 4096.
+      --bvh            Append a binned SAH BVH over the triangles to
+                       .sub files.
       --center-bottom  Set the model's origin to the center bottom,
                        e.g. [0, -1, 0] for the unit cube.
+      --dedup-textures Point materials at one file for all texture files
+                       with identical content.
+      --instances      Collapse parts that are identical up to a rigid
+                       transformation into one part plus instances.
+      --intersection-triangles
+                       Append vertex and edges of every triangle, with part
+                       and material index, to .sub files.
+      --json-arrays storage
+                       Storage of vertices and indices in .json files:
+                       text:    decimal numbers (default)
+                       sidecar: binary .bin file next to the .json
+                       base64:  base64 strings inside the .json
+      --layout layout  Vertex stream layout of .sub files:
+                       separate:       one stream per attribute (default)
+                       interleaved:    all attributes in one stream
+                       split-position: positions in one stream,
+                                       everything else in another
+      --lights [per-triangle]
+                       Append the triangles with emissive materials, with
+                       area, power and a CDF for sampling them by power, to
+                       .sub files. Emission textures are averaged over the
+                       whole texture, or with per-triangle over every
+                       triangle.
+      --merge-parts [spatial]
+                       Merge all parts with the same material into one
+                       part. spatial orders the triangles of each part by
+                       the Morton code of their centers.
+      --package file   Write all input models into one package file, with a
+                       hashed directory of the models and identical meshes
+                       and materials stored once.
+      --part-chunks    Give every part of .sub files its own vertex and
+                       index blocks, so that parts can be loaded one by one.
+      --position-stream
+                       Append positions welded on position alone, with
+                       their own indices, to .sub files for depth passes.
+      --profile profile
+                       Post-processing of assimp imports:
+                       fast:     only the steps the conversion needs,
+                                 for input that is known to be clean
+                       balanced: also remove degenerate and invalid data,
+                                 and merge meshes (default)
+                       thorough: also validate the scene and reorder
+                                 triangles for the vertex cache
+      --report-pp-timing
+                       Print the time of the file read and of every
+                       post-processing step of assimp imports.
       --reverse-[xzz]  Reverse the specified axis of the model's vertices.
-  -s, --scale  float   Scalar (> 0) to uniformly scale the model by.)";
+  -s, --scale  float   Scalar (> 0) to uniformly scale the model by.
+      --sort           Sort parts and triangles by the Morton code of their
+                       centers, and vertices by their first use.
+      --tangent-space enc
+                       Encoding of the tangent space in .sub files:
+                       quaternion: 4 x float32 (default)
+                       qtangent:   quaternion in 4 x snorm16
+                       octahedral: normal and tangent angle in 32 bits
+      --textures [bc7|bc1]
+                       Convert the referenced textures to DDS files with
+                       mip maps, and point the materials at them:
+                       color and emission: BC7, or BC1 if opaque and bc1
+                       normal maps:        BC5
+                       grayscale data:     BC4
+      --tile   float   Split .sub output into a uniform grid of cubes with
+                       this edge length. Every tile is written as its own
+                       .sub file, listed with its bounds in a .tiles file.
+  -t, --threads int    Specifies the number of threads used by mi.
+                       0 creates one thread for each logical CPU.
+                       -x creates as many threads as the number of
+                       logical CPUs minus x.
+                       The default value is 0.)";
 
     std::cout << usage << "\n\n";
 
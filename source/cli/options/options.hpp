@@ -3,20 +3,73 @@
 
 #include "base/flags/flags.hpp"
 #include "core/model/model.hpp"
+#include "core/model/model_exporter_json.hpp"
+#include "core/model/model_exporter_sub.hpp"
+#include "core/model/model_importer_assimp.hpp"
 
 #include <string>
+#include <vector>
 
 namespace options {
 
 struct Options {
-    std::string input;
+    std::vector<std::string> inputs;
 
     std::string output;
 
+    std::string package;
+
     model::Model::Origin origin = model::Model::Origin::Default;
 
     float scale = -1.f;
 
+    float tile_size = -1.f;
+
+    using Layout        = model::Exporter_sub::Layout;
+    using Tangent_space = model::Exporter_sub::Tangent_space;
+    using Json_arrays   = model::Exporter_json::Arrays;
+    using Profile       = model::Importer_assimp::Profile;
+
+    Layout layout = Layout::Separate;
+
+    Tangent_space tangent_space = Tangent_space::Quaternion;
+
+    Json_arrays json_arrays = Json_arrays::Text;
+
+    Profile profile = Profile::Balanced;
+
+    uint32_t alignment = 64;
+
+    int32_t threads = 0;
+
+    bool bvh = false;
+
+    bool dedup_textures = false;
+
+    bool instances = false;
+
+    bool intersection_triangles = false;
+
+    bool lights = false;
+
+    bool lights_per_triangle = false;
+
+    bool merge_parts = false;
+
+    bool merge_parts_spatially = false;
+
+    bool part_chunks = false;
+
+    bool position_stream = false;
+
+    bool report_pp_timing = false;
+
+    bool sort = false;
+
+    bool textures = false;
+
+    bool textures_bc1 = false;
+
     flags::Flags<model::Model::Transformation> transformations;
 };
 
@@ -0,0 +1,432 @@
+#include "bvh_builder.hpp"
+#include "base/math/aabb.inl"
+#include "base/memory/align.hpp"
+#include "base/thread/thread_pool.hpp"
+#include "bvh_node.hpp"
+#include "bvh_tree.hpp"
+#include "core/model/model.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+namespace bvh {
+
+// Nodes with fewer references are not worth to be split in parallel
+static uint32_t constexpr Parallel_split_threshold = 1 << 16;
+
+// Subtrees with fewer references become one task of the second phase
+static uint32_t constexpr Subtree_threshold = 1 << 12;
+
+static uint32_t constexpr Max_leaf_primitives = 0xFF;
+
+static inline float3 center(AABB const& box) noexcept {
+    return 0.5f * (box.bounds[0] + box.bounds[1]);
+}
+
+static inline void set_bounds(Node& node, AABB const& box) noexcept {
+    node.min[0] = box.bounds[0][0];
+    node.min[1] = box.bounds[0][1];
+    node.min[2] = box.bounds[0][2];
+    node.max[0] = box.bounds[1][0];
+    node.max[1] = box.bounds[1][1];
+    node.max[2] = box.bounds[1][2];
+}
+
+static inline void set_leaf(Node& node, uint32_t begin, uint32_t end) noexcept {
+    node.next_or_data   = begin;
+    node.num_primitives = uint8_t(end - begin);
+    node.axis           = 0;
+}
+
+static inline void set_interior(Node& node, uint32_t children, uint32_t axis) noexcept {
+    node.next_or_data   = children;
+    node.num_primitives = 0;
+    node.axis           = uint8_t(axis);
+}
+
+Builder::Builder(Settings const& settings) noexcept
+    : settings_{std::max(settings.num_bins, 2u),
+                std::clamp(settings.max_primitives, 1u, Max_leaf_primitives),
+                settings.traversal_cost, settings.intersection_cost} {}
+
+Builder::Settings const& Builder::settings() const noexcept {
+    return settings_;
+}
+
+void Builder::build(Tree& tree, model::Model const& model, thread::Pool& threads) noexcept {
+    uint32_t const num_triangles = model.num_indices() / 3;
+
+    tree.nodes.clear();
+    tree.triangles.resize(num_triangles);
+
+    if (0 == num_triangles) {
+        return;
+    }
+
+    float3 const*   positions = model.positions();
+    uint32_t const* indices   = model.indices();
+
+    memory::Buffer<AABB> boxes(num_triangles);
+
+    threads.run_range(
+        [&](uint32_t /*id*/, int32_t begin, int32_t end) noexcept {
+            for (int32_t i = begin; i < end; ++i) {
+                float3 const a = positions[indices[i * 3 + 0]];
+                float3 const b = positions[indices[i * 3 + 1]];
+                float3 const c = positions[indices[i * 3 + 2]];
+
+                boxes[i] = AABB(min(a, min(b, c)), max(a, max(b, c)));
+
+                tree.triangles[i] = uint32_t(i);
+            }
+        },
+        0, int32_t(num_triangles));
+
+    references_ = tree.triangles.data();
+    boxes_      = boxes.data();
+
+    uint32_t const num_threads = threads.num_threads();
+
+    uint32_t const num_bins = settings_.num_bins;
+
+    memory::Buffer<Bin> bins(num_threads * 3 * num_bins);
+
+    // Phase 1: Split the upper levels breadth first, until there is enough work for all threads
+    std::vector<Node>& nodes = tree.nodes;
+
+    nodes.reserve(2 * (num_triangles / settings_.max_primitives) + 1);
+    nodes.emplace_back();
+
+    std::vector<Task> tasks;
+    std::vector<Task> subtrees;
+
+    tasks.push_back({0, 0, num_triangles});
+
+    uint32_t const max_subtrees = 4 * num_threads;
+
+    for (size_t t = 0; t < tasks.size(); ++t) {
+        Task const task = tasks[t];
+
+        uint32_t const count = task.end - task.begin;
+
+        if (count < Subtree_threshold || subtrees.size() + (tasks.size() - t) > max_subtrees) {
+            subtrees.push_back(task);
+            continue;
+        }
+
+        uint32_t const middle = split(nodes, task, bins.data(),
+                                      count >= Parallel_split_threshold ? &threads : nullptr);
+
+        if (middle == task.begin) {
+            continue;
+        }
+
+        uint32_t const children = nodes[task.node].next_or_data;
+
+        tasks.push_back({children, task.begin, middle});
+        tasks.push_back({children + 1, middle, task.end});
+    }
+
+    // Phase 2: Build the remaining subtrees concurrently, biggest first
+    std::sort(subtrees.begin(), subtrees.end(), [](Task const& a, Task const& b) {
+        return (a.end - a.begin) > (b.end - b.begin);
+    });
+
+    uint32_t const num_subtrees = uint32_t(subtrees.size());
+
+    std::vector<std::vector<Node>> subtree_nodes(num_subtrees);
+
+    std::atomic<uint32_t> current_subtree = 0;
+
+    threads.run_parallel([&](uint32_t id) noexcept {
+        Bin* thread_bins = bins.data() + id * 3 * num_bins;
+
+        for (;;) {
+            uint32_t const s = current_subtree.fetch_add(1, std::memory_order_relaxed);
+
+            if (s >= num_subtrees) {
+                break;
+            }
+
+            Task const& root = subtrees[s];
+
+            std::vector<Node>& local_nodes = subtree_nodes[s];
+
+            local_nodes.reserve(2 * ((root.end - root.begin) / settings_.max_primitives) + 1);
+            local_nodes.emplace_back();
+
+            build_subtree(local_nodes, {0, root.begin, root.end}, thread_bins);
+        }
+    });
+
+    // Phase 3: Move the subtree roots into their placeholders and append the rest
+    for (uint32_t s = 0; s < num_subtrees; ++s) {
+        std::vector<Node> const& local_nodes = subtree_nodes[s];
+
+        uint32_t const base = uint32_t(nodes.size()) - 1;
+
+        for (size_t i = 0, len = local_nodes.size(); i < len; ++i) {
+            Node n = local_nodes[i];
+
+            if (!n.is_leaf()) {
+                n.next_or_data += base;
+            }
+
+            if (0 == i) {
+                nodes[subtrees[s].node] = n;
+            } else {
+                nodes.push_back(n);
+            }
+        }
+    }
+
+    references_ = nullptr;
+    boxes_      = nullptr;
+}
+
+Builder::Bounds Builder::bounds(uint32_t begin, uint32_t end, thread::Pool* threads) const
+    noexcept {
+    auto const bound = [this](uint32_t begin, uint32_t end) noexcept {
+        Bounds result{AABB::empty(), AABB::empty()};
+
+        for (uint32_t i = begin; i < end; ++i) {
+            AABB const& b = boxes_[references_[i]];
+
+            result.box.merge_assign(b);
+            result.centroids.insert(center(b));
+        }
+
+        return result;
+    };
+
+    if (!threads) {
+        return bound(begin, end);
+    }
+
+    std::vector<Bounds> partial(threads->num_threads(), Bounds{AABB::empty(), AABB::empty()});
+
+    threads->run_range(
+        [&](uint32_t id, int32_t b, int32_t e) noexcept {
+            partial[id] = bound(uint32_t(b), uint32_t(e));
+        },
+        int32_t(begin), int32_t(end));
+
+    Bounds result{AABB::empty(), AABB::empty()};
+
+    for (Bounds const& p : partial) {
+        result.box.merge_assign(p.box);
+        result.centroids.merge_assign(p.centroids);
+    }
+
+    return result;
+}
+
+void Builder::bin(uint32_t begin, uint32_t end, AABB const& centroids, Bin* bins,
+                  thread::Pool* threads) const noexcept {
+    uint32_t const num_bins = settings_.num_bins;
+
+    float3 const origin = centroids.min();
+    float3 const extent = centroids.extent();
+
+    float3 const scale(extent[0] > 0.f ? float(num_bins) / extent[0] : 0.f,
+                       extent[1] > 0.f ? float(num_bins) / extent[1] : 0.f,
+                       extent[2] > 0.f ? float(num_bins) / extent[2] : 0.f);
+
+    auto const bin_range = [&](Bin* target, uint32_t begin, uint32_t end) noexcept {
+        for (uint32_t i = 0, len = 3 * num_bins; i < len; ++i) {
+            target[i] = Bin{AABB::empty(), 0};
+        }
+
+        for (uint32_t i = begin; i < end; ++i) {
+            AABB const& b = boxes_[references_[i]];
+
+            float3 const c = (center(b) - origin) * scale;
+
+            for (uint32_t a = 0; a < 3; ++a) {
+                uint32_t const k = std::min(uint32_t(c[a]), num_bins - 1);
+
+                Bin& bin = target[a * num_bins + k];
+
+                bin.box.merge_assign(b);
+                ++bin.count;
+            }
+        }
+    };
+
+    if (!threads) {
+        bin_range(bins, begin, end);
+        return;
+    }
+
+    uint32_t const bins_per_thread = 3 * num_bins;
+
+    uint32_t const num_threads = threads->num_threads();
+
+    for (uint32_t t = 0; t < num_threads; ++t) {
+        Bin* target = bins + t * bins_per_thread;
+
+        for (uint32_t i = 0; i < bins_per_thread; ++i) {
+            target[i] = Bin{AABB::empty(), 0};
+        }
+    }
+
+    threads->run_range(
+        [&](uint32_t id, int32_t b, int32_t e) noexcept {
+            bin_range(bins + id * bins_per_thread, uint32_t(b), uint32_t(e));
+        },
+        int32_t(begin), int32_t(end));
+
+    for (uint32_t t = 1; t < num_threads; ++t) {
+        Bin const* source = bins + t * bins_per_thread;
+
+        for (uint32_t i = 0; i < bins_per_thread; ++i) {
+            bins[i].box.merge_assign(source[i].box);
+            bins[i].count += source[i].count;
+        }
+    }
+}
+
+bool Builder::find_split(uint32_t begin, uint32_t end, AABB const& box, AABB const& centroids,
+                         Bin const* bins, Split& split) const noexcept {
+    uint32_t const num_bins = settings_.num_bins;
+
+    float const inv_area = 1.f / std::max(box.surface_area(), 1.e-20f);
+
+    std::vector<float> right_areas(num_bins);
+
+    split.cost = float(end - begin) * settings_.intersection_cost;
+
+    bool found = false;
+
+    float3 const extent = centroids.extent();
+
+    for (uint32_t a = 0; a < 3; ++a) {
+        if (extent[a] <= 0.f) {
+            continue;
+        }
+
+        Bin const* axis_bins = bins + a * num_bins;
+
+        AABB right = AABB::empty();
+
+        for (uint32_t k = num_bins - 1; k > 0; --k) {
+            right.merge_assign(axis_bins[k].box);
+            right_areas[k] = right.surface_area();
+        }
+
+        AABB     left       = AABB::empty();
+        uint32_t left_count = 0;
+
+        for (uint32_t k = 1; k < num_bins; ++k) {
+            left.merge_assign(axis_bins[k - 1].box);
+            left_count += axis_bins[k - 1].count;
+
+            uint32_t const right_count = (end - begin) - left_count;
+
+            if (0 == left_count || 0 == right_count) {
+                continue;
+            }
+
+            float const cost = settings_.traversal_cost +
+                               settings_.intersection_cost * inv_area *
+                                   (left.surface_area() * float(left_count) +
+                                    right_areas[k] * float(right_count));
+
+            if (cost < split.cost) {
+                split.axis = a;
+                split.bin  = k;
+                split.cost = cost;
+
+                found = true;
+            }
+        }
+    }
+
+    return found;
+}
+
+uint32_t Builder::split(std::vector<Node>& nodes, Task const& task, Bin* bins,
+                        thread::Pool* threads) noexcept {
+    Bounds const b = bounds(task.begin, task.end, threads);
+
+    set_bounds(nodes[task.node], b.box);
+
+    uint32_t const count = task.end - task.begin;
+
+    if (count <= settings_.max_primitives) {
+        set_leaf(nodes[task.node], task.begin, task.end);
+        return task.begin;
+    }
+
+    bin(task.begin, task.end, b.centroids, bins, threads);
+
+    uint32_t middle;
+
+    uint32_t axis;
+
+    if (Split s; find_split(task.begin, task.end, b.box, b.centroids, bins, s)) {
+        uint32_t const num_bins = settings_.num_bins;
+
+        float const origin = b.centroids.min()[s.axis];
+        float const extent = b.centroids.extent()[s.axis];
+        float const scale  = float(num_bins) / extent;
+
+        AABB const* boxes = boxes_;
+
+        uint32_t* split_point = std::partition(
+            references_ + task.begin, references_ + task.end, [&](uint32_t r) noexcept {
+                float const c = (center(boxes[r])[s.axis] - origin) * scale;
+                return std::min(uint32_t(c), num_bins - 1) < s.bin;
+            });
+
+        middle = uint32_t(split_point - references_);
+        axis   = s.axis;
+    } else if (count <= Max_leaf_primitives) {
+        set_leaf(nodes[task.node], task.begin, task.end);
+        return task.begin;
+    } else {
+        // Too many references that can't be separated by SAH, e.g. identical centroids
+        axis   = index_max_component(b.centroids.extent());
+        middle = task.begin + count / 2;
+
+        AABB const* boxes = boxes_;
+
+        std::nth_element(references_ + task.begin, references_ + middle, references_ + task.end,
+                         [&](uint32_t x, uint32_t y) noexcept {
+                             return center(boxes[x])[axis] < center(boxes[y])[axis];
+                         });
+    }
+
+    uint32_t const children = uint32_t(nodes.size());
+
+    set_interior(nodes[task.node], children, axis);
+
+    nodes.emplace_back();
+    nodes.emplace_back();
+
+    return middle;
+}
+
+void Builder::build_subtree(std::vector<Node>& nodes, Task const& root, Bin* bins) noexcept {
+    std::vector<Task> stack;
+
+    stack.push_back(root);
+
+    while (!stack.empty()) {
+        Task const task = stack.back();
+        stack.pop_back();
+
+        uint32_t const middle = split(nodes, task, bins, nullptr);
+
+        if (middle == task.begin) {
+            continue;
+        }
+
+        uint32_t const children = nodes[task.node].next_or_data;
+
+        stack.push_back({children + 1, middle, task.end});
+        stack.push_back({children, task.begin, middle});
+    }
+}
+
+}  // namespace bvh
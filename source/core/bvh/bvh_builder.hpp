@@ -0,0 +1,86 @@
+#ifndef SU_CORE_BVH_BUILDER_HPP
+#define SU_CORE_BVH_BUILDER_HPP
+
+#include "base/math/aabb.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace model {
+class Model;
+}
+
+namespace thread {
+class Pool;
+}
+
+namespace bvh {
+
+struct Node;
+struct Tree;
+
+// Top-down binned SAH builder.
+// The upper levels are split one node at a time with parallel binning, the remaining subtrees are
+// then built concurrently, one task per subtree.
+class Builder {
+  public:
+    struct Settings {
+        uint32_t num_bins          = 16;
+        uint32_t max_primitives    = 4;
+        float    traversal_cost    = 1.f;
+        float    intersection_cost = 1.f;
+    };
+
+    Builder(Settings const& settings) noexcept;
+
+    Settings const& settings() const noexcept;
+
+    void build(Tree& tree, model::Model const& model, thread::Pool& threads) noexcept;
+
+  private:
+    struct Bin {
+        AABB     box;
+        uint32_t count;
+    };
+
+    struct Split {
+        uint32_t axis;
+        uint32_t bin;
+        float    cost;
+    };
+
+    struct Task {
+        uint32_t node;
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    struct Bounds {
+        AABB box;
+        AABB centroids;
+    };
+
+    Bounds bounds(uint32_t begin, uint32_t end, thread::Pool* threads) const noexcept;
+
+    void bin(uint32_t begin, uint32_t end, AABB const& centroids, Bin* bins,
+             thread::Pool* threads) const noexcept;
+
+    bool find_split(uint32_t begin, uint32_t end, AABB const& box, AABB const& centroids,
+                    Bin const* bins, Split& split) const noexcept;
+
+    // Returns the first reference of the right child, or begin if the node should become a leaf
+    uint32_t split(std::vector<Node>& nodes, Task const& task, Bin* bins,
+                   thread::Pool* threads) noexcept;
+
+    void build_subtree(std::vector<Node>& nodes, Task const& root, Bin* bins) noexcept;
+
+    Settings const settings_;
+
+    uint32_t* references_ = nullptr;
+
+    AABB const* boxes_ = nullptr;
+};
+
+}  // namespace bvh
+
+#endif
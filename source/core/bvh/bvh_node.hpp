@@ -0,0 +1,28 @@
+#ifndef SU_CORE_BVH_NODE_HPP
+#define SU_CORE_BVH_NODE_HPP
+
+#include <cstdint>
+
+namespace bvh {
+
+// 32 bytes, laid out as it is written to file.
+// Interior nodes store the index of the first of their two adjacent children in next_or_data,
+// leaves store the offset of their first triangle in the triangle permutation.
+struct Node {
+    bool is_leaf() const noexcept {
+        return num_primitives > 0;
+    }
+
+    float    min[3];
+    uint32_t next_or_data;
+    float    max[3];
+    uint8_t  num_primitives;
+    uint8_t  axis;
+    uint8_t  pad[2];
+};
+
+static_assert(sizeof(Node) == 32);
+
+}  // namespace bvh
+
+#endif
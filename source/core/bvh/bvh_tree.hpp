@@ -0,0 +1,20 @@
+#ifndef SU_CORE_BVH_TREE_HPP
+#define SU_CORE_BVH_TREE_HPP
+
+#include "bvh_node.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace bvh {
+
+struct Tree {
+    std::vector<Node> nodes;
+
+    // Triangle ids in the order the leaves reference them
+    std::vector<uint32_t> triangles;
+};
+
+}  // namespace bvh
+
+#endif
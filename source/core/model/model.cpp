@@ -1,13 +1,26 @@
 #include "model.hpp"
+#include "base/hash/hash.hpp"
 #include "base/math/aabb.inl"
+#include "base/math/batch.hpp"
+#include "base/math/morton.hpp"
 #include "base/math/quaternion.inl"
 #include "base/math/vector4.inl"
+#include "base/memory/align.hpp"
+#include "base/sort/radix_sort.hpp"
+#include "base/thread/thread_pool.hpp"
+#include "model_bounds.hpp"
 
 #include <assimp/scene.h>
 
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
 namespace model {
 
 Model::~Model() noexcept {
+    delete[] instances_;
+
     delete[] indices_;
 
     delete[] texture_coordinates_;
@@ -36,6 +49,10 @@ uint32_t Model::num_indices() const noexcept {
     return num_indices_;
 }
 
+uint32_t Model::num_instances() const noexcept {
+    return num_instances_;
+}
+
 Model::Part const* Model::parts() const noexcept {
     return parts_;
 }
@@ -44,26 +61,54 @@ Model::Material const* Model::materials() const noexcept {
     return materials_;
 }
 
+Model::Material* Model::materials() noexcept {
+    return materials_;
+}
+
 float3 const* Model::positions() const noexcept {
     return positions_;
 }
 
+float3* Model::positions() noexcept {
+    return positions_;
+}
+
 float3 const* Model::normals() const noexcept {
     return normals_;
 }
 
+float3* Model::normals() noexcept {
+    return normals_;
+}
+
 float4 const* Model::tangents() const noexcept {
     return tangents_and_bitangent_signs_;
 }
 
+float4* Model::tangents() noexcept {
+    return tangents_and_bitangent_signs_;
+}
+
 float2 const* Model::texture_coordinates() const noexcept {
     return texture_coordinates_;
 }
 
+float2* Model::texture_coordinates() noexcept {
+    return texture_coordinates_;
+}
+
 uint32_t const* Model::indices() const noexcept {
     return indices_;
 }
 
+uint32_t* Model::indices() noexcept {
+    return indices_;
+}
+
+Model::Instance const* Model::instances() const noexcept {
+    return instances_;
+}
+
 void Model::allocate_parts(uint32_t num_parts) noexcept {
     num_parts_ = num_parts;
     parts_     = new Part[num_parts];
@@ -100,6 +145,12 @@ void Model::allocate_indices(uint32_t num_indices) noexcept {
     indices_ = new uint32_t[num_indices];
 }
 
+void Model::allocate_instances(uint32_t num_instances) noexcept {
+    num_instances_ = num_instances;
+
+    instances_ = new Instance[num_instances];
+}
+
 void Model::set_part(uint32_t id, Part const& part) noexcept {
     parts_[id] = part;
 }
@@ -213,12 +264,46 @@ void Model::set_index(uint32_t id, uint32_t index) noexcept {
     indices_[id] = index;
 }
 
+void Model::set_instance(uint32_t id, Instance const& instance) noexcept {
+    instances_[id] = instance;
+}
+
 void Model::scale(float3 const& s) noexcept {
-    for (uint32_t i = 0, len = num_vertices_; i < len; ++i) {
-        positions_[i] *= s;
+    math::batch::scale(positions_, num_vertices_, s);
+
+    // Exact for uniform scales, the only ones that keep the rotations rigid
+    for (uint32_t i = 0; i < num_instances_; ++i) {
+        instances_[i].transformation.position *= s;
     }
 }
 
+// The transformations in the order in which they are applied to a single vector
+static float3 transformed(flags::Flags<Model::Transformation> transformations, float3 v) {
+    using Transformation = Model::Transformation;
+
+    if (transformations.is(Transformation::Swap_XY)) {
+        std::swap(v[0], v[1]);
+    }
+
+    if (transformations.is(Transformation::Swap_YZ)) {
+        std::swap(v[1], v[2]);
+    }
+
+    if (transformations.is(Transformation::Reverse_X)) {
+        v[0] = -v[0];
+    }
+
+    if (transformations.is(Transformation::Reverse_Y)) {
+        v[1] = -v[1];
+    }
+
+    if (transformations.is(Transformation::Reverse_Z)) {
+        v[2] = -v[2];
+    }
+
+    return v;
+}
+
 void Model::transform(flags::Flags<Transformation> transformations) noexcept {
     if (transformations.empty()) {
         return;
@@ -230,77 +315,24 @@ void Model::transform(flags::Flags<Transformation> transformations) noexcept {
                                        transformations == Transformation::Reverse_Y ||
                                        transformations == Transformation::Reverse_Z;
 
-    if (positions_) {
-        for (uint32_t i = 0, len = num_vertices_; i < len; ++i) {
-            if (transformations.is(Transformation::Swap_XY)) {
-                std::swap(positions_[i][0], positions_[i][1]);
-            }
+    // Swaps and reversals are linear, the rows are the transformed basis vectors
+    float3x3 const m(transformed(transformations, float3(1.f, 0.f, 0.f)),
+                     transformed(transformations, float3(0.f, 1.f, 0.f)),
+                     transformed(transformations, float3(0.f, 0.f, 1.f)));
 
-            if (transformations.is(Transformation::Swap_YZ)) {
-                std::swap(positions_[i][1], positions_[i][2]);
-            }
-
-            if (transformations.is(Transformation::Reverse_X)) {
-                positions_[i][0] = -positions_[i][0];
-            }
-
-            if (transformations.is(Transformation::Reverse_Y)) {
-                positions_[i][1] = -positions_[i][1];
-            }
-
-            if (transformations.is(Transformation::Reverse_Z)) {
-                positions_[i][2] = -positions_[i][2];
-            }
-        }
+    if (positions_) {
+        math::batch::transform(m, positions_, num_vertices_);
     }
 
     if (normals_) {
-        for (uint32_t i = 0, len = num_vertices_; i < len; ++i) {
-            if (transformations.is(Transformation::Swap_XY)) {
-                std::swap(normals_[i][0], normals_[i][1]);
-            }
-
-            if (transformations.is(Transformation::Swap_YZ)) {
-                std::swap(normals_[i][1], normals_[i][2]);
-            }
-
-            if (transformations.is(Transformation::Reverse_X)) {
-                normals_[i][0] = -normals_[i][0];
-            }
-
-            if (transformations.is(Transformation::Reverse_Y)) {
-                normals_[i][1] = -normals_[i][1];
-            }
-
-            if (transformations.is(Transformation::Reverse_Z)) {
-                normals_[i][2] = -normals_[i][2];
-            }
-        }
+        math::batch::transform(m, normals_, num_vertices_);
     }
 
     if (tangents_and_bitangent_signs_) {
-        for (uint32_t i = 0, len = num_vertices_; i < len; ++i) {
-            if (transformations.is(Transformation::Swap_XY)) {
-                std::swap(tangents_and_bitangent_signs_[i][0], tangents_and_bitangent_signs_[i][1]);
-            }
+        math::batch::transform(m, tangents_and_bitangent_signs_, num_vertices_);
 
-            if (transformations.is(Transformation::Swap_YZ)) {
-                std::swap(tangents_and_bitangent_signs_[i][1], tangents_and_bitangent_signs_[i][2]);
-            }
-
-            if (transformations.is(Transformation::Reverse_X)) {
-                tangents_and_bitangent_signs_[i][0] = -tangents_and_bitangent_signs_[i][0];
-            }
-
-            if (transformations.is(Transformation::Reverse_Y)) {
-                tangents_and_bitangent_signs_[i][1] = -tangents_and_bitangent_signs_[i][1];
-            }
-
-            if (transformations.is(Transformation::Reverse_Z)) {
-                tangents_and_bitangent_signs_[i][2] = -tangents_and_bitangent_signs_[i][2];
-            }
-
-            if (single_transformation) {
+        if (single_transformation) {
+            for (uint32_t i = 0, len = num_vertices_; i < len; ++i) {
                 tangents_and_bitangent_signs_[i][3] = -tangents_and_bitangent_signs_[i][3];
             }
         }
@@ -311,6 +343,19 @@ void Model::transform(flags::Flags<Transformation> transformations) noexcept {
             std::swap(indices_[i + 1], indices_[i + 2]);
         }
     }
+
+    // The parts are transformed in their own space, so the instances have to undo that before
+    // rotating. Conjugating with a reflection still gives a proper rotation.
+    float3x3 const mt = transposed(m);
+
+    for (uint32_t i = 0; i < num_instances_; ++i) {
+        math::Transformation& t = instances_[i].transformation;
+
+        float3x3 const rotation = quaternion::create_matrix3x3(t.rotation);
+
+        t.position = transform_vector(m, t.position);
+        t.rotation = quaternion::create(mt * rotation * m);
+    }
 }
 
 void Model::set_origin(Origin origin) noexcept {
@@ -319,66 +364,93 @@ void Model::set_origin(Origin origin) noexcept {
     }
 
     if (Origin::Center_bottom == origin) {
-        AABB const box = aabb();
+        AABB const box = instanced_aabb();
 
         float3 const position = box.position();
         float3 const halfsize = box.halfsize();
 
         float3 const offset = float3(-position[0], halfsize[1] - position[1], -position[2]);
 
-        for (uint32_t i = 0, len = num_vertices_; i < len; ++i) {
-            positions_[i] += offset;
+        math::batch::translate(positions_, num_vertices_, offset);
+
+        // Moves the copies by the same offset, although their parts moved in their own space
+        for (uint32_t i = 0; i < num_instances_; ++i) {
+            math::Transformation& t = instances_[i].transformation;
+
+            float3x3 const rotation = quaternion::create_matrix3x3(t.rotation);
+
+            t.position += offset - transform_vector(rotation, offset);
         }
     }
 }
 
-AABB Model::aabb() const noexcept {
-    AABB box = AABB::empty();
+AABB Model::instanced_aabb() const noexcept {
+    if (0 == num_instances_) {
+        return aabb();
+    }
+
+    // Only the boxes of instanced parts are needed, serially because there is no pool here
+    std::vector<Part_bounds> bounds(num_parts_);
+
+    for (auto& b : bounds) {
+        b.aabb = AABB::empty();
+    }
+
+    for (uint32_t i = 0; i < num_instances_; ++i) {
+        uint32_t const p = instances_[i].part;
+
+        AABB& box = bounds[p].aabb;
 
-    for (uint32_t i = 0, len = num_vertices_; i < len; ++i) {
-        float3 const p = positions_[i];
+        if (box.min()[0] > box.max()[0]) {
+            Part const& part = parts_[p];
 
-        box.bounds[0] = min(box.bounds[0], p);
-        box.bounds[1] = max(box.bounds[1], p);
+            for (uint32_t j = part.start_index, end = j + part.num_indices; j < end; ++j) {
+                box.insert(positions_[indices_[j]]);
+            }
+        }
     }
 
-    return box;
+    return model::instanced_aabb(*this, bounds.data());
+}
+
+AABB Model::aabb() const noexcept {
+    return math::batch::aabb(positions_, num_vertices_);
 }
 
 void Model::try_to_fix_tangent_space() {
-    if (normals_) {
-        for (uint32_t i = 0, len = num_vertices_; i < len; ++i) {
-            float3& n = normals_[i];
+    uint32_t const num_vertices = num_vertices_;
 
-            float const l = length(n);
+    memory::Buffer<uint8_t> invalid(num_vertices);
 
-            if (l < 0.1f || !all_finite(n)) {
-                n = float3(0.f, 1.f, 0.f);
-            } else if (l < 0.9999f || l > 1.0001f) {
-                n /= l;
+    if (normals_) {
+        if (math::batch::normalize(normals_, num_vertices, 0.1f, 0.0001f, invalid) > 0) {
+            for (uint32_t i = 0; i < num_vertices; ++i) {
+                if (invalid[i]) {
+                    normals_[i] = float3(0.f, 1.f, 0.f);
+                }
             }
         }
     }
 
     if (tangents_and_bitangent_signs_) {
-        for (uint32_t i = 0, len = num_vertices_; i < len; ++i) {
-            float4 const& tbs = tangents_and_bitangent_signs_[i];
+        float4* tangents = tangents_and_bitangent_signs_;
 
-            float3 t = tbs.xyz();
-            ;
-            float const l = length(t);
-
-            if (l < 0.1f || !all_finite(t)) {
-                t = tangent(normals_[i]);
-            } else if (l < 0.999f || l > 1.001f) {
-                t /= l;
+        if (math::batch::normalize(tangents, num_vertices, 0.1f, 0.001f, invalid) > 0) {
+            for (uint32_t i = 0; i < num_vertices; ++i) {
+                if (invalid[i]) {
+                    tangents[i] = float4(tangent(normals_[i]), tangents[i][3]);
+                }
             }
+        }
 
-            if (std::abs(dot(t, normals_[i])) > 0.04f) {
-                t = tangent(normals_[i]);
-            }
+        memory::Buffer<float> dots(num_vertices);
+
+        math::batch::dot(normals_, tangents, dots, num_vertices);
 
-            tangents_and_bitangent_signs_[i] = float4(t, tbs[3]);
+        for (uint32_t i = 0; i < num_vertices; ++i) {
+            if (std::abs(dots[i]) > 0.04f) {
+                tangents[i] = float4(tangent(normals_[i]), tangents[i][3]);
+            }
         }
     }
 }
@@ -411,4 +483,783 @@ Quaternion Model::tangent_space(float3 const& t, float3 const& n, float bitangen
     return q;
 }
 
+// Parts are compared in a canonical pose: Centered on the mean of their vertices and rotated into
+// the frame spanned by their first sufficiently large triangle. Because the frame is derived from
+// the part's own index order, two parts that only differ by a rigid transformation end up with the
+// same canonical vertices, which makes them easy to hash and to verify.
+
+struct Canonical_pose {
+    float3   center;
+    float3x3 frame;
+    float    radius;
+    uint64_t hash;
+    bool     valid;
+};
+
+static uint32_t constexpr Unused_vertex = 0xFFFFFFFF;
+
+static Canonical_pose canonical_pose(Model::Part const& part, uint32_t const* indices,
+                                     float3 const* positions, uint32_t* local_ids) noexcept {
+    Canonical_pose pose;
+    pose.valid = false;
+
+    uint32_t const begin = part.start_index;
+    uint32_t const end   = part.start_index + part.num_indices;
+
+    if (0 == part.num_indices) {
+        return pose;
+    }
+
+    // The topology in first-use order is independent of how the part is placed in the model
+    uint64_t h = hash::fnv_1a(part.num_indices, hash::Fnv_offset_basis);
+    h          = hash::fnv_1a(part.material_index, h);
+
+    uint32_t num_local_vertices = 0;
+
+    float3 center(0.f);
+
+    for (uint32_t i = begin; i < end; ++i) {
+        uint32_t const v = indices[i];
+
+        if (Unused_vertex == local_ids[v]) {
+            local_ids[v] = num_local_vertices++;
+
+            center += positions[v];
+        }
+
+        h = hash::fnv_1a(local_ids[v], h);
+    }
+
+    center /= float(num_local_vertices);
+
+    float radius = 0.f;
+
+    for (uint32_t i = begin; i < end; ++i) {
+        uint32_t const v = indices[i];
+
+        if (Unused_vertex != local_ids[v]) {
+            local_ids[v] = Unused_vertex;
+
+            radius = std::max(squared_distance(positions[v], center), radius);
+        }
+    }
+
+    radius = std::sqrt(radius);
+
+    if (!(radius > 0.f) || !std::isfinite(radius)) {
+        return pose;
+    }
+
+    float const min_area = 0.01f * radius * radius;
+
+    for (uint32_t i = begin; i < end; i += 3) {
+        float3 const p0 = positions[indices[i + 0]];
+        float3 const e1 = positions[indices[i + 1]] - p0;
+        float3 const e2 = positions[indices[i + 2]] - p0;
+
+        float3 const n = cross(e1, e2);
+
+        if (length(n) > min_area) {
+            float3 const x = normalize(e1);
+            float3 const z = normalize(n);
+            float3 const y = cross(z, x);
+
+            pose.frame = float3x3(x, y, z);
+            pose.valid = true;
+            break;
+        }
+    }
+
+    if (!pose.valid) {
+        return pose;
+    }
+
+    // Coarse enough that float noise from baked transformations rarely crosses a cell boundary.
+    // A miss only costs an instance, because every hash match is verified afterwards.
+    float const quantization = 64.f / radius;
+
+    for (uint32_t i = begin; i < end; ++i) {
+        float3 const q = transform_vector_transposed(pose.frame, positions[indices[i]] - center);
+
+        int32_t const cell[3] = {int32_t(std::lround(q[0] * quantization)),
+                                 int32_t(std::lround(q[1] * quantization)),
+                                 int32_t(std::lround(q[2] * quantization))};
+
+        h = hash::fnv_1a(cell, h);
+    }
+
+    pose.center = center;
+    pose.radius = radius;
+    pose.hash   = h;
+
+    return pose;
+}
+
+static bool nearly_equal(float3 const& a, float3 const& b, float epsilon) noexcept {
+    return std::abs(a[0] - b[0]) <= epsilon && std::abs(a[1] - b[1]) <= epsilon &&
+           std::abs(a[2] - b[2]) <= epsilon;
+}
+
+uint32_t Model::find_instances() noexcept {
+    if (!positions_ || num_parts_ < 2) {
+        return 0;
+    }
+
+    memory::Buffer<uint32_t> local_ids(num_vertices_);
+
+    std::fill(local_ids.data(), local_ids.data() + num_vertices_, Unused_vertex);
+
+    std::vector<Canonical_pose> poses(num_parts_);
+
+    for (uint32_t i = 0; i < num_parts_; ++i) {
+        poses[i] = canonical_pose(parts_[i], indices_, positions_, local_ids.data());
+    }
+
+    // Parts that already carry instances stay where they are, so that we don't have to compose
+    // transformations
+    std::vector<bool> instanced(num_parts_, false);
+
+    for (uint32_t i = 0; i < num_instances_; ++i) {
+        instanced[instances_[i].part] = true;
+    }
+
+    std::unordered_map<uint64_t, std::vector<uint32_t>> prototypes;
+
+    std::vector<uint32_t> prototype_of(num_parts_);
+
+    std::vector<Instance> instances;
+
+    for (uint32_t i = 0; i < num_parts_; ++i) {
+        prototype_of[i] = i;
+
+        Canonical_pose const& b = poses[i];
+
+        if (!b.valid) {
+            continue;
+        }
+
+        auto& candidates = prototypes[b.hash];
+
+        if (!instanced[i]) {
+            for (uint32_t const c : candidates) {
+                Canonical_pose const& a = poses[c];
+
+                if (std::abs(a.radius - b.radius) > 0.0001f * a.radius) {
+                    continue;
+                }
+
+                // Maps a vector from part a to part b
+                float3x3 const rotation = transposed(a.frame) * b.frame;
+
+                float3 const translation = b.center - transform_vector(rotation, a.center);
+
+                float const epsilon = 0.00001f * (a.radius + std::max(length(a.center),
+                                                                      length(b.center)));
+
+                Part const& pa = parts_[c];
+                Part const& pb = parts_[i];
+
+                bool equal = true;
+
+                for (uint32_t j = 0; j < pa.num_indices && equal; ++j) {
+                    uint32_t const va = indices_[pa.start_index + j];
+                    uint32_t const vb = indices_[pb.start_index + j];
+
+                    float3 const p = transform_vector(rotation, positions_[va]) + translation;
+
+                    equal = nearly_equal(p, positions_[vb], epsilon);
+
+                    if (equal && normals_) {
+                        float3 const n = transform_vector(rotation, normals_[va]);
+
+                        equal = nearly_equal(n, normals_[vb], 0.001f);
+                    }
+
+                    if (equal && tangents_and_bitangent_signs_) {
+                        float4 const ta = tangents_and_bitangent_signs_[va];
+                        float4 const tb = tangents_and_bitangent_signs_[vb];
+
+                        float3 const t = transform_vector(rotation, ta.xyz());
+
+                        equal = nearly_equal(t, tb.xyz(), 0.001f) && ta[3] == tb[3];
+                    }
+
+                    if (equal && texture_coordinates_) {
+                        float2 const uva = texture_coordinates_[va];
+                        float2 const uvb = texture_coordinates_[vb];
+
+                        equal = std::abs(uva[0] - uvb[0]) <= 0.00001f &&
+                                std::abs(uva[1] - uvb[1]) <= 0.00001f;
+                    }
+                }
+
+                if (equal) {
+                    prototype_of[i] = c;
+
+                    Quaternion const q = quaternion::create(rotation);
+
+                    instances.push_back({c, {translation, float3(1.f), q}});
+                    break;
+                }
+            }
+        }
+
+        if (i == prototype_of[i]) {
+            candidates.push_back(i);
+        }
+    }
+
+    if (instances.empty()) {
+        return 0;
+    }
+
+    // Keep the prototypes only and renumber them
+    std::vector<uint32_t> part_ids(num_parts_);
+
+    uint32_t num_parts   = 0;
+    uint32_t num_indices = 0;
+
+    for (uint32_t i = 0; i < num_parts_; ++i) {
+        if (i == prototype_of[i]) {
+            part_ids[i] = num_parts++;
+            num_indices += parts_[i].num_indices;
+        }
+    }
+
+    Part*     parts   = new Part[num_parts];
+    uint32_t* indices = new uint32_t[num_indices];
+
+    uint32_t current_index = 0;
+
+    for (uint32_t i = 0; i < num_parts_; ++i) {
+        if (i != prototype_of[i]) {
+            continue;
+        }
+
+        Part const& p = parts_[i];
+
+        std::copy(indices_ + p.start_index, indices_ + p.start_index + p.num_indices,
+                  indices + current_index);
+
+        parts[part_ids[i]] = Part{current_index, p.num_indices, p.material_index};
+
+        current_index += p.num_indices;
+    }
+
+    uint32_t const num_removed = num_parts_ - num_parts;
+
+    delete[] parts_;
+    delete[] indices_;
+
+    num_parts_   = num_parts;
+    parts_       = parts;
+    num_indices_ = num_indices;
+    indices_     = indices;
+
+    Instance* all_instances = new Instance[num_instances_ + instances.size()];
+
+    for (uint32_t i = 0; i < num_instances_; ++i) {
+        all_instances[i]      = instances_[i];
+        all_instances[i].part = part_ids[instances_[i].part];
+    }
+
+    for (uint32_t i = 0, len = uint32_t(instances.size()); i < len; ++i) {
+        Instance& instance = all_instances[num_instances_ + i];
+
+        instance      = instances[i];
+        instance.part = part_ids[instances[i].part];
+    }
+
+    delete[] instances_;
+
+    num_instances_ += uint32_t(instances.size());
+    instances_ = all_instances;
+
+    // Drop the vertices that were only referenced by the removed parts
+    std::fill(local_ids.data(), local_ids.data() + num_vertices_, Unused_vertex);
+
+    for (uint32_t i = 0; i < num_indices_; ++i) {
+        local_ids[indices_[i]] = 0;
+    }
+
+    std::vector<uint32_t> sources;
+    sources.reserve(num_vertices_);
+
+    for (uint32_t i = 0; i < num_vertices_; ++i) {
+        if (Unused_vertex != local_ids[i]) {
+            local_ids[i] = uint32_t(sources.size());
+            sources.push_back(i);
+        }
+    }
+
+    for (uint32_t i = 0; i < num_indices_; ++i) {
+        indices_[i] = local_ids[indices_[i]];
+    }
+
+    gather_vertices(sources.data(), uint32_t(sources.size()));
+
+    return num_removed;
+}
+
+static uint32_t constexpr Morton_max = (1 << 21) - 1;
+
+static inline uint64_t morton_code(float3 const& p, float3 const& origin,
+                                   float3 const& scale) noexcept {
+    float3 const q = min(max((p - origin) * scale, 0.f), float(Morton_max));
+
+    return math::morton::encode(uint32_t(q[0]), uint32_t(q[1]), uint32_t(q[2]));
+}
+
+static float3 morton_scale(AABB const& box) noexcept {
+    float3 const extent = box.extent();
+
+    return float3(extent[0] > 0.f ? float(Morton_max) / extent[0] : 0.f,
+                  extent[1] > 0.f ? float(Morton_max) / extent[1] : 0.f,
+                  extent[2] > 0.f ? float(Morton_max) / extent[2] : 0.f);
+}
+
+// Morton codes of the triangle centers, next to the triangle ids
+static void triangle_morton_codes(float3 const* positions, uint32_t const* indices,
+                                  uint32_t num_triangles, AABB const& box, uint64_t* keys,
+                                  uint32_t* triangles, thread::Pool& threads) noexcept {
+    float3 const origin = box.min();
+    float3 const scale  = morton_scale(box);
+
+    threads.run_range(
+        [&](uint32_t /*id*/, int32_t begin, int32_t end) noexcept {
+            for (int32_t t = begin; t < end; ++t) {
+                uint32_t const* tri = indices + t * 3;
+
+                float3 const center = (positions[tri[0]] + positions[tri[1]] +
+                                       positions[tri[2]]) /
+                                      3.f;
+
+                keys[t]      = morton_code(center, origin, scale);
+                triangles[t] = uint32_t(t);
+            }
+        },
+        0, int32_t(num_triangles));
+}
+
+// Stable, so triangles of the same rank keep the order they already have in triangles
+static void sort_by_rank(uint64_t* keys, uint32_t* triangles, uint32_t const* triangle_ranks,
+                         uint32_t num_triangles, uint32_t max_rank, thread::Pool& threads) noexcept {
+    for (uint32_t i = 0; i < num_triangles; ++i) {
+        keys[i] = triangle_ranks[triangles[i]];
+    }
+
+    uint32_t num_rank_bits = 1;
+    while ((uint64_t(1) << num_rank_bits) <= max_rank) {
+        ++num_rank_bits;
+    }
+
+    sort::radix_sort(keys, triangles, num_triangles, num_rank_bits, threads);
+}
+
+static uint32_t* gather_triangles(uint32_t const* indices, uint32_t num_indices,
+                                  uint32_t const* triangles) noexcept {
+    uint32_t const num_triangles = num_indices / 3;
+
+    uint32_t* result = new uint32_t[num_indices];
+
+    for (uint32_t i = 0; i < num_triangles; ++i) {
+        uint32_t const* tri = indices + triangles[i] * 3;
+
+        result[i * 3 + 0] = tri[0];
+        result[i * 3 + 1] = tri[1];
+        result[i * 3 + 2] = tri[2];
+    }
+
+    // Incomplete triangle
+    std::copy(indices + num_triangles * 3, indices + num_indices, result + num_triangles * 3);
+
+    return result;
+}
+
+uint32_t Model::merge_parts(bool spatially, thread::Pool& threads) noexcept {
+    uint32_t const num_triangles = num_indices_ / 3;
+
+    if (num_parts_ < 2 || 0 == num_triangles) {
+        return 0;
+    }
+
+    // Instances place a part relative to its own position, so those parts stay on their own
+    std::vector<bool> instanced(num_parts_, false);
+
+    for (uint32_t i = 0; i < num_instances_; ++i) {
+        instanced[instances_[i].part] = true;
+    }
+
+    std::vector<uint32_t> part_order(num_parts_);
+    std::iota(part_order.begin(), part_order.end(), 0);
+
+    std::stable_sort(part_order.begin(), part_order.end(), [&](uint32_t a, uint32_t b) {
+        if (parts_[a].material_index != parts_[b].material_index) {
+            return parts_[a].material_index < parts_[b].material_index;
+        }
+
+        return !instanced[a] && instanced[b];
+    });
+
+    std::vector<Part> parts;
+
+    std::vector<uint32_t> part_ranks(num_parts_);
+
+    bool mergeable = false;
+
+    for (uint32_t const i : part_order) {
+        Part const& p = parts_[i];
+
+        if (!mergeable || instanced[i] || parts.back().material_index != p.material_index) {
+            parts.push_back(Part{0, 0, p.material_index});
+        }
+
+        parts.back().num_indices += p.num_indices;
+
+        part_ranks[i] = uint32_t(parts.size() - 1);
+
+        mergeable = !instanced[i];
+    }
+
+    uint32_t const num_merged = uint32_t(parts.size());
+
+    if (num_merged == num_parts_ && !spatially) {
+        return 0;
+    }
+
+    // Triangles that don't belong to any part go to the end
+    memory::Buffer<uint32_t> triangle_ranks(num_triangles);
+
+    std::fill(triangle_ranks.data(), triangle_ranks.data() + num_triangles, num_merged);
+
+    for (uint32_t i = 0; i < num_parts_; ++i) {
+        Part const& p = parts_[i];
+
+        uint32_t const begin = p.start_index / 3;
+
+        std::fill(triangle_ranks.data() + begin, triangle_ranks.data() + begin + p.num_indices / 3,
+                  part_ranks[i]);
+    }
+
+    memory::Buffer<uint64_t> keys(num_triangles);
+    memory::Buffer<uint32_t> triangles(num_triangles);
+
+    if (spatially && positions_) {
+        triangle_morton_codes(positions_, indices_, num_triangles, aabb(), keys, triangles,
+                              threads);
+
+        sort::radix_sort(keys.data(), triangles.data(), num_triangles, 63, threads);
+    } else {
+        std::iota(triangles.data(), triangles.data() + num_triangles, 0);
+    }
+
+    sort_by_rank(keys, triangles, triangle_ranks, num_triangles, num_merged, threads);
+
+    uint32_t* indices = gather_triangles(indices_, num_indices_, triangles);
+
+    delete[] indices_;
+    indices_ = indices;
+
+    uint32_t start_index = 0;
+
+    for (auto& p : parts) {
+        p.start_index = start_index;
+
+        start_index += p.num_indices;
+    }
+
+    delete[] parts_;
+
+    parts_ = new Part[num_merged];
+
+    std::copy(parts.begin(), parts.end(), parts_);
+
+    for (uint32_t i = 0; i < num_instances_; ++i) {
+        instances_[i].part = part_ranks[instances_[i].part];
+    }
+
+    uint32_t const num_removed = num_parts_ - num_merged;
+
+    num_parts_ = num_merged;
+
+    return num_removed;
+}
+
+void Model::sort_spatially(thread::Pool& threads) noexcept {
+    uint32_t const num_triangles = num_indices_ / 3;
+
+    if (!positions_ || 0 == num_triangles) {
+        return;
+    }
+
+    AABB const box = aabb();
+
+    float3 const origin = box.min();
+    float3 const scale  = morton_scale(box);
+
+    memory::Buffer<uint64_t> keys(num_triangles);
+    memory::Buffer<uint32_t> triangles(num_triangles);
+
+    triangle_morton_codes(positions_, indices_, num_triangles, box, keys, triangles, threads);
+
+    // Parts are ordered by the code of their mean triangle center
+    std::vector<uint64_t> part_keys(num_parts_);
+
+    threads.run_range(
+        [&](uint32_t /*id*/, int32_t begin, int32_t end) noexcept {
+            for (int32_t i = begin; i < end; ++i) {
+                Part const& p = parts_[i];
+
+                float3 center(0.f);
+
+                for (uint32_t j = p.start_index, len = p.start_index + p.num_indices; j < len;
+                     ++j) {
+                    center += positions_[indices_[j]];
+                }
+
+                center /= float(std::max(p.num_indices, 1u));
+
+                part_keys[i] = morton_code(center, origin, scale);
+            }
+        },
+        0, int32_t(num_parts_));
+
+    std::vector<uint32_t> part_order(num_parts_);
+    std::iota(part_order.begin(), part_order.end(), 0);
+
+    std::stable_sort(part_order.begin(), part_order.end(),
+                     [&part_keys](uint32_t a, uint32_t b) { return part_keys[a] < part_keys[b]; });
+
+    std::vector<uint32_t> part_ranks(num_parts_);
+
+    for (uint32_t r = 0; r < num_parts_; ++r) {
+        part_ranks[part_order[r]] = r;
+    }
+
+    // Triangles that don't belong to any part go to the end
+    memory::Buffer<uint32_t> triangle_ranks(num_triangles);
+
+    std::fill(triangle_ranks.data(), triangle_ranks.data() + num_triangles, num_parts_);
+
+    for (uint32_t i = 0; i < num_parts_; ++i) {
+        Part const& p = parts_[i];
+
+        uint32_t const begin = p.start_index / 3;
+
+        std::fill(triangle_ranks.data() + begin, triangle_ranks.data() + begin + p.num_indices / 3,
+                  part_ranks[i]);
+    }
+
+    // Two stable passes result in triangles sorted by part first and by code second
+    sort::radix_sort(keys.data(), triangles.data(), num_triangles, 63, threads);
+
+    sort_by_rank(keys, triangles, triangle_ranks, num_triangles, num_parts_, threads);
+
+    uint32_t* indices = gather_triangles(indices_, num_indices_, triangles);
+
+    delete[] indices_;
+    indices_ = indices;
+
+    Part* parts = new Part[num_parts_];
+
+    uint32_t start_index = 0;
+
+    for (uint32_t r = 0; r < num_parts_; ++r) {
+        Part const& p = parts_[part_order[r]];
+
+        parts[r] = Part{start_index, p.num_indices, p.material_index};
+
+        start_index += p.num_indices;
+    }
+
+    delete[] parts_;
+    parts_ = parts;
+
+    for (uint32_t i = 0; i < num_instances_; ++i) {
+        instances_[i].part = part_ranks[instances_[i].part];
+    }
+
+    // Vertices in the order they are first referenced
+    memory::Buffer<uint32_t> new_ids(num_vertices_);
+
+    std::fill(new_ids.data(), new_ids.data() + num_vertices_, Unused_vertex);
+
+    std::vector<uint32_t> sources;
+    sources.reserve(num_vertices_);
+
+    for (uint32_t i = 0; i < num_indices_; ++i) {
+        uint32_t const v = indices_[i];
+
+        if (Unused_vertex == new_ids[v]) {
+            new_ids[v] = uint32_t(sources.size());
+            sources.push_back(v);
+        }
+
+        indices_[i] = new_ids[v];
+    }
+
+    gather_vertices(sources.data(), uint32_t(sources.size()));
+}
+
+uint32_t Model::localize_parts(uint32_t max_vertices) noexcept {
+    if (0 == num_indices_ || max_vertices < 3) {
+        return 0;
+    }
+
+    memory::Buffer<uint32_t> new_ids(num_vertices_);
+
+    std::fill(new_ids.data(), new_ids.data() + num_vertices_, Unused_vertex);
+
+    std::vector<uint32_t> sources;
+    sources.reserve(num_vertices_);
+
+    std::vector<uint32_t> touched;
+
+    // Indices are renumbered in place, a run only ever sees its own copies of the vertices
+    auto const begin_run = [&]() {
+        for (uint32_t const v : touched) {
+            new_ids[v] = Unused_vertex;
+        }
+
+        touched.clear();
+    };
+
+    auto const renumber = [&](uint32_t i) {
+        uint32_t const v = indices_[i];
+
+        if (Unused_vertex == new_ids[v]) {
+            new_ids[v] = uint32_t(sources.size());
+            sources.push_back(v);
+            touched.push_back(v);
+        }
+
+        indices_[i] = new_ids[v];
+    };
+
+    std::vector<bool> covered(num_indices_, false);
+
+    std::vector<Part> parts;
+
+    std::vector<uint32_t> first_pieces(num_parts_ + 1);
+
+    for (uint32_t i = 0; i < num_parts_; ++i) {
+        Part const& p = parts_[i];
+
+        first_pieces[i] = uint32_t(parts.size());
+
+        begin_run();
+
+        parts.push_back(Part{p.start_index, 0, p.material_index});
+
+        for (uint32_t j = p.start_index, end = p.start_index + p.num_indices; j < end; j += 3) {
+            uint32_t const len = std::min(end - j, 3u);
+
+            uint32_t num_new = 0;
+
+            for (uint32_t k = 0; k < len; ++k) {
+                uint32_t const v = indices_[j + k];
+
+                // Count repeated vertices of degenerate triangles only once
+                bool const repeated = (k > 0 && v == indices_[j]) ||
+                                      (k > 1 && v == indices_[j + 1]);
+
+                if (Unused_vertex == new_ids[v] && !repeated) {
+                    ++num_new;
+                }
+            }
+
+            if (touched.size() + num_new > max_vertices) {
+                begin_run();
+
+                parts.push_back(Part{j, 0, p.material_index});
+            }
+
+            for (uint32_t k = 0; k < len; ++k) {
+                renumber(j + k);
+
+                covered[j + k] = true;
+            }
+
+            parts.back().num_indices += len;
+        }
+    }
+
+    first_pieces[num_parts_] = uint32_t(parts.size());
+
+    // Indices outside of all parts keep referencing valid vertices
+    begin_run();
+
+    for (uint32_t i = 0; i < num_indices_; ++i) {
+        if (!covered[i]) {
+            renumber(i);
+        }
+    }
+
+    gather_vertices(sources.data(), uint32_t(sources.size()));
+
+    uint32_t const num_added = uint32_t(parts.size()) - num_parts_;
+
+    if (0 == num_added) {
+        return 0;
+    }
+
+    delete[] parts_;
+
+    num_parts_ = uint32_t(parts.size());
+    parts_     = new Part[num_parts_];
+
+    std::copy(parts.begin(), parts.end(), parts_);
+
+    // An instance of a split part becomes one instance per piece
+    if (num_instances_ > 0) {
+        std::vector<Instance> instances;
+
+        for (uint32_t i = 0; i < num_instances_; ++i) {
+            Instance const& instance = instances_[i];
+
+            for (uint32_t j = first_pieces[instance.part], end = first_pieces[instance.part + 1];
+                 j < end; ++j) {
+                instances.push_back(Instance{j, instance.transformation});
+            }
+        }
+
+        delete[] instances_;
+
+        num_instances_ = uint32_t(instances.size());
+        instances_     = new Instance[num_instances_];
+
+        std::copy(instances.begin(), instances.end(), instances_);
+    }
+
+    return num_added;
+}
+
+template <typename T>
+static T* gather(T const* source, uint32_t const* sources, uint32_t num_vertices) noexcept {
+    if (!source) {
+        return nullptr;
+    }
+
+    T* result = new T[num_vertices];
+
+    for (uint32_t i = 0; i < num_vertices; ++i) {
+        result[i] = source[sources[i]];
+    }
+
+    delete[] source;
+
+    return result;
+}
+
+void Model::gather_vertices(uint32_t const* sources, uint32_t num_vertices) noexcept {
+    positions_ = gather(positions_, sources, num_vertices);
+    normals_   = gather(normals_, sources, num_vertices);
+
+    tangents_and_bitangent_signs_ = gather(tangents_and_bitangent_signs_, sources, num_vertices);
+
+    texture_coordinates_ = gather(texture_coordinates_, sources, num_vertices);
+
+    num_vertices_ = num_vertices;
+}
+
 }  // namespace model
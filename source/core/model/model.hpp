@@ -4,6 +4,7 @@
 #include "base/flags/flags.hpp"
 #include "base/math/aabb.hpp"
 #include "base/math/quaternion.hpp"
+#include "base/math/transformation.hpp"
 #include "base/math/vector3.hpp"
 
 #include <cstdint>
@@ -11,6 +12,10 @@
 
 struct aiMaterial;
 
+namespace thread {
+class Pool;
+}
+
 namespace model {
 class Model {
   public:
@@ -55,6 +60,13 @@ class Model {
         bool two_sided = false;
     };
 
+    // Places a copy of part at transformation, relative to the part's own position.
+    struct Instance {
+        uint32_t part;
+
+        math::Transformation transformation;
+    };
+
     ~Model() noexcept;
 
     uint32_t num_parts() const noexcept;
@@ -65,19 +77,29 @@ class Model {
 
     uint32_t num_indices() const noexcept;
 
+    uint32_t num_instances() const noexcept;
+
     Part const* parts() const noexcept;
 
     Material const* materials() const noexcept;
+    Material*       materials() noexcept;
 
     float3 const* positions() const noexcept;
+    float3*       positions() noexcept;
 
     float3 const* normals() const noexcept;
+    float3*       normals() noexcept;
 
     float4 const* tangents() const noexcept;
+    float4*       tangents() noexcept;
 
     float2 const* texture_coordinates() const noexcept;
+    float2*       texture_coordinates() noexcept;
 
     uint32_t const* indices() const noexcept;
+    uint32_t*       indices() noexcept;
+
+    Instance const* instances() const noexcept;
 
     void allocate_parts(uint32_t num_parts) noexcept;
 
@@ -95,6 +117,8 @@ class Model {
 
     void allocate_indices(uint32_t num_indices) noexcept;
 
+    void allocate_instances(uint32_t num_instances) noexcept;
+
     void set_part(uint32_t id, Part const& part) noexcept;
 
     void set_material(uint32_t id, aiMaterial const& material) noexcept;
@@ -111,6 +135,8 @@ class Model {
 
     void set_index(uint32_t id, uint32_t index) noexcept;
 
+    void set_instance(uint32_t id, Instance const& instance) noexcept;
+
     void scale(float3 const& s) noexcept;
 
     void transform(flags::Flags<Transformation> transformtions) noexcept;
@@ -119,11 +145,36 @@ class Model {
 
     AABB aabb() const noexcept;
 
+    // Also covers the copies that instances place elsewhere
+    AABB instanced_aabb() const noexcept;
+
     void try_to_fix_tangent_space();
 
+    // Collapses parts that are identical up to a rigid transformation into one part plus instances.
+    // Returns the number of removed parts.
+    uint32_t find_instances() noexcept;
+
+    // Gathers the triangles of all parts with the same material into one part, ordered by material.
+    // Parts referenced by instances stay separate. With spatially, the triangles of every part are
+    // ordered by the Morton code of their centroids, otherwise they keep their relative order.
+    // Returns the number of removed parts.
+    uint32_t merge_parts(bool spatially, thread::Pool& threads) noexcept;
+
+    // Orders parts and the triangles within each part by the Morton code of their centroids,
+    // and renumbers the vertices in the order of their first use.
+    void sort_spatially(thread::Pool& threads) noexcept;
+
+    // Renumbers the vertices so that every part references a contiguous range of at most
+    // max_vertices vertices. Vertices shared between parts are duplicated, and parts that touch
+    // more vertices are split into consecutive runs of triangles with the same material.
+    // Returns the number of added parts.
+    uint32_t localize_parts(uint32_t max_vertices) noexcept;
+
     static Quaternion tangent_space(float3 const& t, float3 const& n, float bitangent_sign);
 
   private:
+    void gather_vertices(uint32_t const* sources, uint32_t num_vertices) noexcept;
+
     uint32_t num_parts_ = 0;
 
     uint32_t num_materials_ = 0;
@@ -144,7 +195,11 @@ class Model {
 
     float2* texture_coordinates_ = nullptr;
 
-    uint32_t* indices_;
+    uint32_t* indices_ = nullptr;
+
+    uint32_t num_instances_ = 0;
+
+    Instance* instances_ = nullptr;
 };
 }  // namespace model
 
@@ -0,0 +1,284 @@
+#include "model_bounds.hpp"
+#include "base/math/aabb.inl"
+#include "base/math/quaternion.inl"
+#include "base/thread/thread_pool.hpp"
+#include "model.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+namespace model {
+
+static Part_bounds part_bounds(Model::Part const& part, uint32_t const* indices,
+                               float3 const* positions) noexcept;
+
+static Uv_density uv_density(Model::Part const& part, uint32_t const* indices,
+                             float3 const* positions, float2 const* uvs,
+                             std::vector<float2>& ratios) noexcept;
+
+void compute_part_bounds(Model const& model, Part_bounds* bounds, thread::Pool& threads) noexcept {
+    uint32_t const num_parts = model.num_parts();
+
+    std::atomic<uint32_t> current = 0;
+
+    // Parts can differ a lot in size
+    threads.run_parallel([&](uint32_t /*id*/) noexcept {
+        for (;;) {
+            uint32_t const p = current.fetch_add(1, std::memory_order_relaxed);
+
+            if (p >= num_parts) {
+                return;
+            }
+
+            bounds[p] = part_bounds(model.parts()[p], model.indices(), model.positions());
+        }
+    });
+}
+
+AABB instanced_aabb(Model const& model, Part_bounds const* bounds) noexcept {
+    AABB result = model.aabb();
+
+    Model::Instance const* instances = model.instances();
+    for (uint32_t i = 0, len = model.num_instances(); i < len; ++i) {
+        math::Transformation const& t = instances[i].transformation;
+
+        AABB const& box = bounds[instances[i].part].aabb;
+
+        if (box.min()[0] > box.max()[0]) {
+            continue;
+        }
+
+        float3x3 const rotation = quaternion::create_matrix3x3(t.rotation);
+
+        float3 const center   = transform_vector(rotation, box.position()) + t.position;
+        float3 const halfsize = box.halfsize();
+
+        float3 extent(0.f);
+
+        for (uint32_t c = 0; c < 3; ++c) {
+            extent[c] = std::abs(rotation.r[0][c]) * halfsize[0] +
+                        std::abs(rotation.r[1][c]) * halfsize[1] +
+                        std::abs(rotation.r[2][c]) * halfsize[2];
+        }
+
+        result.merge_assign(AABB(center - extent, center + extent));
+    }
+
+    return result;
+}
+
+void compute_uv_densities(Model const& model, Uv_density* densities,
+                          thread::Pool& threads) noexcept {
+    uint32_t const num_parts = model.num_parts();
+
+    std::atomic<uint32_t> current = 0;
+
+    threads.run_parallel([&](uint32_t /*id*/) noexcept {
+        std::vector<float2> ratios;
+
+        for (;;) {
+            uint32_t const p = current.fetch_add(1, std::memory_order_relaxed);
+
+            if (p >= num_parts) {
+                return;
+            }
+
+            densities[p] = uv_density(model.parts()[p], model.indices(), model.positions(),
+                                      model.texture_coordinates(), ratios);
+        }
+    });
+}
+
+Part_bounds part_bounds(Model::Part const& part, uint32_t const* indices,
+                        float3 const* positions) noexcept {
+    Part_bounds result;
+
+    result.aabb          = AABB::empty();
+    result.sphere_center = float3(0.f);
+    result.sphere_radius = 0.f;
+    result.cone_apex     = float3(0.f);
+    result.cone_axis     = float3(0.f);
+    result.cone_cutoff   = 1.f;
+
+    uint32_t const begin = part.start_index;
+    uint32_t const end   = part.start_index + part.num_indices;
+
+    if (begin == end) {
+        return result;
+    }
+
+    // Ritter's sphere, seeded with the most distant pair of the points extreme along an axis
+    float3 extremes[6];
+
+    for (uint32_t a = 0; a < 6; ++a) {
+        extremes[a] = positions[indices[begin]];
+    }
+
+    for (uint32_t i = begin; i < end; ++i) {
+        float3 const p = positions[indices[i]];
+
+        result.aabb.insert(p);
+
+        for (uint32_t a = 0; a < 3; ++a) {
+            if (p[a] < extremes[a * 2][a]) {
+                extremes[a * 2] = p;
+            }
+
+            if (p[a] > extremes[a * 2 + 1][a]) {
+                extremes[a * 2 + 1] = p;
+            }
+        }
+    }
+
+    uint32_t axis = 0;
+
+    for (uint32_t a = 1; a < 3; ++a) {
+        if (squared_distance(extremes[a * 2], extremes[a * 2 + 1]) >
+            squared_distance(extremes[axis * 2], extremes[axis * 2 + 1])) {
+            axis = a;
+        }
+    }
+
+    float3 center = 0.5f * (extremes[axis * 2] + extremes[axis * 2 + 1]);
+    float  radius = 0.5f * distance(extremes[axis * 2], extremes[axis * 2 + 1]);
+
+    // Ritter's sphere can be larger than the one around the box center, e.g. for a square
+    float3 const box_center = result.aabb.position();
+
+    float box_radius = 0.f;
+
+    for (uint32_t i = begin; i < end; ++i) {
+        float3 const p = positions[indices[i]];
+
+        float const d = distance(p, center);
+
+        if (d > radius) {
+            float const grown = 0.5f * (radius + d);
+
+            center += ((d - grown) / d) * (p - center);
+            radius = grown;
+        }
+
+        box_radius = std::max(distance(p, box_center), box_radius);
+    }
+
+    if (box_radius < radius) {
+        center = box_center;
+        radius = box_radius;
+    }
+
+    result.sphere_center = center;
+    result.sphere_radius = radius;
+
+    // The normal cone follows meshoptimizer's meshopt_computeClusterBounds()
+    uint32_t const triangles_end = begin + (end - begin) / 3 * 3;
+
+    float3 normal_sum(0.f);
+
+    for (uint32_t i = begin; i < triangles_end; i += 3) {
+        float3 const p0 = positions[indices[i + 0]];
+        float3 const n  = cross(positions[indices[i + 1]] - p0, positions[indices[i + 2]] - p0);
+
+        if (float const l = length(n); l > 0.f) {
+            normal_sum += n / l;
+        }
+    }
+
+    float const sum_length = length(normal_sum);
+
+    if (!(sum_length > 0.f)) {
+        return result;
+    }
+
+    float3 const cone_axis = normal_sum / sum_length;
+
+    float min_dot = 1.f;
+
+    for (uint32_t i = begin; i < triangles_end; i += 3) {
+        float3 const p0 = positions[indices[i + 0]];
+        float3 const n  = cross(positions[indices[i + 1]] - p0, positions[indices[i + 2]] - p0);
+
+        if (float const l = length(n); l > 0.f) {
+            min_dot = std::min(dot(n / l, cone_axis), min_dot);
+        }
+    }
+
+    // The cone is wider than about 170 degrees
+    if (min_dot <= 0.1f) {
+        return result;
+    }
+
+    // Move the apex behind all triangle planes, as seen along the axis
+    float max_t = 0.f;
+
+    for (uint32_t i = begin; i < triangles_end; i += 3) {
+        float3 const p0 = positions[indices[i + 0]];
+        float3 const n  = cross(positions[indices[i + 1]] - p0, positions[indices[i + 2]] - p0);
+
+        if (float const l = length(n); l > 0.f) {
+            float3 const nn = n / l;
+
+            max_t = std::max(dot(center - p0, nn) / dot(cone_axis, nn), max_t);
+        }
+    }
+
+    result.cone_apex   = center - max_t * cone_axis;
+    result.cone_axis   = cone_axis;
+    result.cone_cutoff = std::sqrt(1.f - min_dot * min_dot);
+
+    return result;
+}
+
+Uv_density uv_density(Model::Part const& part, uint32_t const* indices, float3 const* positions,
+                      float2 const* uvs, std::vector<float2>& ratios) noexcept {
+    // Pairs of ratio and world area
+    ratios.clear();
+
+    float total_area = 0.f;
+
+    for (uint32_t i = part.start_index, end = i + part.num_indices / 3 * 3; i < end; i += 3) {
+        uint32_t const a = indices[i + 0];
+        uint32_t const b = indices[i + 1];
+        uint32_t const c = indices[i + 2];
+
+        float const area = 0.5f * length(cross(positions[b] - positions[a],
+                                               positions[c] - positions[a]));
+
+        float2 const e1 = uvs[b] - uvs[a];
+        float2 const e2 = uvs[c] - uvs[a];
+
+        float const uv_area = 0.5f * std::abs(e1[0] * e2[1] - e1[1] * e2[0]);
+
+        if (area > 0.f && uv_area > 0.f) {
+            ratios.push_back(float2(uv_area / area, area));
+
+            total_area += area;
+        }
+    }
+
+    if (ratios.empty()) {
+        return {0.f, 0.f, 0.f};
+    }
+
+    std::sort(ratios.begin(), ratios.end(),
+              [](float2 const& a, float2 const& b) noexcept { return a[0] < b[0]; });
+
+    float median = ratios.back()[0];
+
+    float sum = 0.f;
+
+    for (auto const& r : ratios) {
+        sum += r[1];
+
+        if (sum >= 0.5f * total_area) {
+            median = r[0];
+            break;
+        }
+    }
+
+    return {ratios.front()[0], median, ratios.back()[0]};
+}
+
+}  // namespace model
@@ -0,0 +1,50 @@
+#ifndef SU_CORE_MODEL_MODEL_BOUNDS_HPP
+#define SU_CORE_MODEL_MODEL_BOUNDS_HPP
+
+#include "base/math/aabb.hpp"
+#include "base/math/vector3.hpp"
+
+namespace thread {
+class Pool;
+}
+
+namespace model {
+
+class Model;
+
+// Culling data of one part, in the space of its vertices
+struct Part_bounds {
+    AABB aabb;
+
+    float3 sphere_center;
+    float  sphere_radius;
+
+    // All triangles face away from eye e if dot(normalize(cone_apex - e), cone_axis) >= cone_cutoff.
+    // A cutoff of 1 means the normals are spread too wide for the test to be useful.
+    float3 cone_apex;
+    float3 cone_axis;
+    float  cone_cutoff;
+};
+
+// Ratio of texture coordinate area to world area over the triangles of one part, for picking mip
+// levels. The median is weighted by world area. Triangles without area in either space are left
+// out, and all three are 0 if there are none.
+struct Uv_density {
+    float min;
+    float median;
+    float max;
+};
+
+// Bounds of every part, from the triangles of the part
+void compute_part_bounds(Model const& model, Part_bounds* bounds, thread::Pool& threads) noexcept;
+
+// Needs texture coordinates
+void compute_uv_densities(Model const& model, Uv_density* densities,
+                          thread::Pool& threads) noexcept;
+
+// Bounds of all vertices, and of the copies that instances place elsewhere
+AABB instanced_aabb(Model const& model, Part_bounds const* bounds) noexcept;
+
+}  // namespace model
+
+#endif
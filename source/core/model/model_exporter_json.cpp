@@ -1,4 +1,6 @@
 #include "model_exporter_json.hpp"
+#include "base/encoding/base64.hpp"
+#include "base/io/async_writer.hpp"
 #include "base/math/print.hpp"
 #include "base/math/vector4.inl"
 #include "model.hpp"
@@ -7,18 +9,28 @@
 #include "rapidjson/ostreamwrapper.h"
 #include "rapidjson/prettywriter.h"
 
+#include <cstring>
 #include <fstream>
 #include <iomanip>
+#include <vector>
 
 namespace model {
 
+static bool write_buffer_views(std::ostream& stream, std::string const& name, Model const& model,
+                               Exporter_json::Arrays arrays) noexcept;
+
+Exporter_json::Exporter_json(Arrays arrays) noexcept : arrays_(arrays) {}
+
 bool Exporter_json::write(std::string const& name, Model const& model) const noexcept {
-    std::ofstream stream(name + ".json");
+    std::ofstream file(name + ".json");
 
-    if (!stream) {
+    if (!file) {
         return false;
     }
 
+    // Formatting the next numbers overlaps with writing the last ones
+    io::Async_ostream stream(file);
+
     /*
     rapidjson::OStreamWrapper json_stream(stream);
 
@@ -131,15 +143,63 @@ bool Exporter_json::write(std::string const& name, Model const& model) const noe
 
     stream << "\n\t\t],\n\n";
 
+    // Instances
+    if (uint32_t const num_instances = model.num_instances(); num_instances > 0) {
+        stream << "\t\t\"instances\": [\n";
+
+        Model::Instance const* instances = model.instances();
+        for (uint32_t i = 0; i < num_instances; ++i) {
+            math::Transformation const& t = instances[i].transformation;
+
+            stream << "\t\t\t{\n";
+
+            stream << "\t\t\t\t\"part\": ";
+            stream << instances[i].part;
+            stream << ",\n";
+
+            stream << "\t\t\t\t\"transformation\": {\n";
+
+            stream << "\t\t\t\t\t\"position\": [";
+            stream << t.position[0] << "," << t.position[1] << "," << t.position[2];
+            stream << "],\n";
+
+            stream << "\t\t\t\t\t\"rotation\": [";
+            stream << t.rotation[0] << "," << t.rotation[1] << "," << t.rotation[2] << ","
+                   << t.rotation[3];
+            stream << "]\n";
+
+            stream << "\t\t\t\t}\n\t\t\t}";
+
+            if (i < num_instances - 1) {
+                stream << ",\n";
+            }
+        }
+
+        stream << "\n\t\t],\n\n";
+    }
+
     // Primitive Topology
     stream << "\t\t\"primitive_topology\": \"triangle_list\",\n\n";
 
     stream << "\t\t\"vertices\": {\n";
 
+    // Lets the importer allocate the arrays up front
+    stream << "\t\t\t\"num_vertices\": " << model.num_vertices();
+
+    if (Arrays::Text != arrays_) {
+        bool const result = write_buffer_views(stream, name, model, arrays_);
+
+        stream << "\t}\n";
+
+        stream << "}";
+
+        return result && bool(stream.flush());
+    }
+
     // Positions
 
     if (float3 const* positions = model.positions(); positions) {
-        stream << "\t\t\t\"positions\": [\n";
+        stream << ",\n\n\t\t\t\"positions\": [\n";
 
         stream << "\t\t\t\t";
 
@@ -155,12 +215,12 @@ bool Exporter_json::write(std::string const& name, Model const& model) const noe
             }
         }
 
-        stream << "\n\t\t\t],\n\n";
+        stream << "\n\t\t\t]";
     }
 
     // Texture_2D Coordinates
     if (float2 const* texture_coordinates = model.texture_coordinates(); texture_coordinates) {
-        stream << "\t\t\t\"texture_coordinates_0\": [\n";
+        stream << ",\n\n\t\t\t\"texture_coordinates_0\": [\n";
 
         stream << "\t\t\t\t";
 
@@ -176,7 +236,7 @@ bool Exporter_json::write(std::string const& name, Model const& model) const noe
             }
         }
 
-        stream << "\n\t\t\t],\n\n";
+        stream << "\n\t\t\t]";
     }
 
     static bool constexpr tangent_space_as_quaternion = true;
@@ -186,7 +246,7 @@ bool Exporter_json::write(std::string const& name, Model const& model) const noe
 
     if (tangent_space_as_quaternion && normals && tangents) {
         // Tangent space
-        stream << "\t\t\t\"tangent_space\": [\n";
+        stream << ",\n\n\t\t\t\"tangent_space\": [\n";
 
         stream << "\t\t\t\t";
 
@@ -207,11 +267,11 @@ bool Exporter_json::write(std::string const& name, Model const& model) const noe
             }
         }
 
-        stream << "\n\t\t\t]\n\n";
+        stream << "\n\t\t\t]";
     } else {
         // Normals
         if (normals) {
-            stream << "\t\t\t\"normals\": [\n";
+            stream << ",\n\n\t\t\t\"normals\": [\n";
 
             stream << "\t\t\t\t";
 
@@ -228,17 +288,11 @@ bool Exporter_json::write(std::string const& name, Model const& model) const noe
             }
 
             stream << "\n\t\t\t]";
-
-            if (model.tangents()) {
-                stream << ",";
-            }
-
-            stream << "\n\n";
         }
 
         // Tangents
         if (tangents) {
-            stream << "\t\t\t\"tangents_and_bitangent_signs\": [\n";
+            stream << ",\n\n\t\t\t\"tangents_and_bitangent_signs\": [\n";
 
             stream << "\t\t\t\t";
 
@@ -255,11 +309,11 @@ bool Exporter_json::write(std::string const& name, Model const& model) const noe
                 }
             }
 
-            stream << "\n\t\t\t]\n\n";
+            stream << "\n\t\t\t]";
         }
     }
 
-    stream << "\t\t},\n\n";
+    stream << "\n\t\t},\n\n";
 
     // Indices
     stream << "\t\t\"indices\": [\n";
@@ -286,7 +340,117 @@ bool Exporter_json::write(std::string const& name, Model const& model) const noe
 
     stream << "}";
 
-    return true;
+    return bool(stream.flush());
+}
+
+// Writes {"encoding", "offset", "size"} and appends the data to the sidecar,
+// or {"encoding", "base64"} if there is no sidecar
+class Buffer_view_writer {
+  public:
+    Buffer_view_writer(std::ostream& stream, std::ofstream* sidecar) noexcept
+        : stream_(stream), sidecar_(sidecar), offset_(0) {}
+
+    template <typename T>
+    void write(char const* encoding_name, T const* elements, uint32_t count,
+               uint32_t num_components) noexcept {
+        uint32_t const element_size = num_components * 4;
+
+        bytes_.resize(uint64_t(count) * element_size);
+
+        // Model arrays can be padded, e.g. float3 is 16 bytes, the buffer is not
+        uint8_t* bytes = bytes_.data();
+        for (uint32_t i = 0; i < count; ++i, bytes += element_size) {
+            std::memcpy(bytes, &elements[i], element_size);
+        }
+
+        stream_ << "{\"encoding\": \"" << encoding_name << "\", ";
+
+        if (sidecar_) {
+            sidecar_->write(reinterpret_cast<char const*>(bytes_.data()),
+                            std::streamsize(bytes_.size()));
+
+            stream_ << "\"offset\": " << offset_ << ", \"size\": " << bytes_.size() << "}";
+
+            offset_ += bytes_.size();
+        } else {
+            text_.clear();
+            encoding::base64::encode(bytes_.data(), bytes_.size(), text_);
+
+            stream_ << "\"base64\": \"" << text_ << "\"}";
+        }
+    }
+
+    uint64_t size() const noexcept {
+        return offset_;
+    }
+
+  private:
+    std::ostream& stream_;
+
+    std::ofstream* sidecar_;
+
+    uint64_t offset_;
+
+    std::vector<uint8_t> bytes_;
+
+    std::string text_;
+};
+
+bool write_buffer_views(std::ostream& stream, std::string const& name, Model const& model,
+                        Exporter_json::Arrays arrays) noexcept {
+    std::ofstream sidecar;
+
+    if (Exporter_json::Arrays::Sidecar == arrays) {
+        sidecar.open(name + ".bin", std::ios::binary);
+
+        if (!sidecar) {
+            return false;
+        }
+    }
+
+    Buffer_view_writer writer(stream, sidecar.is_open() ? &sidecar : nullptr);
+
+    uint32_t const num_vertices = model.num_vertices();
+
+    if (float3 const* positions = model.positions(); positions) {
+        stream << ",\n\n\t\t\t\"positions\": ";
+        writer.write("Float32x3", positions, num_vertices, 3);
+    }
+
+    if (float2 const* texture_coordinates = model.texture_coordinates(); texture_coordinates) {
+        stream << ",\n\n\t\t\t\"texture_coordinates_0\": ";
+        writer.write("Float32x2", texture_coordinates, num_vertices, 2);
+    }
+
+    // No detour through quaternions, the values are stored exactly
+    if (float3 const* normals = model.normals(); normals) {
+        stream << ",\n\n\t\t\t\"normals\": ";
+        writer.write("Float32x3", normals, num_vertices, 3);
+    }
+
+    if (float4 const* tangents = model.tangents(); tangents) {
+        stream << ",\n\n\t\t\t\"tangents_and_bitangent_signs\": ";
+        writer.write("Float32x4", tangents, num_vertices, 4);
+    }
+
+    stream << "\n\t\t},\n\n";
+
+    stream << "\t\t\"indices\": ";
+    writer.write("UInt32", model.indices(), model.num_indices(), 1);
+
+    if (sidecar.is_open()) {
+        size_t const slash = name.find_last_of('/');
+
+        std::string const file = (std::string::npos == slash ? name : name.substr(slash + 1)) +
+                                 ".bin";
+
+        stream << ",\n\n\t\t\"buffer\": {\"file\": \"" << file
+               << "\", \"size\": " << writer.size() << "}";
+    }
+
+    stream << "\n";
+
+    return !sidecar.fail();
 }
 
 template <class Writer>
@@ -309,6 +473,12 @@ static void put_texture(Writer& writer, std::string const& name, bool invert = f
 }
 
 bool Exporter_json::write_materials(std::string const& name, std::string const& scene_name, Model const& model) const noexcept {
+    return write_materials(name, std::vector<std::string>{scene_name}, model);
+}
+
+bool Exporter_json::write_materials(std::string const& name,
+                                    std::vector<std::string> const& shape_names,
+                                    Model const& model) const noexcept {
     auto const* materials = model.materials();
 
     if (!materials) {
@@ -321,6 +491,13 @@ bool Exporter_json::write_materials(std::string const& name, std::string const&
         return false;
     }
 
+    return write_materials(stream, shape_names, model);
+}
+
+bool Exporter_json::write_materials(std::ostream&                   stream,
+                                    std::vector<std::string> const& shape_names,
+                                    Model const&                    model) const noexcept {
+    auto const* materials = model.materials();
 
     rapidjson::OStreamWrapper json_stream(stream);
 
@@ -404,26 +581,28 @@ bool Exporter_json::write_materials(std::string const& name, std::string const&
     writer.Key("entities");
     writer.StartArray();
 
-    writer.StartObject();
+    writer.SetFormatOptions(rapidjson::kFormatDefault);
 
-    writer.Key("type");
-    writer.String("Prop");
-    writer.Key("shape");
-    writer.StartObject();
-    writer.Key("file");
-    writer.String(scene_name.c_str());
-    writer.EndObject();
+    for (auto const& shape_name : shape_names) {
+        writer.StartObject();
 
-    writer.SetFormatOptions(rapidjson::kFormatDefault);
+        writer.Key("type");
+        writer.String("Prop");
+        writer.Key("shape");
+        writer.StartObject();
+        writer.Key("file");
+        writer.String(shape_name.c_str());
+        writer.EndObject();
 
-    writer.Key("materials");
-    writer.StartArray();
-    for (uint32_t i = 0, len = model.num_materials(); i < len; ++i) {
-        writer.String(materials[i].name.c_str());
-    }
-    writer.EndArray();
+        writer.Key("materials");
+        writer.StartArray();
+        for (uint32_t i = 0, len = model.num_materials(); i < len; ++i) {
+            writer.String(materials[i].name.c_str());
+        }
+        writer.EndArray();
 
-    writer.EndObject();
+        writer.EndObject();
+    }
 
     writer.EndArray();
 
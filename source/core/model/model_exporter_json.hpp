@@ -1,7 +1,9 @@
 #ifndef SU_CORE_MODEL_EXPORTER_JSON_HPP
 #define SU_CORE_MODEL_EXPORTER_JSON_HPP
 
+#include <iosfwd>
 #include <string>
+#include <vector>
 
 namespace model {
 
@@ -9,9 +11,25 @@ class Model;
 
 class Exporter_json {
   public:
+    // Where vertices and indices go: decimal text, a .bin file next to the .json, or base64
+    // strings inside the .json. The structure stays JSON in all cases.
+    enum class Arrays { Text, Sidecar, Base64 };
+
+    Exporter_json(Arrays arrays = Arrays::Text) noexcept;
+
     bool write(std::string const& name, Model const& model) const noexcept;
 
     bool write_materials(std::string const& name, std::string const& scene_name, Model const& model) const noexcept;
+
+    // One entity per shape file, all of them with the materials of model
+    bool write_materials(std::string const& name, std::vector<std::string> const& shape_names,
+                         Model const& model) const noexcept;
+
+    bool write_materials(std::ostream& stream, std::vector<std::string> const& shape_names,
+                         Model const& model) const noexcept;
+
+  private:
+    Arrays arrays_;
 };
 
 }  // namespace model
@@ -0,0 +1,185 @@
+#include "model_exporter_package.hpp"
+#include "base/hash/hash.hpp"
+
+#include <cstring>
+
+namespace model {
+
+using File_header = Exporter_package::File_header;
+using Blob        = Exporter_package::Blob;
+using Slot        = Exporter_package::Slot;
+
+static_assert(sizeof(File_header) == 32);
+static_assert(sizeof(Blob) == 16);
+static_assert(sizeof(Slot) == 24);
+
+static char constexpr Magic[] = "SUP\000";
+
+static uint64_t align(uint64_t offset, uint64_t alignment) noexcept {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+Exporter_package::Exporter_package() noexcept : alignment_(64), end_(0), bytes_saved_(0) {}
+
+bool Exporter_package::open(std::string const& name, uint32_t alignment) noexcept {
+    alignment_ = alignment;
+
+    // Read access to compare blobs of equal hash byte by byte
+    stream_.open(name, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+
+    if (!stream_) {
+        return false;
+    }
+
+    File_header const header{alignment, 0, 0, 0, 0, 0};
+
+    stream_.write(Magic, sizeof(char) * 4);
+    stream_.write(reinterpret_cast<char const*>(&header), sizeof(File_header));
+
+    end_ = uint64_t(stream_.tellp());
+
+    return bool(stream_);
+}
+
+Exporter_package::Add_result Exporter_package::add(std::string const& name,
+                                                    std::string const& mesh,
+                                                    std::string const& materials) noexcept {
+    if (!stream_) {
+        return Add_result::Write_error;
+    }
+
+    uint64_t const hash = hash::fnv_1a(name.data(), name.size(), hash::Fnv_offset_basis);
+
+    for (auto [i, end] = name_hashes_.equal_range(hash); i != end; ++i) {
+        if (name == models_[i->second].name) {
+            return Add_result::Duplicate_name;
+        }
+    }
+
+    name_hashes_.emplace(hash, uint32_t(models_.size()));
+
+    uint32_t const mesh_blob      = add_blob(mesh);
+    uint32_t const materials_blob = materials.empty() ? No_blob : add_blob(materials);
+
+    models_.push_back({name, mesh_blob, materials_blob});
+
+    return stream_ ? Add_result::Added : Add_result::Write_error;
+}
+
+bool Exporter_package::close() noexcept {
+    if (!stream_) {
+        return false;
+    }
+
+    uint32_t const num_models = uint32_t(models_.size());
+
+    // At most half full, which keeps the probe sequences short
+    uint32_t num_slots = 1;
+
+    while (num_slots < 2 * num_models) {
+        num_slots <<= 1;
+    }
+
+    std::vector<Slot> slots(num_slots, Slot{0, 0, 0, No_blob, No_blob});
+
+    std::string names;
+
+    for (auto const& m : models_) {
+        uint64_t const hash = hash::fnv_1a(m.name.data(), m.name.size(), hash::Fnv_offset_basis);
+
+        uint32_t s = uint32_t(hash & (num_slots - 1));
+
+        for (; No_blob != slots[s].mesh; s = (s + 1) & (num_slots - 1)) {
+        }
+
+        slots[s] = {hash, uint32_t(names.size()), uint32_t(m.name.size()), m.mesh, m.materials};
+
+        names += m.name;
+    }
+
+    uint64_t const directory_offset = align(end_, alignment_);
+
+    uint64_t const directory_size = blobs_.size() * sizeof(Blob) + num_slots * sizeof(Slot) +
+                                    names.size();
+
+    stream_.seekp(int64_t(end_));
+
+    for (uint64_t i = end_; i < directory_offset; ++i) {
+        stream_.put(0);
+    }
+
+    stream_.write(reinterpret_cast<char const*>(blobs_.data()), blobs_.size() * sizeof(Blob));
+    stream_.write(reinterpret_cast<char const*>(slots.data()), num_slots * sizeof(Slot));
+    stream_.write(names.data(), names.size());
+
+    File_header const header{alignment_,       num_models,
+                             num_slots,        uint32_t(blobs_.size()),
+                             directory_offset, directory_size};
+
+    stream_.seekp(sizeof(char) * 4);
+    stream_.write(reinterpret_cast<char const*>(&header), sizeof(File_header));
+
+    bool const result = bool(stream_);
+
+    stream_.close();
+
+    return result;
+}
+
+uint32_t Exporter_package::num_models() const noexcept {
+    return uint32_t(models_.size());
+}
+
+uint32_t Exporter_package::num_blobs() const noexcept {
+    return uint32_t(blobs_.size());
+}
+
+uint64_t Exporter_package::bytes_saved() const noexcept {
+    return bytes_saved_;
+}
+
+uint32_t Exporter_package::add_blob(std::string const& data) noexcept {
+    uint64_t const hash = hash::fnv_1a(data.data(), data.size(), hash::Fnv_offset_basis);
+
+    std::vector<char> buffer;
+
+    for (auto [i, end] = blob_hashes_.equal_range(hash); i != end; ++i) {
+        Blob const& b = blobs_[i->second];
+
+        if (b.size != data.size()) {
+            continue;
+        }
+
+        buffer.resize(b.size);
+
+        stream_.seekg(int64_t(b.offset));
+        stream_.read(buffer.data(), int64_t(b.size));
+
+        if (0 == std::memcmp(buffer.data(), data.data(), b.size)) {
+            bytes_saved_ += b.size;
+            return i->second;
+        }
+    }
+
+    uint64_t const offset = align(end_, alignment_);
+
+    stream_.seekp(int64_t(end_));
+
+    for (uint64_t i = end_; i < offset; ++i) {
+        stream_.put(0);
+    }
+
+    stream_.write(data.data(), int64_t(data.size()));
+
+    end_ = offset + data.size();
+
+    uint32_t const id = uint32_t(blobs_.size());
+
+    blobs_.push_back({offset, data.size()});
+
+    blob_hashes_.emplace(hash, id);
+
+    return id;
+}
+
+}  // namespace model
@@ -0,0 +1,94 @@
+#ifndef SU_CORE_MODEL_EXPORTER_PACKAGE_HPP
+#define SU_CORE_MODEL_EXPORTER_PACKAGE_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace model {
+
+// Many converted models in one file. A package starts with the magic "SUP\000" and a File_header,
+// followed by the blobs, each at a multiple of the alignment (64 by default) from the start of the
+// file. The directory comes last: one Blob per blob, the hash table of models and the model names.
+// Models are found by the FNV-1a hash of their name, with linear probing from hash & (slots - 1).
+// Blobs with identical content, e.g. the same mesh or the same materials, are stored once.
+class Exporter_package {
+  public:
+    static uint32_t constexpr No_blob = 0xFFFFFFFF;
+
+    struct File_header {
+        uint32_t alignment;
+        uint32_t num_models;
+        uint32_t num_slots;
+        uint32_t num_blobs;
+        uint64_t directory_offset;
+        uint64_t directory_size;
+    };
+
+    struct Blob {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    // Empty slots have mesh == No_blob. name_offset is relative to the first name.
+    struct Slot {
+        uint64_t name_hash;
+        uint32_t name_offset;
+        uint32_t name_size;
+        uint32_t mesh;
+        uint32_t materials;
+    };
+
+    Exporter_package() noexcept;
+
+    // alignment is a power of two, at least the one of the blocks in the .sub files to keep them
+    // aligned in the package
+    bool open(std::string const& name, uint32_t alignment = 64) noexcept;
+
+    enum class Add_result { Added, Duplicate_name, Write_error };
+
+    // mesh is a .sub file and materials a .scene file without entities, which may be empty.
+    // Models with a name that has been added before are not added.
+    Add_result add(std::string const& name, std::string const& mesh,
+                   std::string const& materials) noexcept;
+
+    // Writes the directory and the header
+    bool close() noexcept;
+
+    uint32_t num_models() const noexcept;
+    uint32_t num_blobs() const noexcept;
+
+    uint64_t bytes_saved() const noexcept;
+
+  private:
+    uint32_t add_blob(std::string const& data) noexcept;
+
+    struct Model_entry {
+        std::string name;
+
+        uint32_t mesh;
+        uint32_t materials;
+    };
+
+    std::fstream stream_;
+
+    std::vector<Model_entry> models_;
+
+    std::vector<Blob> blobs_;
+
+    std::unordered_multimap<uint64_t, uint32_t> blob_hashes_;
+
+    std::unordered_multimap<uint64_t, uint32_t> name_hashes_;
+
+    uint32_t alignment_;
+
+    uint64_t end_;
+
+    uint64_t bytes_saved_;
+};
+
+}  // namespace model
+
+#endif
@@ -1,43 +1,176 @@
 #include "model_exporter_sub.hpp"
+#include "base/encoding/encoding.hpp"
+#include "base/hash/hash.hpp"
+#include "base/io/async_writer.hpp"
+#include "base/math/aabb.inl"
+#include "base/math/batch.hpp"
 #include "base/math/vector4.inl"
 #include "base/memory/align.hpp"
+#include "base/thread/thread_pool.hpp"
+#include "core/bvh/bvh_builder.hpp"
+#include "core/bvh/bvh_tree.hpp"
 #include "model.hpp"
+#include "model_bounds.hpp"
+#include "model_lights.hpp"
 #include "rapidjson/prettywriter.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <fstream>
+#include <unordered_map>
+#include <vector>
 
 namespace model {
 
-struct Vertex {
-    packed_float3 p;
-    packed_float3 n;
-    packed_float3 t;
+// Triangle prepared for ray intersection, without going through the indices. part and
+// material_index are No_part for triangles outside of every part.
+struct Triangle_record {
+    packed_float3 v0;
+    uint32_t      part;
+    packed_float3 e1;
+    uint32_t      material_index;
+    packed_float3 e2;
+    uint32_t      pad;
+};
 
-    float2 uv;
+static_assert(sizeof(Triangle_record) == 48);
 
-    uint8_t bitangent_sign;
+static uint32_t constexpr No_part = 0xFFFFFFFF;
 
-    uint8_t pad[3];
-};
+using Block_content  = Exporter_sub::Block_content;
+using Block_encoding = Exporter_sub::Block_encoding;
+using File_header    = Exporter_sub::File_header;
+using Toc_entry      = Exporter_sub::Toc_entry;
+
+static_assert(sizeof(File_header) == 32);
+static_assert(sizeof(Toc_entry) == 32);
+static_assert(sizeof(Lights::Triangle) == 32);
+
+static uint64_t align(uint64_t offset, uint64_t alignment) noexcept {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+// Zero bytes up to offset from the start of the file
+static void pad_to(std::ostream& stream, uint64_t offset) noexcept {
+    for (uint64_t i = uint64_t(stream.tellp()); i < offset; ++i) {
+        stream.put(0);
+    }
+}
 
 struct Vertex_layout_description {
-    enum class Encoding { UInt8, UInt16, UInt32, Float32, Float32x2, Float32x3, Float32x4 };
+    enum class Semantic { Position, Normal, Tangent_space, Texture_coordinate };
+
+    enum class Encoding {
+        UInt8,
+        UInt16,
+        UInt32,
+        Float32,
+        Float32x2,
+        Float32x3,
+        Float32x4,
+        Snorm16x4,
+        Octahedral32
+    };
 
     struct Element {
-        std::string semantic_name;
-        uint32_t    semantic_index = 0;
-        Encoding    encoding;
-        uint32_t    stream      = 0;
-        uint32_t    byte_offset = 0;
+        Semantic semantic;
+        uint32_t semantic_index = 0;
+        Encoding encoding;
+        uint32_t stream      = 0;
+        uint32_t byte_offset = 0;
     };
+
+    static uint32_t size(Encoding encoding) noexcept;
+
+    // Places the element behind the ones already in the stream
+    void add(Semantic semantic, Encoding encoding, uint32_t stream) noexcept;
+
+    // Sum of all strides
+    uint32_t vertex_size() const noexcept;
+
+    std::vector<Element> elements;
+
+    // Per stream, multiple of 4 bytes
+    std::vector<uint32_t> strides;
 };
 
+uint32_t Vertex_layout_description::size(Encoding encoding) noexcept {
+    switch (encoding) {
+        case Encoding::UInt8:
+            return 1;
+        case Encoding::UInt16:
+            return 2;
+        case Encoding::UInt32:
+        case Encoding::Float32:
+        case Encoding::Octahedral32:
+            return 4;
+        case Encoding::Float32x2:
+        case Encoding::Snorm16x4:
+            return 8;
+        case Encoding::Float32x3:
+            return 12;
+        case Encoding::Float32x4:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+void Vertex_layout_description::add(Semantic semantic, Encoding encoding, uint32_t stream) noexcept {
+    if (strides.size() <= stream) {
+        strides.resize(stream + 1, 0);
+    }
+
+    uint32_t const element_size = size(encoding);
+    uint32_t const alignment    = std::min(element_size, 4u);
+
+    uint32_t& stride = strides[stream];
+
+    uint32_t const byte_offset = (stride + alignment - 1) / alignment * alignment;
+
+    elements.push_back({semantic, 0, encoding, stream, byte_offset});
+
+    stride = (byte_offset + element_size + 3) / 4 * 4;
+}
+
+uint32_t Vertex_layout_description::vertex_size() const noexcept {
+    uint32_t result = 0;
+
+    for (uint32_t const s : strides) {
+        result += s;
+    }
+
+    return result;
+}
+
+static std::string to_string(Vertex_layout_description::Semantic semantic) {
+    using Semantic = Vertex_layout_description::Semantic;
+
+    switch (semantic) {
+        case Semantic::Position:
+            return "Position";
+        case Semantic::Normal:
+            return "Normal";
+        case Semantic::Tangent_space:
+            return "Tangent_space";
+        case Semantic::Texture_coordinate:
+            return "Texture_coordinate";
+        default:
+            return "Undefined";
+    }
+}
+
 static std::string to_string(Vertex_layout_description::Encoding const& encoding) {
     using Encoding = Vertex_layout_description::Encoding;
 
     switch (encoding) {
         case Encoding::UInt8:
             return "UInt8";
+        case Encoding::UInt16:
+            return "UInt16";
+        case Encoding::UInt32:
+            return "UInt32";
         case Encoding::Float32:
             return "Float32";
         case Encoding::Float32x2:
@@ -46,17 +179,111 @@ static std::string to_string(Vertex_layout_description::Encoding const& encoding
             return "Float32x3";
         case Encoding::Float32x4:
             return "Float32x4";
+        case Encoding::Snorm16x4:
+            return "Snorm16x4";
+        case Encoding::Octahedral32:
+            return "Octahedral32";
         default:
             return "Undefined";
     }
 }
 
+static Vertex_layout_description::Encoding encoding(Exporter_sub::Tangent_space tangent_space) {
+    using Encoding      = Vertex_layout_description::Encoding;
+    using Tangent_space = Exporter_sub::Tangent_space;
+
+    switch (tangent_space) {
+        case Tangent_space::QTangent:
+            return Encoding::Snorm16x4;
+        case Tangent_space::Octahedral:
+            return Encoding::Octahedral32;
+        default:
+            return Encoding::Float32x4;
+    }
+}
+
+static Vertex_layout_description vertex_layout(Model const&                  model,
+                                               Exporter_sub::Settings const& settings) {
+    using Semantic = Vertex_layout_description::Semantic;
+    using Encoding = Vertex_layout_description::Encoding;
+    using Layout   = Exporter_sub::Layout;
+
+    Vertex_layout_description layout;
+
+    uint32_t num_streams = 0;
+
+    auto const next_stream = [&settings, &num_streams]() {
+        switch (settings.layout) {
+            case Layout::Interleaved:
+                return 0u;
+            case Layout::Split_position:
+                return std::min(num_streams++, 1u);
+            default:
+                return num_streams++;
+        }
+    };
+
+    layout.add(Semantic::Position, Encoding::Float32x3, next_stream());
+
+    bool const has_uvs_and_tangents = nullptr != model.texture_coordinates() &&
+                                      nullptr != model.tangents();
+
+    if (has_uvs_and_tangents) {
+        layout.add(Semantic::Tangent_space, encoding(settings.tangent_space), next_stream());
+        layout.add(Semantic::Texture_coordinate, Encoding::Float32x2, next_stream());
+    } else {
+        layout.add(Semantic::Normal, Encoding::Float32x3, next_stream());
+    }
+
+    return layout;
+}
+
+// Encoding of a stream for the table of contents
+static Block_encoding block_encoding(Vertex_layout_description const& layout, uint32_t stream) {
+    using Encoding = Vertex_layout_description::Encoding;
+
+    Vertex_layout_description::Element const* single = nullptr;
+
+    for (auto const& element : layout.elements) {
+        if (element.stream == stream) {
+            if (single) {
+                return Block_encoding::Structured;
+            }
+
+            single = &element;
+        }
+    }
+
+    if (!single || Vertex_layout_description::size(single->encoding) != layout.strides[stream]) {
+        return Block_encoding::Structured;
+    }
+
+    switch (single->encoding) {
+        case Encoding::UInt16:
+            return Block_encoding::UInt16;
+        case Encoding::UInt32:
+            return Block_encoding::UInt32;
+        case Encoding::Float32x2:
+            return Block_encoding::Float32x2;
+        case Encoding::Float32x3:
+            return Block_encoding::Float32x3;
+        case Encoding::Float32x4:
+            return Block_encoding::Float32x4;
+        case Encoding::Snorm16x4:
+            return Block_encoding::Snorm16x4;
+        case Encoding::Octahedral32:
+            return Block_encoding::Octahedral32;
+        default:
+            return Block_encoding::Structured;
+    }
+}
+
 template <class Writer>
 static void write(Writer& writer, Vertex_layout_description::Element const& element) {
     writer.StartObject();
 
     writer.Key("semantic_name");
-    writer.String(element.semantic_name.c_str());
+    writer.String(to_string(element.semantic).c_str());
 
     writer.Key("semantic_index");
     writer.Uint(element.semantic_index);
@@ -73,6 +300,43 @@ static void write(Writer& writer, Vertex_layout_description::Element const& elem
     writer.EndObject();
 }
 
+static void write_vertices(Model const& model, Vertex_layout_description const& layout,
+                           Exporter_sub::Tangent_space tangent_space, Toc_entry const* blocks,
+                           std::ostream& stream, thread::Pool& threads) noexcept;
+
+// Vertex range of a part, which its indices are relative to
+struct Chunk {
+    uint32_t base_vertex;
+    uint32_t num_vertices;
+    uint32_t index_bytes;
+};
+
+// Per part its slice of every vertex stream followed by its indices
+static void write_chunks(Model const& model, Vertex_layout_description const& layout,
+                         Exporter_sub::Tangent_space tangent_space, Chunk const* chunks,
+                         Toc_entry const* blocks, std::ostream& stream,
+                         thread::Pool& threads) noexcept;
+
+static void write_tangent_space(Model const& model, Exporter_sub::Tangent_space tangent_space,
+                                uint8_t* buffer, thread::Pool& threads) noexcept;
+
+static void write_triangles(Model const& model, uint32_t const* order,
+                            Triangle_record* triangles, thread::Pool& threads) noexcept;
+
+static bool weld_positions(Model const& model, bool per_part, std::vector<packed_float3>& positions,
+                           uint32_t* indices, std::vector<uint32_t>& base_vertices,
+                           thread::Pool& threads) noexcept;
+
+template <class Writer>
+static void write(Writer& writer, char const* key, float3 const& v) {
+    writer.Key(key);
+    writer.StartArray();
+    writer.Double(v[0]);
+    writer.Double(v[1]);
+    writer.Double(v[2]);
+    writer.EndArray();
+}
+
 template <class Writer>
 static void binary_tag(Writer& writer, uint64_t offset, uint64_t size) noexcept {
     writer.Key("binary");
@@ -90,129 +354,41 @@ static void binary_tag(Writer& writer, uint64_t offset, uint64_t size) noexcept
     writer.EndObject();
 }
 
-bool Exporter_sub::write(std::string const& name, Model const& model) const noexcept {
-    std::ofstream stream(name + ".sub", std::ios::binary);
-
-    if (!stream) {
-        return false;
-    }
-
-    rapidjson::StringBuffer sb;
-
-    rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
-
-    writer.StartObject();
-
-    writer.Key("geometry");
-    writer.StartObject();
-
-    // Parts
-    writer.Key("parts");
-    writer.StartArray();
-
-    Model::Part const* parts = model.parts();
-    for (uint32_t i = 0, len = model.num_parts(); i < len; ++i) {
-        writer.StartObject();
-
-        writer.Key("start_index");
-        writer.Uint(parts[i].start_index);
-
-        writer.Key("num_indices");
-        writer.Uint(parts[i].num_indices);
+Exporter_sub::Exporter_sub(Settings const& settings) noexcept : settings_(settings) {}
 
-        writer.Key("material_index");
-        writer.Uint(parts[i].material_index);
+bool Exporter_sub::write(std::string const& name, Model const& model, thread::Pool& threads) const
+    noexcept {
+    std::ofstream file(name + ".sub", std::ios::binary);
 
-        writer.EndObject();
+    if (!file) {
+        return false;
     }
 
-    writer.EndArray();
-
-    // Vertices
-    writer.Key("vertices");
-    writer.StartObject();
+    // Encoding the next block overlaps with writing the last one
+    io::Async_ostream stream(file);
 
-    static bool constexpr tangent_space_as_quaternion = true;
-    static bool constexpr interleaved_vertex_stream   = false;
+    return write(stream, model, threads) && stream.flush();
+}
 
-    bool const has_uvs_and_tangents = nullptr != model.texture_coordinates() &&
-                                      nullptr != model.tangents();
+bool Exporter_sub::write(std::ostream& stream, Model const& model, thread::Pool& threads) const
+    noexcept {
+    bvh::Builder builder({});
 
-    uint64_t vertex_size = 0;
+    bvh::Tree tree;
 
-    if (interleaved_vertex_stream) {
-        vertex_size = sizeof(Vertex);
-    } else {
-        if (tangent_space_as_quaternion && has_uvs_and_tangents) {
-            vertex_size = (3 * 4 + 4 * 4 + 4 * 2);
-        } else {
-            vertex_size = has_uvs_and_tangents ? (3 * 4 + 3 * 4 + 3 * 4 + 2 * 4 + 1)
-                                               : (3 * 4 + 3 * 4);
-        }
+    if (settings_.bvh) {
+        builder.build(tree, model, threads);
     }
 
-    uint64_t const num_vertices  = model.num_vertices();
-    uint64_t const vertices_size = num_vertices * vertex_size;
-
-    binary_tag(writer, 0, vertices_size);
-
-    writer.Key("num_vertices");
-    writer.Uint64(num_vertices);
-
-    writer.Key("layout");
-    writer.StartArray();
-
-    Vertex_layout_description::Element element;
-
-    using Encoding = Vertex_layout_description::Encoding;
-
-    element.semantic_name = "Position";
-    element.encoding      = Encoding::Float32x3;
-    element.stream        = 0;
-    model::write(writer, element);
+    uint32_t const num_triangles = model.num_indices() / 3;
 
-    if (tangent_space_as_quaternion && has_uvs_and_tangents) {
-        element.semantic_name = "Tangent_space";
-        element.encoding      = Encoding::Float32x4;
-        element.stream        = 1;
-        model::write(writer, element);
-
-        element.semantic_name = "Texture_coordinate";
-        element.encoding      = Encoding::Float32x2;
-        element.stream        = 2;
-        model::write(writer, element);
-
-    } else {
-        element.semantic_name = "Normal";
-        element.stream        = 1;
-        model::write(writer, element);
-
-        if (has_uvs_and_tangents) {
-            element.semantic_name = "Tangent";
-            element.stream        = 2;
-            model::write(writer, element);
-
-            element.semantic_name = "Texture_coordinate";
-            element.encoding      = Encoding::Float32x2;
-            element.stream        = 3;
-            model::write(writer, element);
+    memory::Buffer<Triangle_record> triangles(settings_.triangles ? num_triangles : 0);
 
-            element.semantic_name = "Bitangent_sign";
-            element.encoding      = Encoding::UInt8;
-            element.stream        = 4;
-            model::write(writer, element);
-        }
+    if (settings_.triangles) {
+        write_triangles(model, settings_.bvh ? tree.triangles.data() : nullptr, triangles.data(),
+                        threads);
     }
 
-    writer.EndArray();
-
-    // close vertices
-    writer.EndObject();
-
-    // Indices
-    writer.Key("indices");
-    writer.StartObject();
-
     int64_t max_index       = 0;
     int64_t max_index_delta = 0;
     int64_t min_index_delta = 0;
@@ -250,213 +426,1087 @@ bool Exporter_sub::write(std::string const& name, Model const& model) const noex
         delta_indices = true;
     }
 
-    uint64_t const num_indices = model.num_indices();
+    // Indices can be stored relative to the first vertex of their part, if every part only
+    // references a small enough range of vertices
+    Model::Part const* parts = model.parts();
 
-    binary_tag(writer, vertices_size, num_indices * index_bytes);
+    uint32_t const num_parts = model.num_parts();
 
-    writer.Key("num_indices");
-    writer.Uint64(num_indices);
+    std::vector<Chunk> chunks(num_parts);
 
-    writer.Key("encoding");
+    bool part_relative = num_parts > 0;
 
-    if (4 == index_bytes) {
-        if (delta_indices) {
-            writer.String("Int32");
-        } else {
-            writer.String("UInt32");
+    bool parts_cover_indices = true;
+
+    {
+        uint64_t num_part_indices = 0;
+
+        uint32_t const* indices = model.indices();
+        for (uint32_t i = 0; i < num_parts; ++i) {
+            Model::Part const& p = parts[i];
+
+            uint32_t min_vertex = 0xFFFFFFFF;
+            uint32_t max_vertex = 0;
+
+            for (uint32_t j = p.start_index, len = p.start_index + p.num_indices; j < len; ++j) {
+                min_vertex = std::min(indices[j], min_vertex);
+                max_vertex = std::max(indices[j], max_vertex);
+            }
+
+            Chunk& c = chunks[i];
+
+            c.base_vertex  = p.num_indices > 0 ? min_vertex : 0;
+            c.num_vertices = p.num_indices > 0 ? max_vertex - min_vertex + 1 : 0;
+            c.index_bytes  = c.num_vertices <= 0x10000 ? 2 : 4;
+
+            if (4 == c.index_bytes) {
+                part_relative = false;
+            }
+
+            num_part_indices += p.num_indices;
         }
-    } else {
-        if (delta_indices) {
-            writer.String("Int16");
-        } else {
-            writer.String("UInt16");
+
+        // Relies on parts not overlapping, which no step that produces them allows
+        if (num_part_indices != model.num_indices()) {
+            part_relative       = false;
+            parts_cover_indices = false;
         }
     }
 
-    // close indices
-    writer.EndObject();
+    // Only worth it if the indices would not fit into 16 bits otherwise
+    if (part_relative && 4 == index_bytes) {
+        index_bytes   = 2;
+        delta_indices = false;
+    } else {
+        part_relative = false;
+    }
 
-    // close geometry
-    writer.EndObject();
+    uint64_t const alignment = std::max(settings_.alignment, 4u);
 
-    // close start
-    writer.EndObject();
+    // Offsets relative to the binary section for now
+    std::vector<Toc_entry> blocks;
 
-    uint64_t const json_size         = sb.GetSize();
-    uint64_t const aligned_json_size = json_size + json_size % 4;
+    uint64_t binary_size = 0;
 
-    const char header[] = "SUB\000";
-    stream.write(header, sizeof(char) * 4);
+    auto const add_block = [&blocks, &binary_size, alignment](
+                               uint64_t size, Block_content content, Block_encoding encoding,
+                               uint32_t index, uint32_t part = Exporter_sub::All_parts) {
+        uint64_t const offset = align(binary_size, alignment);
 
-    stream.write(reinterpret_cast<char const*>(&aligned_json_size), sizeof(uint64_t));
-    stream.write(reinterpret_cast<char const*>(sb.GetString()), json_size * sizeof(char));
+        blocks.push_back({offset, size, content, encoding, index, part});
 
-    for (int64_t i = aligned_json_size - json_size; i > 0; --i) {
-        stream.put(0);
+        binary_size = offset + size;
+
+        return offset;
+    };
+
+    Vertex_layout_description const layout = vertex_layout(model, settings_);
+
+    uint32_t const num_streams = uint32_t(layout.strides.size());
+
+    uint64_t const num_vertices = model.num_vertices();
+    uint64_t const num_indices  = model.num_indices();
+
+    std::vector<Part_bounds> bounds(num_parts);
+
+    compute_part_bounds(model, bounds.data(), threads);
+
+    std::vector<Uv_density> densities(model.texture_coordinates() ? num_parts : 0);
+
+    if (!densities.empty()) {
+        compute_uv_densities(model, densities.data(), threads);
     }
 
-    // binary stuff
+    rapidjson::StringBuffer sb;
 
-    if (interleaved_vertex_stream) {
-        memory::Buffer<Vertex> vertices(num_vertices);
+    rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
 
-        for (uint32_t i = 0, len = model.num_vertices(); i < len; ++i) {
-            Vertex& v = vertices[i];
+    writer.StartObject();
 
-            v.p = packed_float3(model.positions()[i]);
+    writer.Key("geometry");
+    writer.StartObject();
 
-            if (model.normals()) {
-                v.n = packed_float3(model.normals()[i]);
-            } else {
-                v.n = packed_float3(0.f);
-            }
+    if (num_parts > 0 || model.num_vertices() > 0) {
+        AABB const box = instanced_aabb(model, bounds.data());
 
-            if (model.tangents()) {
-                v.t              = packed_float3(model.tangents()[i].xyz());
-                v.bitangent_sign = model.tangents()[i][3] < 0.f ? 1 : 0;
-            } else {
-                v.t              = packed_float3(0.f);
-                v.bitangent_sign = 0;
-            }
+        writer.Key("aabb");
+        writer.StartObject();
+        model::write(writer, "min", box.min());
+        model::write(writer, "max", box.max());
+        writer.EndObject();
+    }
 
-            if (model.texture_coordinates()) {
-                v.uv = model.texture_coordinates()[i];
-            } else {
-                v.uv = float2(0.f);
-            }
+    // Parts
+    writer.Key("parts");
+    writer.StartArray();
 
-            v.pad[0] = 0;
-            v.pad[1] = 0;
-            v.pad[2] = 0;
-        }
+    for (uint32_t i = 0; i < num_parts; ++i) {
+        writer.StartObject();
 
-        stream.write(reinterpret_cast<char const*>(vertices.data()), vertices_size);
-    } else {
-        memory::Buffer<uint8_t> buffer(num_vertices * 4 * sizeof(float));
+        writer.Key("start_index");
+        writer.Uint(parts[i].start_index);
 
-        packed_float3* floats3 = reinterpret_cast<packed_float3*>(buffer.data());
+        writer.Key("num_indices");
+        writer.Uint(parts[i].num_indices);
 
-        float3 const* positions = model.positions();
-        for (uint32_t i = 0; i < num_vertices; ++i) {
-            floats3[i] = packed_float3(positions[i]);
+        writer.Key("material_index");
+        writer.Uint(parts[i].material_index);
+
+        if (part_relative && !settings_.part_chunks) {
+            writer.Key("base_vertex");
+            writer.Uint(chunks[i].base_vertex);
         }
 
-        stream.write(reinterpret_cast<char const*>(floats3), num_vertices * sizeof(packed_float3));
+        if (settings_.part_chunks) {
+            Chunk const& c = chunks[i];
 
-        if (tangent_space_as_quaternion && has_uvs_and_tangents) {
-            float4* floats4 = reinterpret_cast<float4*>(buffer.data());
+            writer.Key("chunk");
+            writer.StartObject();
 
-            float4 const* tangents = model.tangents();
-            float3 const* normals  = model.normals();
+            writer.Key("base_vertex");
+            writer.Uint(c.base_vertex);
 
-            for (uint32_t i = 0; i < num_vertices; ++i) {
-                float4 const t = tangents[i];
-                float3 const n = normals[i];
+            writer.Key("vertices");
+            writer.StartObject();
 
-                Quaternion const ts = Model::tangent_space(t.xyz(), n, t[3]);
+            writer.Key("num_vertices");
+            writer.Uint(c.num_vertices);
 
-                floats4[i] = ts;
+            writer.Key("stream_offsets");
+            writer.StartArray();
+
+            for (uint32_t s = 0; s < num_streams; ++s) {
+                writer.Uint64(add_block(uint64_t(c.num_vertices) * layout.strides[s],
+                                        Block_content::Vertex_stream, block_encoding(layout, s), s,
+                                        i));
             }
 
-            stream.write(reinterpret_cast<char const*>(floats4), num_vertices * sizeof(float4));
+            writer.EndArray();
 
-            float2 const* uvs = model.texture_coordinates();
+            uint64_t const first_stream = blocks[blocks.size() - num_streams].offset;
 
-            stream.write(reinterpret_cast<char const*>(uvs), num_vertices * sizeof(float2));
-        } else {
-            float3 const* normals = model.normals();
-            for (uint32_t i = 0; i < num_vertices; ++i) {
-                if (normals) {
-                    floats3[i] = packed_float3(normals[i]);
-                } else {
-                    floats3[i] = packed_float3(0.f);
-                }
-            }
+            // Including the padding between the streams
+            binary_tag(writer, first_stream, binary_size - first_stream);
 
-            stream.write(reinterpret_cast<char const*>(floats3),
-                         num_vertices * sizeof(packed_float3));
+            writer.EndObject();
 
-            if (has_uvs_and_tangents) {
-                float4 const* tangents = model.tangents();
-                for (uint32_t i = 0; i < num_vertices; ++i) {
-                    if (tangents) {
-                        floats3[i] = packed_float3(tangents[i].xyz());
-                    } else {
-                        floats3[i] = packed_float3(0.f);
-                    }
-                }
+            writer.Key("indices");
+            writer.StartObject();
 
-                stream.write(reinterpret_cast<char const*>(floats3),
-                             num_vertices * sizeof(packed_float3));
+            uint64_t const indices_size = uint64_t(parts[i].num_indices) * c.index_bytes;
 
-                float2* floats2 = reinterpret_cast<float2*>(buffer.data());
+            Block_encoding const encoding = 2 == c.index_bytes ? Block_encoding::UInt16
+                                                               : Block_encoding::UInt32;
 
-                float2 const* uvs = model.texture_coordinates();
-                for (uint32_t i = 0; i < num_vertices; ++i) {
-                    if (uvs) {
-                        floats2[i] = uvs[i];
-                    } else {
-                        floats2[i] = float2(0.f);
-                    }
-                }
+            binary_tag(writer, add_block(indices_size, Block_content::Indices, encoding, 0, i),
+                       indices_size);
 
-                stream.write(reinterpret_cast<char const*>(floats2), num_vertices * sizeof(float2));
+            writer.Key("encoding");
+            writer.String(2 == c.index_bytes ? "UInt16" : "UInt32");
 
-                uint8_t* bytes = reinterpret_cast<uint8_t*>(buffer.data());
+            writer.EndObject();
 
-                for (uint32_t i = 0; i < num_vertices; ++i) {
-                    if (tangents) {
-                        bytes[i] = tangents[i][3] < 0.f ? 1 : 0;
-                    } else {
-                        bytes[i] = 0;
-                    }
-                }
+            // Everything the part needs in one piece of the file
+            binary_tag(writer, first_stream, binary_size - first_stream);
+
+            writer.EndObject();
+        }
 
-                stream.write(reinterpret_cast<char const*>(bytes), num_vertices * sizeof(uint8_t));
+        if (parts[i].num_indices > 0) {
+            Part_bounds const& b = bounds[i];
+
+            writer.Key("aabb");
+            writer.StartObject();
+            model::write(writer, "min", b.aabb.min());
+            model::write(writer, "max", b.aabb.max());
+            writer.EndObject();
+
+            writer.Key("sphere");
+            writer.StartObject();
+            model::write(writer, "center", b.sphere_center);
+            writer.Key("radius");
+            writer.Double(b.sphere_radius);
+            writer.EndObject();
+
+            // Back-facing if dot(normalize(apex - eye), axis) >= cutoff
+            if (b.cone_cutoff < 1.f) {
+                writer.Key("cone");
+                writer.StartObject();
+                model::write(writer, "apex", b.cone_apex);
+                model::write(writer, "axis", b.cone_axis);
+                writer.Key("cutoff");
+                writer.Double(b.cone_cutoff);
+                writer.EndObject();
             }
         }
+
+        // Texture coordinate area per world area
+        if (!densities.empty() && densities[i].max > 0.f) {
+            Uv_density const& d = densities[i];
+
+            writer.Key("uv_density");
+            writer.StartObject();
+            writer.Key("min");
+            writer.Double(d.min);
+            writer.Key("median");
+            writer.Double(d.median);
+            writer.Key("max");
+            writer.Double(d.max);
+            writer.EndObject();
+        }
+
+        writer.EndObject();
     }
 
-    uint32_t const* indices = model.indices();
+    writer.EndArray();
 
-    if (4 == index_bytes) {
-        int32_t previous_index = 0;
+    // Instances
+    if (uint32_t const num_instances = model.num_instances(); num_instances > 0) {
+        writer.Key("instances");
+        writer.StartArray();
 
-        if (delta_indices) {
-            for (uint32_t i = 0; i < num_indices; ++i) {
-                int32_t const a = int32_t(indices[i]);
+        Model::Instance const* instances = model.instances();
+        for (uint32_t i = 0; i < num_instances; ++i) {
+            math::Transformation const& t = instances[i].transformation;
 
-                int32_t const delta_index = a - previous_index;
-                stream.write(reinterpret_cast<char const*>(&delta_index), sizeof(int32_t));
+            writer.StartObject();
 
-                previous_index = a;
-            }
-        } else {
-            stream.write(reinterpret_cast<char const*>(model.indices()),
-                         num_indices * sizeof(uint32_t));
-        }
-    } else {
-        if (delta_indices) {
-            int32_t previous_index = 0;
+            writer.Key("part");
+            writer.Uint(instances[i].part);
 
-            for (uint32_t i = 0; i < num_indices; ++i) {
-                int32_t const a = int32_t(indices[i]);
+            writer.Key("transformation");
+            writer.StartObject();
+
+            writer.Key("position");
+            writer.StartArray();
+            writer.Double(t.position[0]);
+            writer.Double(t.position[1]);
+            writer.Double(t.position[2]);
+            writer.EndArray();
+
+            writer.Key("rotation");
+            writer.StartArray();
+            writer.Double(t.rotation[0]);
+            writer.Double(t.rotation[1]);
+            writer.Double(t.rotation[2]);
+            writer.Double(t.rotation[3]);
+            writer.EndArray();
+
+            writer.EndObject();
+
+            writer.EndObject();
+        }
+
+        writer.EndArray();
+    }
+
+    // Vertices
+    writer.Key("vertices");
+    writer.StartObject();
+
+    if (!settings_.part_chunks) {
+        for (uint32_t s = 0; s < num_streams; ++s) {
+            add_block(num_vertices * layout.strides[s], Block_content::Vertex_stream,
+                      block_encoding(layout, s), s);
+        }
+
+        // Including the padding between the streams
+        binary_tag(writer, blocks.front().offset, binary_size - blocks.front().offset);
+    }
+
+    writer.Key("num_vertices");
+    writer.Uint64(num_vertices);
+
+    writer.Key("layout");
+    writer.StartArray();
+
+    for (auto const& element : layout.elements) {
+        model::write(writer, element);
+    }
+
+    writer.EndArray();
+
+    writer.Key("strides");
+    writer.StartArray();
+
+    for (uint32_t const stride : layout.strides) {
+        writer.Uint(stride);
+    }
+
+    writer.EndArray();
+
+    if (!settings_.part_chunks) {
+        writer.Key("stream_offsets");
+        writer.StartArray();
+
+        for (uint32_t s = 0; s < num_streams; ++s) {
+            writer.Uint64(blocks[s].offset);
+        }
+
+        writer.EndArray();
+    }
+
+    // close vertices
+    writer.EndObject();
+
+    // Indices, part chunks have their own
+    if (!settings_.part_chunks) {
+        writer.Key("indices");
+        writer.StartObject();
+
+        uint64_t const indices_size = num_indices * index_bytes;
+
+        Block_encoding const index_encoding =
+            4 == index_bytes ? (delta_indices ? Block_encoding::Int32 : Block_encoding::UInt32)
+                             : (delta_indices ? Block_encoding::Int16 : Block_encoding::UInt16);
+
+        binary_tag(writer, add_block(indices_size, Block_content::Indices, index_encoding, 0),
+                   indices_size);
+
+        writer.Key("num_indices");
+        writer.Uint64(num_indices);
+
+        writer.Key("encoding");
+
+        if (4 == index_bytes) {
+            if (delta_indices) {
+                writer.String("Int32");
+            } else {
+                writer.String("UInt32");
+            }
+        } else {
+            if (delta_indices) {
+                writer.String("Int16");
+            } else {
+                writer.String("UInt16");
+            }
+        }
+
+        if (part_relative) {
+            writer.Key("relative_to");
+            writer.String("base_vertex");
+        }
+
+        // close indices
+        writer.EndObject();
+    }
+
+    std::vector<packed_float3> welded_positions;
+
+    memory::Buffer<uint32_t> welded_indices(settings_.position_stream ? num_indices : 0);
+
+    std::vector<uint32_t> welded_base_vertices;
+
+    bool welded_relative = false;
 
-                int16_t const delta_index = int16_t(a - previous_index);
-                stream.write(reinterpret_cast<char const*>(&delta_index), sizeof(int16_t));
+    if (settings_.position_stream) {
+        welded_relative = weld_positions(model, parts_cover_indices, welded_positions,
+                                         welded_indices, welded_base_vertices, threads);
+
+        uint64_t const welded_vertices_size = welded_positions.size() * sizeof(packed_float3);
+
+        uint64_t const welded_indices_size = num_indices * (welded_relative ? 2 : 4);
+
+        writer.Key("position_stream");
+        writer.StartObject();
+
+        writer.Key("vertices");
+        writer.StartObject();
+
+        binary_tag(writer,
+                   add_block(welded_vertices_size, Block_content::Position_stream_vertices,
+                             Block_encoding::Float32x3, 0),
+                   welded_vertices_size);
+
+        writer.Key("num_vertices");
+        writer.Uint64(welded_positions.size());
+
+        writer.Key("encoding");
+        writer.String("Float32x3");
+
+        writer.EndObject();
+
+        writer.Key("indices");
+        writer.StartObject();
+
+        binary_tag(writer,
+                   add_block(welded_indices_size, Block_content::Position_stream_indices,
+                             welded_relative ? Block_encoding::UInt16 : Block_encoding::UInt32,
+                             0),
+                   welded_indices_size);
+
+        writer.Key("num_indices");
+        writer.Uint64(num_indices);
+
+        writer.Key("encoding");
+        writer.String(welded_relative ? "UInt16" : "UInt32");
+
+        if (welded_relative && parts_cover_indices) {
+            writer.Key("relative_to");
+            writer.String("base_vertex");
+        }
+
+        writer.EndObject();
+
+        // Per part, for the same start_index and num_indices as the regular indices
+        if (parts_cover_indices) {
+            writer.Key("base_vertices");
+            writer.StartArray();
+
+            for (uint32_t const b : welded_base_vertices) {
+                writer.Uint(b);
+            }
+
+            writer.EndArray();
+        }
+
+        writer.EndObject();
+    }
 
-                previous_index = a;
+    if (settings_.bvh) {
+        bvh::Builder::Settings const& parameters = builder.settings();
+
+        uint64_t const nodes_size = tree.nodes.size() * sizeof(bvh::Node);
+
+        writer.Key("bvh");
+        writer.StartObject();
+
+        writer.Key("parameters");
+        writer.StartObject();
+
+        writer.Key("algorithm");
+        writer.String("Binned_SAH");
+
+        writer.Key("num_bins");
+        writer.Uint(parameters.num_bins);
+
+        writer.Key("max_primitives");
+        writer.Uint(parameters.max_primitives);
+
+        writer.Key("traversal_cost");
+        writer.Double(parameters.traversal_cost);
+
+        writer.Key("intersection_cost");
+        writer.Double(parameters.intersection_cost);
+
+        writer.EndObject();
+
+        // SAH may prefer bigger leaves than max_primitives, up to 255
+        uint32_t max_leaf_primitives = 0;
+
+        for (auto const& n : tree.nodes) {
+            max_leaf_primitives = std::max(max_leaf_primitives, uint32_t(n.num_primitives));
+        }
+
+        writer.Key("max_leaf_primitives");
+        writer.Uint(max_leaf_primitives);
+
+        writer.Key("nodes");
+        writer.StartObject();
+
+        binary_tag(writer,
+                   add_block(nodes_size, Block_content::BVH_nodes, Block_encoding::Structured, 0),
+                   nodes_size);
+
+        writer.Key("num_nodes");
+        writer.Uint64(tree.nodes.size());
+
+        writer.EndObject();
+
+        writer.Key("triangles");
+        writer.StartObject();
+
+        uint64_t const triangles_size = tree.triangles.size() * sizeof(uint32_t);
+
+        binary_tag(writer,
+                   add_block(triangles_size, Block_content::BVH_triangles, Block_encoding::UInt32,
+                             0),
+                   triangles_size);
+
+        writer.Key("num_triangles");
+        writer.Uint64(tree.triangles.size());
+
+        writer.EndObject();
+
+        // close bvh
+        writer.EndObject();
+    }
+
+    if (settings_.triangles) {
+        writer.Key("intersection_triangles");
+        writer.StartObject();
+
+        uint64_t const triangles_size = uint64_t(num_triangles) * sizeof(Triangle_record);
+
+        binary_tag(writer,
+                   add_block(triangles_size, Block_content::Intersection_triangles,
+                             Block_encoding::Structured, 0),
+                   triangles_size);
+
+        writer.Key("num_triangles");
+        writer.Uint(num_triangles);
+
+        writer.Key("layout");
+        writer.String("Vertex_edge_edge");
+
+        writer.Key("order");
+        writer.String(settings_.bvh ? "BVH" : "Indices");
+
+        writer.EndObject();
+    }
+
+    if (Lights const* lights = settings_.lights; lights) {
+        uint64_t const num_lights = lights->triangles.size();
+
+        writer.Key("lights");
+        writer.StartObject();
+
+        writer.Key("total_power");
+        writer.Double(lights->total_power);
+
+        writer.Key("triangles");
+        writer.StartObject();
+
+        uint64_t const triangles_size = num_lights * sizeof(Lights::Triangle);
+
+        binary_tag(writer,
+                   add_block(triangles_size, Block_content::Light_triangles,
+                             Block_encoding::Structured, 0),
+                   triangles_size);
+
+        writer.Key("num_triangles");
+        writer.Uint64(num_lights);
+
+        writer.Key("layout");
+        writer.String("Index_material_area_power_radiance_instance");
+
+        writer.EndObject();
+
+        writer.Key("cdf");
+        writer.StartObject();
+
+        uint64_t const cdf_size = lights->cdf.size() * sizeof(float);
+
+        binary_tag(writer, add_block(cdf_size, Block_content::Light_cdf, Block_encoding::Float32, 0),
+                   cdf_size);
+
+        writer.Key("encoding");
+        writer.String("Float32");
+
+        writer.EndObject();
+
+        writer.EndObject();
+    }
+
+    // close geometry
+    writer.EndObject();
+
+    // close start
+    writer.EndObject();
+
+    File_header header;
+
+    header.alignment     = uint32_t(alignment);
+    header.num_blocks    = uint32_t(blocks.size());
+    header.json_offset   = 4 + sizeof(File_header) + blocks.size() * sizeof(Toc_entry);
+    header.json_size     = sb.GetSize();
+    header.binary_offset = align(header.json_offset + header.json_size, alignment);
+
+    for (auto& b : blocks) {
+        b.offset += header.binary_offset;
+    }
+
+    char const magic[] = "SUB\001";
+    stream.write(magic, sizeof(char) * 4);
+
+    stream.write(reinterpret_cast<char const*>(&header), sizeof(File_header));
+    stream.write(reinterpret_cast<char const*>(blocks.data()), blocks.size() * sizeof(Toc_entry));
+    stream.write(reinterpret_cast<char const*>(sb.GetString()), header.json_size * sizeof(char));
+
+    // binary stuff
+
+    uint32_t current_block = 0;
+
+    if (settings_.part_chunks) {
+        write_chunks(model, layout, settings_.tangent_space, chunks.data(), blocks.data(), stream,
+                     threads);
+
+        current_block = num_parts * (num_streams + 1);
+    } else {
+        write_vertices(model, layout, settings_.tangent_space, blocks.data(), stream, threads);
+
+        current_block = num_streams;
+
+        pad_to(stream, blocks[current_block++].offset);
+
+        uint32_t const* indices = model.indices();
+
+        if (4 == index_bytes) {
+            int32_t previous_index = 0;
+
+            if (delta_indices) {
+                for (uint32_t i = 0; i < num_indices; ++i) {
+                    int32_t const a = int32_t(indices[i]);
+
+                    int32_t const delta_index = a - previous_index;
+                    stream.write(reinterpret_cast<char const*>(&delta_index), sizeof(int32_t));
+
+                    previous_index = a;
+                }
+            } else {
+                stream.write(reinterpret_cast<char const*>(model.indices()),
+                             num_indices * sizeof(uint32_t));
             }
         } else {
+            if (delta_indices) {
+                int32_t previous_index = 0;
+
+                for (uint32_t i = 0; i < num_indices; ++i) {
+                    int32_t const a = int32_t(indices[i]);
+
+                    int16_t const delta_index = int16_t(a - previous_index);
+                    stream.write(reinterpret_cast<char const*>(&delta_index), sizeof(int16_t));
+
+                    previous_index = a;
+                }
+            } else if (part_relative) {
+                memory::Buffer<uint16_t> relative_indices(num_indices);
+
+                for (uint32_t i = 0; i < num_parts; ++i) {
+                    Model::Part const& p = parts[i];
+
+                    for (uint32_t j = p.start_index, len = p.start_index + p.num_indices; j < len;
+                         ++j) {
+                        relative_indices[j] = uint16_t(indices[j] - chunks[i].base_vertex);
+                    }
+                }
+
+                stream.write(reinterpret_cast<char const*>(relative_indices.data()),
+                             num_indices * sizeof(uint16_t));
+            } else {
+                for (uint32_t i = 0; i < num_indices; ++i) {
+                    uint16_t const a = uint16_t(indices[i]);
+
+                    stream.write(reinterpret_cast<char const*>(&a), sizeof(uint16_t));
+                }
+            }
+        }
+    }
+
+    if (settings_.position_stream) {
+        pad_to(stream, blocks[current_block++].offset);
+
+        stream.write(reinterpret_cast<char const*>(welded_positions.data()),
+                     welded_positions.size() * sizeof(packed_float3));
+
+        pad_to(stream, blocks[current_block++].offset);
+
+        if (welded_relative) {
+            // The welded indices are part-relative already
             for (uint32_t i = 0; i < num_indices; ++i) {
-                uint16_t const a = uint16_t(indices[i]);
+                uint16_t const a = uint16_t(welded_indices[i]);
 
                 stream.write(reinterpret_cast<char const*>(&a), sizeof(uint16_t));
             }
+        } else {
+            stream.write(reinterpret_cast<char const*>(welded_indices.data()),
+                         num_indices * sizeof(uint32_t));
         }
     }
 
+    if (settings_.bvh) {
+        pad_to(stream, blocks[current_block++].offset);
+
+        stream.write(reinterpret_cast<char const*>(tree.nodes.data()),
+                     tree.nodes.size() * sizeof(bvh::Node));
+
+        pad_to(stream, blocks[current_block++].offset);
+
+        stream.write(reinterpret_cast<char const*>(tree.triangles.data()),
+                     tree.triangles.size() * sizeof(uint32_t));
+    }
+
+    if (settings_.triangles) {
+        pad_to(stream, blocks[current_block++].offset);
+
+        stream.write(reinterpret_cast<char const*>(triangles.data()),
+                     num_triangles * sizeof(Triangle_record));
+    }
+
+    if (Lights const* lights = settings_.lights; lights) {
+        pad_to(stream, blocks[current_block++].offset);
+
+        stream.write(reinterpret_cast<char const*>(lights->triangles.data()),
+                     lights->triangles.size() * sizeof(Lights::Triangle));
+
+        pad_to(stream, blocks[current_block++].offset);
+
+        stream.write(reinterpret_cast<char const*>(lights->cdf.data()),
+                     lights->cdf.size() * sizeof(float));
+    }
+
     return true;
 }
 
+// Tightly packed data of one element for all vertices
+static void encode(Model const& model, Vertex_layout_description::Element const& element,
+                   Exporter_sub::Tangent_space tangent_space, uint8_t* buffer,
+                   thread::Pool& threads) noexcept {
+    using Semantic = Vertex_layout_description::Semantic;
+
+    uint32_t const num_vertices = model.num_vertices();
+
+    switch (element.semantic) {
+        case Semantic::Position: {
+            packed_float3* floats3 = reinterpret_cast<packed_float3*>(buffer);
+
+            float3 const* positions = model.positions();
+            for (uint32_t i = 0; i < num_vertices; ++i) {
+                floats3[i] = packed_float3(positions[i]);
+            }
+        } break;
+        case Semantic::Normal: {
+            packed_float3* floats3 = reinterpret_cast<packed_float3*>(buffer);
+
+            float3 const* normals = model.normals();
+            for (uint32_t i = 0; i < num_vertices; ++i) {
+                if (normals) {
+                    floats3[i] = packed_float3(normals[i]);
+                } else {
+                    floats3[i] = packed_float3(0.f);
+                }
+            }
+        } break;
+        case Semantic::Tangent_space:
+            write_tangent_space(model, tangent_space, buffer, threads);
+            break;
+        case Semantic::Texture_coordinate:
+            std::copy(model.texture_coordinates(), model.texture_coordinates() + num_vertices,
+                      reinterpret_cast<float2*>(buffer));
+            break;
+    }
+}
+
+// Stream s of all vertices, tightly packed. Single elements without padding end up in
+// element_buffer, everything else in stream_buffer.
+static uint8_t const* encode_stream(Model const& model, Vertex_layout_description const& layout,
+                                    uint32_t s, Exporter_sub::Tangent_space tangent_space,
+                                    uint8_t* element_buffer, uint8_t* stream_buffer,
+                                    thread::Pool& threads) noexcept {
+    using Layout = Vertex_layout_description;
+
+    uint64_t const num_vertices = model.num_vertices();
+
+    uint32_t const stride = layout.strides[s];
+
+    if (1 == std::count_if(layout.elements.begin(), layout.elements.end(),
+                           [s](Layout::Element const& e) { return e.stream == s; })) {
+        auto const& element = *std::find_if(layout.elements.begin(), layout.elements.end(),
+                                            [s](Layout::Element const& e) { return e.stream == s; });
+
+        if (Layout::size(element.encoding) == stride) {
+            encode(model, element, tangent_space, element_buffer, threads);
+
+            return element_buffer;
+        }
+    }
+
+    std::fill(stream_buffer, stream_buffer + num_vertices * stride, uint8_t(0));
+
+    for (auto const& element : layout.elements) {
+        if (element.stream != s) {
+            continue;
+        }
+
+        encode(model, element, tangent_space, element_buffer, threads);
+
+        uint32_t const size = Layout::size(element.encoding);
+
+        uint8_t const* source = element_buffer;
+        uint8_t*       dest   = stream_buffer + element.byte_offset;
+
+        for (uint64_t i = 0; i < num_vertices; ++i) {
+            std::copy(source + i * size, source + (i + 1) * size, dest + i * stride);
+        }
+    }
+
+    return stream_buffer;
+}
+
+void write_vertices(Model const& model, Vertex_layout_description const& layout,
+                    Exporter_sub::Tangent_space tangent_space, Toc_entry const* blocks,
+                    std::ostream& stream, thread::Pool& threads) noexcept {
+    uint64_t const num_vertices = model.num_vertices();
+
+    uint32_t const max_stride = *std::max_element(layout.strides.begin(), layout.strides.end());
+
+    // Large enough for the biggest element, also as scratch for the tangent space
+    memory::Buffer<uint8_t> element_buffer(num_vertices * 4 * sizeof(float));
+    memory::Buffer<uint8_t> stream_buffer(num_vertices * max_stride);
+
+    for (uint32_t s = 0, len = uint32_t(layout.strides.size()); s < len; ++s) {
+        uint8_t const* data = encode_stream(model, layout, s, tangent_space, element_buffer,
+                                            stream_buffer, threads);
+
+        pad_to(stream, blocks[s].offset);
+
+        stream.write(reinterpret_cast<char const*>(data), num_vertices * layout.strides[s]);
+    }
+}
+
+void write_chunks(Model const& model, Vertex_layout_description const& layout,
+                  Exporter_sub::Tangent_space tangent_space, Chunk const* chunks,
+                  Toc_entry const* blocks, std::ostream& stream, thread::Pool& threads) noexcept {
+    uint64_t const num_vertices = model.num_vertices();
+
+    uint32_t const num_streams = uint32_t(layout.strides.size());
+
+    // All streams at once, each part takes a slice of every one of them
+    memory::Buffer<uint8_t> element_buffer(num_vertices * 4 * sizeof(float));
+    memory::Buffer<uint8_t> streams_buffer(num_vertices * layout.vertex_size());
+
+    std::vector<uint8_t const*> streams(num_streams);
+
+    for (uint32_t s = 0, offset = 0; s < num_streams; ++s) {
+        uint8_t* stream_buffer = streams_buffer.data() + num_vertices * offset;
+
+        uint8_t const* data = encode_stream(model, layout, s, tangent_space, element_buffer,
+                                            stream_buffer, threads);
+
+        if (data != stream_buffer) {
+            std::copy(data, data + num_vertices * layout.strides[s], stream_buffer);
+        }
+
+        streams[s] = stream_buffer;
+
+        offset += layout.strides[s];
+    }
+
+    Model::Part const* parts   = model.parts();
+    uint32_t const*    indices = model.indices();
+
+    std::vector<uint8_t> chunk_indices;
+
+    for (uint32_t p = 0, len = model.num_parts(); p < len; ++p) {
+        Chunk const& c = chunks[p];
+
+        for (uint32_t s = 0; s < num_streams; ++s) {
+            uint32_t const stride = layout.strides[s];
+
+            pad_to(stream, blocks[p * (num_streams + 1) + s].offset);
+
+            stream.write(reinterpret_cast<char const*>(streams[s] + uint64_t(c.base_vertex) * stride),
+                         uint64_t(c.num_vertices) * stride);
+        }
+
+        pad_to(stream, blocks[p * (num_streams + 1) + num_streams].offset);
+
+        uint32_t const begin       = parts[p].start_index;
+        uint32_t const num_indices = parts[p].num_indices;
+
+        chunk_indices.resize(uint64_t(num_indices) * c.index_bytes);
+
+        if (2 == c.index_bytes) {
+            uint16_t* relative = reinterpret_cast<uint16_t*>(chunk_indices.data());
+
+            for (uint32_t i = 0; i < num_indices; ++i) {
+                relative[i] = uint16_t(indices[begin + i] - c.base_vertex);
+            }
+        } else {
+            uint32_t* relative = reinterpret_cast<uint32_t*>(chunk_indices.data());
+
+            for (uint32_t i = 0; i < num_indices; ++i) {
+                relative[i] = indices[begin + i] - c.base_vertex;
+            }
+        }
+
+        stream.write(reinterpret_cast<char const*>(chunk_indices.data()), chunk_indices.size());
+    }
+}
+
+void write_tangent_space(Model const& model, Exporter_sub::Tangent_space tangent_space,
+                         uint8_t* buffer, thread::Pool& threads) noexcept {
+    uint32_t const num_vertices = model.num_vertices();
+
+    float4 const* tangents = model.tangents();
+    float3 const* normals  = model.normals();
+
+    if (Exporter_sub::Tangent_space::Octahedral == tangent_space) {
+        uint32_t* frames = reinterpret_cast<uint32_t*>(buffer);
+
+        threads.run_range(
+            [&](uint32_t /*id*/, int32_t begin, int32_t end) noexcept {
+                for (int32_t i = begin; i < end; ++i) {
+                    float4 const t = tangents[i];
+
+                    frames[i] = encoding::octahedral_tangent_frame(normals[i], t.xyz(), t[3]);
+                }
+            },
+            0, int32_t(num_vertices));
+
+        return;
+    }
+
+    float4* quaternions = reinterpret_cast<float4*>(buffer);
+
+    math::batch::tangent_space(tangents, normals, quaternions, num_vertices);
+
+    if (Exporter_sub::Tangent_space::QTangent == tangent_space) {
+        // In place, every element only overwrites bytes that were already read
+        short4* qtangents = reinterpret_cast<short4*>(buffer);
+
+        for (uint32_t i = 0; i < num_vertices; ++i) {
+            qtangents[i] = encoding::qtangent(quaternions[i]);
+        }
+    }
+}
+
+void write_triangles(Model const& model, uint32_t const* order, Triangle_record* triangles,
+                     thread::Pool& threads) noexcept {
+    uint32_t const num_triangles = model.num_indices() / 3;
+
+    // Part of every triangle, because order may be any permutation
+    memory::Buffer<uint32_t> triangle_parts(num_triangles);
+
+    // Parts don't have to cover all indices
+    std::fill_n(triangle_parts.data(), num_triangles, No_part);
+
+    Model::Part const* parts = model.parts();
+    for (uint32_t p = 0, len = model.num_parts(); p < len; ++p) {
+        uint32_t const begin = parts[p].start_index / 3;
+        uint32_t const end   = begin + parts[p].num_indices / 3;
+
+        for (uint32_t t = begin; t < end; ++t) {
+            triangle_parts[t] = p;
+        }
+    }
+
+    float3 const*   positions = model.positions();
+    uint32_t const* indices   = model.indices();
+
+    threads.run_range(
+        [&](uint32_t /*id*/, int32_t begin, int32_t end) noexcept {
+            for (int32_t i = begin; i < end; ++i) {
+                uint32_t const t = order ? order[i] : uint32_t(i);
+
+                float3 const a = positions[indices[t * 3 + 0]];
+                float3 const b = positions[indices[t * 3 + 1]];
+                float3 const c = positions[indices[t * 3 + 2]];
+
+                uint32_t const p = triangle_parts[t];
+
+                Triangle_record& r = triangles[i];
+
+                r.v0             = packed_float3(a);
+                r.part           = p;
+                r.e1             = packed_float3(b - a);
+                r.material_index = No_part == p ? No_part : parts[p].material_index;
+                r.e2             = packed_float3(c - a);
+                r.pad            = 0;
+            }
+        },
+        0, int32_t(num_triangles));
+}
+
+
+// Positions compare by their bits, so -0 and 0 stay apart
+struct Position_key {
+    uint32_t v[3];
+
+    bool operator==(Position_key const& other) const noexcept {
+        return v[0] == other.v[0] && v[1] == other.v[1] && v[2] == other.v[2];
+    }
+};
+
+struct Position_key_hash {
+    size_t operator()(Position_key const& key) const noexcept {
+        return size_t(hash::fnv_1a(key.v, sizeof(key.v)));
+    }
+};
+
+// Every part gets its own range of unique positions, with indices relative to the start of that
+// range. Returns whether all of them fit into 16 bits, otherwise the indices are made absolute.
+bool weld_positions(Model const& model, bool per_part, std::vector<packed_float3>& positions,
+                    uint32_t* indices, std::vector<uint32_t>& base_vertices,
+                    thread::Pool& threads) noexcept {
+    uint32_t const num_ranges = per_part ? model.num_parts() : 1;
+
+    std::vector<std::vector<packed_float3>> range_positions(num_ranges);
+
+    std::atomic<uint32_t> current = 0;
+
+    threads.run_parallel([&](uint32_t /*id*/) noexcept {
+        std::unordered_map<Position_key, uint32_t, Position_key_hash> welded;
+
+        float3 const*   source_positions = model.positions();
+        uint32_t const* source_indices   = model.indices();
+
+        for (;;) {
+            uint32_t const r = current.fetch_add(1, std::memory_order_relaxed);
+
+            if (r >= num_ranges) {
+                return;
+            }
+
+            uint32_t const begin = per_part ? model.parts()[r].start_index : 0;
+            uint32_t const end   = per_part ? begin + model.parts()[r].num_indices
+                                            : model.num_indices();
+
+            std::vector<packed_float3>& local_positions = range_positions[r];
+
+            welded.clear();
+
+            for (uint32_t i = begin; i < end; ++i) {
+                packed_float3 const p(source_positions[source_indices[i]]);
+
+                Position_key key;
+                std::memcpy(key.v, &p, sizeof(key.v));
+
+                auto const w = welded.try_emplace(key, uint32_t(local_positions.size()));
+
+                if (w.second) {
+                    local_positions.push_back(p);
+                }
+
+                indices[i] = w.first->second;
+            }
+        }
+    });
+
+    base_vertices.resize(num_ranges);
+
+    bool relative = true;
+
+    uint32_t num_positions = 0;
+
+    for (uint32_t r = 0; r < num_ranges; ++r) {
+        base_vertices[r] = num_positions;
+
+        num_positions += uint32_t(range_positions[r].size());
+
+        relative = relative && range_positions[r].size() <= 0x10000;
+    }
+
+    positions.clear();
+    positions.reserve(num_positions);
+
+    for (auto const& p : range_positions) {
+        positions.insert(positions.end(), p.begin(), p.end());
+    }
+
+    if (!relative) {
+        for (uint32_t r = 0; r < num_ranges; ++r) {
+            uint32_t const begin = per_part ? model.parts()[r].start_index : 0;
+            uint32_t const end   = per_part ? begin + model.parts()[r].num_indices
+                                            : model.num_indices();
+
+            for (uint32_t i = begin; i < end; ++i) {
+                indices[i] += base_vertices[r];
+            }
+        }
+    }
+
+    return relative;
+}
+
 }  // namespace model
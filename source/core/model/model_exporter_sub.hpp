@@ -1,15 +1,116 @@
 #ifndef SU_CORE_MODEL_EXPORTER_SUB_HPP
 #define SU_CORE_MODEL_EXPORTER_SUB_HPP
 
+#include <cstdint>
+#include <iosfwd>
 #include <string>
 
+namespace thread {
+class Pool;
+}
+
 namespace model {
 
 class Model;
+struct Lights;
 
+// A .sub file starts with the magic "SUB\001" and a File_header, followed by one Toc_entry per
+// binary block and the JSON description. The binary blocks come last, each at a multiple of the
+// alignment from the start of the file. Offsets in the JSON are relative to binary_offset.
 class Exporter_sub {
   public:
-    bool write(std::string const& name, Model const& model) const noexcept;
+    enum class Tangent_space {
+        Quaternion,  // Float32x4
+        QTangent,    // Snorm16x4
+        Octahedral   // 32 bits, see encoding::octahedral_tangent_frame()
+    };
+
+    enum class Layout {
+        Separate,       // One stream per attribute
+        Interleaved,    // All attributes in one stream
+        Split_position  // Positions alone, the other attributes interleaved in a second stream
+    };
+
+    enum class Block_content : uint32_t {
+        Vertex_stream,  // index is the stream
+        Indices,
+        Position_stream_vertices,
+        Position_stream_indices,
+        BVH_nodes,
+        BVH_triangles,
+        Intersection_triangles,
+        Light_triangles,
+        Light_cdf
+    };
+
+    enum class Block_encoding : uint32_t {
+        Structured,  // Interleaved vertices or records, see the JSON
+        UInt16,
+        Int16,
+        UInt32,
+        Int32,
+        Float32x2,
+        Float32x3,
+        Float32x4,
+        Snorm16x4,
+        Octahedral32,
+        Float32
+    };
+
+    struct File_header {
+        uint32_t alignment;
+        uint32_t num_blocks;
+        uint64_t json_offset;
+        uint64_t json_size;
+        uint64_t binary_offset;
+    };
+
+    static uint32_t constexpr All_parts = 0xFFFFFFFF;
+
+    struct Toc_entry {
+        uint64_t       offset;  // From the start of the file
+        uint64_t       size;
+        Block_content  content;
+        Block_encoding encoding;
+        uint32_t       index;
+        uint32_t       part;  // Owner of a part chunk block, otherwise All_parts
+    };
+
+    struct Settings {
+        Layout layout = Layout::Separate;
+
+        Tangent_space tangent_space = Tangent_space::Quaternion;
+
+        // Append a binned SAH BVH over the triangles
+        bool bvh = false;
+
+        // Append per-triangle intersection records, in BVH order if there is one
+        bool triangles = false;
+
+        // Append positions welded on position alone, with their own indices, for depth passes
+        bool position_stream = false;
+
+        // Give every part its own vertex and index blocks, with indices relative to the part's
+        // first vertex, so that parts can be loaded one by one
+        bool part_chunks = false;
+
+        // Binary blocks start at multiples of this power of two, e.g. 4096 for page alignment
+        uint32_t alignment = 64;
+
+        // Append the emissive triangles and their CDF, the triangle indices must match the model
+        Lights const* lights = nullptr;
+    };
+
+    Exporter_sub(Settings const& settings) noexcept;
+
+    bool write(std::string const& name, Model const& model, thread::Pool& threads) const noexcept;
+
+    // Writes the whole file to stream, which must be at position 0 as the blocks are padded to
+    // their offsets from the start
+    bool write(std::ostream& stream, Model const& model, thread::Pool& threads) const noexcept;
+
+  private:
+    Settings const settings_;
 };
 
 }  // namespace model
@@ -2,7 +2,10 @@
 #include "base/math/vector3.inl"
 #include "base/memory/align.hpp"
 #include "model.hpp"
+#include "model_importer_io.hpp"
+#include "model_importer_timing.hpp"
 
+#include "assimp/DefaultLogger.hpp"
 #include "assimp/postprocess.h"
 #include "assimp/scene.h"
 
@@ -15,6 +18,8 @@ namespace model {
 
 static inline float3 aiVector3_to_float3(aiVector3D const& v) noexcept;
 
+static uint32_t post_processing_steps(Importer_assimp::Profile profile) noexcept;
+
 static inline bool has_aiTextureType(aiMaterial const& material,
                                      aiTextureType     type) noexcept {
     aiString path;
@@ -22,9 +27,19 @@ static inline bool has_aiTextureType(aiMaterial const& material,
     return aiReturn_SUCCESS == material.GetTexture(type, 0, &path);
 }
 
+Importer_assimp::Importer_assimp(Profile profile, bool report_timing) noexcept
+    : profile_(profile), report_timing_(report_timing) {}
+
 Model* Importer_assimp::read(std::string const& name) noexcept {
+    // The importer owns it from here on
+    importer_.SetIOHandler(new Mapped_io_system);
+
     std::vector<aiNode const*> nodes;
-    guess_light_nodes(name, nodes);
+
+    // A whole extra read, for an exclude list that currently isn't used
+    if (Profile::Fast != profile_) {
+        guess_light_nodes(name, nodes);
+    }
 
     std::stringstream excludes;
 
@@ -34,6 +49,9 @@ Model* Importer_assimp::read(std::string const& name) noexcept {
     //    std::cout << n->mName.C_Str() << std::endl;
     }
 
+    // Not needed anymore, and as large as the scene read next
+    importer_.FreeScene();
+
  //   importer_.SetPropertyString(AI_CONFIG_PP_OG_EXCLUDE_LIST, excludes.str());
 
     importer_.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS,
@@ -44,26 +62,43 @@ Model* Importer_assimp::read(std::string const& name) noexcept {
     importer_.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE,
                                  aiPrimitiveType_POINT | aiPrimitiveType_LINE);
 
-    aiScene const* scene = importer_.ReadFile(
-        name, aiProcess_ConvertToLeftHanded | aiProcess_RemoveComponent | aiProcess_Triangulate |
-                  aiProcess_FindDegenerates | aiProcess_FindInvalidData |
-                  aiProcess_RemoveRedundantMaterials | aiProcess_PreTransformVertices |
-                  aiProcess_JoinIdenticalVertices | aiProcess_FixInfacingNormals |
-                  aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace |
-                  //   aiProcess_ImproveCacheLocality
-                  aiProcess_OptimizeMeshes | /*aiProcess_OptimizeGraph | */aiProcess_SortByPType);
+    Step_timer* timer = nullptr;
+
+    if (report_timing_) {
+        // Owned by the importer, like the IO handler
+        timer = new Step_timer;
+        importer_.SetProgressHandler(timer);
+
+        // The steps only name themselves in debug messages
+        Assimp::DefaultLogger::create(nullptr, Assimp::Logger::VERBOSE, 0);
+        Assimp::DefaultLogger::get()->attachStream(new Step_names(*timer),
+                                                   Assimp::Logger::Debugging);
+    }
+
+    aiScene const* result = importer_.ReadFile(name, post_processing_steps(profile_));
+
+    if (timer) {
+        timer->finish();
 
+        Assimp::DefaultLogger::kill();
+
+        timer->print();
+    }
 
 //    aiScene const* scene = importer_.ReadFile(
 //        name, aiProcess_ConvertToLeftHanded );
 
 
-    if (!scene) {
+    if (!result) {
         std::cout << "Could not read \"" << name << "\". " << importer_.GetErrorString()
                   << std::endl;
         return nullptr;
     }
 
+    // Owned from here on, so that every mesh is released as soon as it is copied, instead of all
+    // vertices existing twice at the end
+    aiScene* scene = importer_.GetOrphanedScene();
+
     Model* model = new Model();
 
     uint32_t const num_parts = scene->mNumMeshes;
@@ -176,8 +211,13 @@ Model* Importer_assimp::read(std::string const& name) noexcept {
                 model->set_index(current_index, index);
             }
         }
+
+        delete scene->mMeshes[m];
+        scene->mMeshes[m] = nullptr;
     }
 
+    delete scene;
+
     return model;
 }
 
@@ -249,6 +289,31 @@ void Importer_assimp::guess_light_nodes(std::string const&          name,
     gather_nodes(scene->mRootNode, scene, emissive_materials, nodes);
 }
 
+uint32_t post_processing_steps(Importer_assimp::Profile profile) noexcept {
+    // Needed by the conversion itself: left-handed, indexed triangles without hierarchy, and a
+    // tangent space. Generating normals is a no-op for meshes that have them.
+    uint32_t const fast = aiProcess_ConvertToLeftHanded | aiProcess_RemoveComponent |
+                          aiProcess_Triangulate | aiProcess_PreTransformVertices |
+                          aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals |
+                          aiProcess_CalcTangentSpace | aiProcess_SortByPType;
+
+    // Repairs broken input, and merges the meshes of badly exported files
+    uint32_t const balanced = fast | aiProcess_FindDegenerates | aiProcess_FindInvalidData |
+                              aiProcess_RemoveRedundantMaterials |
+                              aiProcess_FixInfacingNormals | aiProcess_OptimizeMeshes;
+
+    switch (profile) {
+        case Importer_assimp::Profile::Fast:
+            return fast;
+        case Importer_assimp::Profile::Balanced:
+            return balanced;
+        case Importer_assimp::Profile::Thorough:
+            return balanced | aiProcess_ValidateDataStructure | aiProcess_ImproveCacheLocality;
+    }
+
+    return balanced;
+}
+
 static inline float3 aiVector3_to_float3(aiVector3D const& v) noexcept {
     float const x = std::isnan(v.x) || std::isinf(v.x) ? 0.f : v.x;
     float const y = std::isnan(v.y) || std::isinf(v.y) ? 0.f : v.y;
@@ -14,12 +14,25 @@ class Model;
 
 class Importer_assimp : public Importer {
   public:
+    // Which of assimp's post-processing steps run
+    enum class Profile {
+        Fast,      // Only what the conversion needs, for clean input
+        Balanced,  // Also repairs degenerate and invalid data and merges meshes
+        Thorough   // Also validates the scene and optimizes for the vertex cache
+    };
+
+    Importer_assimp(Profile profile = Profile::Balanced, bool report_timing = false) noexcept;
+
     Model* read(std::string const& name) noexcept final;
 
   private:
     void guess_light_nodes(std::string const& name, std::vector<aiNode const*>& nodes) noexcept;
 
     Assimp::Importer importer_;
+
+    Profile profile_;
+
+    bool report_timing_;
 };
 
 }  // namespace model
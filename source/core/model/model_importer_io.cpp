@@ -0,0 +1,174 @@
+#include "model_importer_io.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace model {
+
+Mapped_stream* Mapped_stream::open(char const* name) noexcept {
+#ifdef _WIN32
+    std::ifstream stream(name, std::ios::binary | std::ios::ate);
+
+    if (!stream) {
+        return nullptr;
+    }
+
+    size_t const size = size_t(stream.tellg());
+
+    uint8_t* data = new uint8_t[std::max(size, size_t(1))];
+
+    stream.seekg(0);
+
+    if (!stream.read(reinterpret_cast<char*>(data), std::streamsize(size))) {
+        delete[] data;
+        return nullptr;
+    }
+
+    return new Mapped_stream(data, size, false);
+#else
+    int const fd = ::open(name, O_RDONLY);
+
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat info;
+
+    if (0 != ::fstat(fd, &info) || !S_ISREG(info.st_mode)) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    size_t const size = size_t(info.st_size);
+
+    // mmap() can't map nothing
+    if (0 == size) {
+        ::close(fd);
+        return new Mapped_stream(nullptr, 0, false);
+    }
+
+    void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping keeps the file alive
+    ::close(fd);
+
+    if (MAP_FAILED == data) {
+        return nullptr;
+    }
+
+    // Most importers read front to back, and all of them read the whole file
+    ::madvise(data, size, MADV_SEQUENTIAL);
+    ::madvise(data, size, MADV_WILLNEED);
+
+    return new Mapped_stream(static_cast<uint8_t const*>(data), size, true);
+#endif
+}
+
+Mapped_stream::Mapped_stream(uint8_t const* data, size_t size, bool mapped) noexcept
+    : data_(data), size_(size), position_(0), mapped_(mapped) {}
+
+Mapped_stream::~Mapped_stream() noexcept {
+#ifndef _WIN32
+    if (mapped_) {
+        ::munmap(const_cast<uint8_t*>(data_), size_);
+        return;
+    }
+#endif
+
+    delete[] data_;
+}
+
+size_t Mapped_stream::Read(void* buffer, size_t size, size_t count) noexcept {
+    if (0 == size || 0 == count) {
+        return 0;
+    }
+
+    // Whole elements only, like fread()
+    size_t const available = std::min((size_ - position_) / size, count);
+
+    std::memcpy(buffer, data_ + position_, available * size);
+
+    position_ += available * size;
+
+    return available;
+}
+
+size_t Mapped_stream::Write(void const* /*buffer*/, size_t /*size*/,
+                            size_t /*count*/) noexcept {
+    return 0;
+}
+
+aiReturn Mapped_stream::Seek(size_t offset, aiOrigin origin) noexcept {
+    // Like fseek(), which assimp passes negative offsets to in two's complement
+    size_t target;
+
+    switch (origin) {
+        case aiOrigin_SET:
+            target = offset;
+            break;
+        case aiOrigin_CUR:
+            target = position_ + offset;
+            break;
+        case aiOrigin_END:
+            target = size_ + offset;
+            break;
+        default:
+            return aiReturn_FAILURE;
+    }
+
+    if (target > size_) {
+        return aiReturn_FAILURE;
+    }
+
+    position_ = target;
+
+    return aiReturn_SUCCESS;
+}
+
+size_t Mapped_stream::Tell() const noexcept {
+    return position_;
+}
+
+size_t Mapped_stream::FileSize() const noexcept {
+    return size_;
+}
+
+void Mapped_stream::Flush() noexcept {}
+
+bool Mapped_io_system::Exists(char const* name) const noexcept {
+    struct stat info;
+
+    return 0 == ::stat(name, &info);
+}
+
+char Mapped_io_system::getOsSeparator() const noexcept {
+#ifdef _WIN32
+    return '\\';
+#else
+    return '/';
+#endif
+}
+
+Assimp::IOStream* Mapped_io_system::Open(char const* name, char const* mode) noexcept {
+    if (std::strchr(mode, 'w') || std::strchr(mode, 'a') || std::strchr(mode, '+')) {
+        return nullptr;
+    }
+
+    return Mapped_stream::open(name);
+}
+
+void Mapped_io_system::Close(Assimp::IOStream* stream) noexcept {
+    delete stream;
+}
+
+}  // namespace model
@@ -0,0 +1,58 @@
+#ifndef SU_CORE_MODEL_IMPORTER_IO_HPP
+#define SU_CORE_MODEL_IMPORTER_IO_HPP
+
+#include "assimp/IOStream.hpp"
+#include "assimp/IOSystem.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace model {
+
+// Read-only view of a whole file. Mapped into memory with read-ahead advice where mmap() exists,
+// read into memory otherwise.
+class Mapped_stream : public Assimp::IOStream {
+  public:
+    static Mapped_stream* open(char const* name) noexcept;
+
+    ~Mapped_stream() noexcept override;
+
+    size_t Read(void* buffer, size_t size, size_t count) noexcept override;
+
+    size_t Write(void const* buffer, size_t size, size_t count) noexcept override;
+
+    aiReturn Seek(size_t offset, aiOrigin origin) noexcept override;
+
+    size_t Tell() const noexcept override;
+
+    size_t FileSize() const noexcept override;
+
+    void Flush() noexcept override;
+
+  private:
+    Mapped_stream(uint8_t const* data, size_t size, bool mapped) noexcept;
+
+    uint8_t const* data_;
+
+    size_t size_;
+    size_t position_;
+
+    bool mapped_;
+};
+
+// Serves every file assimp reads, including the ones a model references, from Mapped_streams.
+// Files can't be opened for writing.
+class Mapped_io_system : public Assimp::IOSystem {
+  public:
+    bool Exists(char const* name) const noexcept override;
+
+    char getOsSeparator() const noexcept override;
+
+    Assimp::IOStream* Open(char const* name, char const* mode = "rb") noexcept override;
+
+    void Close(Assimp::IOStream* stream) noexcept override;
+};
+
+}  // namespace model
+
+#endif
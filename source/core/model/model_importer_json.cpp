@@ -1,5 +1,6 @@
 #include "model_importer_json.hpp"
 #include "base/math/vector3.inl"
+#include "base/memory/align.hpp"
 #include "model.hpp"
 #include "rapidjson/istreamwrapper.h"
 #include "triangle_json_handler.hpp"
@@ -9,6 +10,23 @@
 
 namespace model {
 
+static bool read_buffer(std::string const& name, Json_handler& handler) noexcept;
+
+static bool copy_parts_and_instances(Model& model, Json_handler const& handler) noexcept;
+
+template <unsigned Flags, class Handler>
+static bool parse(std::ifstream& stream, Handler& handler) noexcept {
+    static size_t constexpr Buffer_size = 8192;
+
+    std::vector<char> buffer(Buffer_size);
+
+    rapidjson::IStreamWrapper json_stream(stream, buffer.data(), Buffer_size);
+
+    rapidjson::Reader reader;
+
+    return !reader.Parse<Flags>(json_stream, handler).IsError();
+}
+
 Model* Importer_json::read(std::string const& name) noexcept {
     std::ifstream stream(name, std::ios::binary);
     if (!stream) {
@@ -16,102 +34,141 @@ Model* Importer_json::read(std::string const& name) noexcept {
         return nullptr;
     }
 
-    Json_handler handler;
+    Json_handler::Sizes sizes;
 
-    {
-        static size_t constexpr Buffer_size = 8192;
+    for (bool counted = false, resized = false;;) {
+        Model* model = new Model();
 
-        std::vector<char> buffer(Buffer_size);
+        Json_handler handler(*model, sizes);
 
-        rapidjson::IStreamWrapper json_stream(stream, buffer.data(), Buffer_size);
+        bool const parsed = parse<rapidjson::kParseDefaultFlags>(stream, handler);
 
-        rapidjson::Reader reader;
+        if (handler.missing_sizes() && !counted) {
+            // No size metadata in front of the arrays: count them first, then read again
+            delete model;
 
-        reader.Parse(json_stream, handler);
+            Json_size_handler size_handler;
 
-        stream.close();
-    }
-
-    if (handler.vertices().empty()) {
-        return nullptr;
-    }
+            stream.clear();
+            stream.seekg(0);
 
-    if (!handler.has_positions()) {
-        return nullptr;
-    }
+            parse<rapidjson::kParseNumbersAsStringsFlag>(stream, size_handler);
 
-    if (handler.triangles().empty()) {
-        return nullptr;
-    }
+            sizes = size_handler.sizes();
 
-    Model* model = new Model();
+            stream.clear();
+            stream.seekg(0);
 
-    uint32_t const num_parts = handler.parts().size();
+            counted = true;
+            continue;
+        }
 
-    model->allocate_parts(num_parts);
+        if (handler.guessed_num_indices() && !resized &&
+            handler.num_indices_found() != model->num_indices()) {
+            // The parts don't cover all indices: read again with the number that was found
+            delete model;
 
-    for (uint32_t i = 0; i < num_parts; ++i) {
-        Part const& p = handler.parts()[i];
+            sizes.num_indices = handler.num_indices_found();
 
-        Model::Part part{p.start_index, p.num_indices, p.material_index};
+            stream.clear();
+            stream.seekg(0);
 
-        model->set_part(i, part);
-    }
+            resized = true;
+            continue;
+        }
 
-    uint32_t const num_vertices = handler.vertices().size();
+        if (parsed && !handler.buffer_file().empty() && !read_buffer(name, handler)) {
+            std::cout << "Could not read \"" << handler.buffer_file() << "\"." << std::endl;
 
-    uint32_t const num_indices = handler.triangles().size() * 3;
+            delete model;
+            return nullptr;
+        }
 
-    model->set_num_vertices(num_vertices);
+        if (!parsed || 0 == model->num_vertices() || !handler.has_positions() ||
+            0 == handler.num_indices_read()) {
+            delete model;
+            return nullptr;
+        }
 
-    model->allocate_positions();
+        if (!handler.complete()) {
+            std::cout << "\"" << name << "\" has vertex or index arrays that don't match their "
+                      << "sizes." << std::endl;
 
-    bool const has_normals = handler.has_normals();
+            delete model;
+            return nullptr;
+        }
 
-    bool const has_tangents = handler.has_tangents();
+        if (!copy_parts_and_instances(*model, handler)) {
+            std::cout << "\"" << name << "\" has parts outside of the indices, or instances of "
+                      << "parts that don't exist." << std::endl;
 
-    bool const has_uvs = handler.has_texture_coordinates();
+            delete model;
+            return nullptr;
+        }
 
-    if (has_normals) {
-        model->allocate_normals();
+        return model;
     }
+}
 
-    if (has_tangents) {
-        model->allocate_tangents();
+bool read_buffer(std::string const& name, Json_handler& handler) noexcept {
+    // The buffer file is relative to the JSON file
+    size_t const slash = name.find_last_of('/');
+
+    std::string const path = std::string::npos == slash
+                                 ? handler.buffer_file()
+                                 : name.substr(0, slash + 1) + handler.buffer_file();
+
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) {
+        return false;
     }
 
-    if (has_uvs) {
-        model->allocate_texture_coordinates();
+    stream.seekg(0, std::ios::end);
+    uint64_t const size = uint64_t(stream.tellg());
+    stream.seekg(0, std::ios::beg);
+
+    // All arrays in a single read
+    memory::Buffer<uint8_t> buffer(size);
+
+    if (!stream.read(reinterpret_cast<char*>(buffer.data()), std::streamsize(size))) {
+        return false;
     }
 
-    for (uint32_t i = 0; i < num_vertices; ++i) {
-        auto const& v = handler.vertices()[i];
+    return handler.read_buffer(buffer, size);
+}
 
-        model->set_position(i, float3(v.p));
+bool copy_parts_and_instances(Model& model, Json_handler const& handler) noexcept {
+    uint32_t const num_parts = handler.parts().size();
 
-        if (has_tangents && has_normals) {
-            model->set_tangent(i, float3(v.t), float3(v.n), v.bitangent_sign > 0 ? -1.f : 1.f);
+    model.allocate_parts(num_parts);
 
-        } else if (has_normals) {
-            model->set_normal(i, float3(v.n));
-        }
+    for (uint32_t i = 0; i < num_parts; ++i) {
+        Part const& p = handler.parts()[i];
 
-        if (has_uvs) {
-            model->set_texture_coordinate(i, v.uv);
+        if (uint64_t(p.start_index) + uint64_t(p.num_indices) > uint64_t(model.num_indices())) {
+            return false;
         }
+
+        Model::Part part{p.start_index, p.num_indices, p.material_index};
+
+        model.set_part(i, part);
     }
 
-    model->allocate_indices(num_indices);
+    if (uint32_t const num_instances = uint32_t(handler.instances().size()); num_instances > 0) {
+        model.allocate_instances(num_instances);
 
-    for (uint32_t i = 0, len = num_indices / 3; i < len; ++i) {
-        auto const& tri = handler.triangles()[i];
+        for (uint32_t i = 0; i < num_instances; ++i) {
+            Instance const& in = handler.instances()[i];
 
-        model->set_index(i * 3 + 0, tri.i[0]);
-        model->set_index(i * 3 + 1, tri.i[1]);
-        model->set_index(i * 3 + 2, tri.i[2]);
+            if (in.part >= num_parts) {
+                return false;
+            }
+
+            model.set_instance(i, {in.part, {in.position, float3(1.f), in.rotation}});
+        }
     }
 
-    return model;
+    return true;
 }
 
 }  // namespace model
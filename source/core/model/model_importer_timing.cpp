@@ -0,0 +1,102 @@
+#include "model_importer_timing.hpp"
+#include "base/chrono/chrono.hpp"
+
+#include <cctype>
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+
+namespace model {
+
+bool Step_timer::Update(float /*percentage*/) noexcept {
+    return true;
+}
+
+void Step_timer::UpdateFileRead(int current, int total) noexcept {
+    // Called once before and once after the file is read
+    if (current < total || marks_.empty()) {
+        marks_.push_back({"read", clock::now(), false});
+    } else {
+        marks_.push_back({"preprocess", clock::now(), false});
+    }
+}
+
+void Step_timer::UpdatePostProcess(int current, int total) noexcept {
+    // Called before every registered step, active or not, and once after the last one
+    if (current >= total) {
+        finish();
+        return;
+    }
+
+    marks_.push_back({"", clock::now(), true});
+}
+
+void Step_timer::log(char const* message) noexcept {
+    if (marks_.empty() || !marks_.back().step) {
+        return;
+    }
+
+    // "Debug, T1234: TriangulateProcess begin\n"
+    std::string_view text(message);
+
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) {
+        text.remove_suffix(1);
+    }
+
+    std::string_view const suffix = " begin";
+
+    if (text.size() <= suffix.size() || text.substr(text.size() - suffix.size()) != suffix) {
+        return;
+    }
+
+    text.remove_suffix(suffix.size());
+
+    if (size_t const colon = text.rfind(": "); std::string_view::npos != colon) {
+        text.remove_prefix(colon + 2);
+    }
+
+    marks_.back().name = text;
+}
+
+void Step_timer::finish() noexcept {
+    if (end_ == clock::time_point()) {
+        end_ = clock::now();
+    }
+}
+
+void Step_timer::print() const noexcept {
+    std::cout << "Post-processing timing:" << std::endl;
+
+    float total = 0.f;
+
+    for (size_t i = 0, len = marks_.size(); i < len; ++i) {
+        Mark const& m = marks_[i];
+
+        clock::time_point const end = i + 1 < len ? marks_[i + 1].start : end_;
+
+        float const seconds = chrono::duration_to_seconds(end - m.start);
+
+        total += seconds;
+
+        // Inactive steps neither log nor take time
+        if (m.name.empty() && seconds < 0.001f) {
+            continue;
+        }
+
+        std::string const name = m.name.empty() ? "(unnamed step)" : m.name;
+
+        std::cout << "  " << std::left << std::setw(32) << name << std::right << std::fixed
+                  << std::setprecision(3) << seconds << " s" << std::endl;
+    }
+
+    std::cout << "  " << std::left << std::setw(32) << "total" << std::right << std::fixed
+              << std::setprecision(3) << total << " s" << std::defaultfloat << std::endl;
+}
+
+Step_names::Step_names(Step_timer& timer) noexcept : timer_(timer) {}
+
+void Step_names::write(char const* message) noexcept {
+    timer_.log(message);
+}
+
+}  // namespace model
@@ -0,0 +1,60 @@
+#ifndef SU_CORE_MODEL_IMPORTER_TIMING_HPP
+#define SU_CORE_MODEL_IMPORTER_TIMING_HPP
+
+#include "assimp/LogStream.hpp"
+#include "assimp/ProgressHandler.hpp"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace model {
+
+// Times the file read and every post-processing step of one Assimp::Importer::ReadFile() call.
+// Assimp only reports step indices, so the steps are named after the "... begin" message they log.
+class Step_timer : public Assimp::ProgressHandler {
+  public:
+    using clock = std::chrono::high_resolution_clock;
+
+    bool Update(float percentage) noexcept override;
+
+    void UpdateFileRead(int current, int total) noexcept override;
+
+    void UpdatePostProcess(int current, int total) noexcept override;
+
+    // Names the running step from a debug message
+    void log(char const* message) noexcept;
+
+    // Ends the last step
+    void finish() noexcept;
+
+    void print() const noexcept;
+
+  private:
+    struct Mark {
+        std::string name;
+
+        clock::time_point start;
+
+        bool step;
+    };
+
+    std::vector<Mark> marks_;
+
+    clock::time_point end_;
+};
+
+// Feeds assimp's debug messages to a Step_timer
+class Step_names : public Assimp::LogStream {
+  public:
+    Step_names(Step_timer& timer) noexcept;
+
+    void write(char const* message) noexcept override;
+
+  private:
+    Step_timer& timer_;
+};
+
+}  // namespace model
+
+#endif
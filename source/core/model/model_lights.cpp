@@ -0,0 +1,228 @@
+#include "model_lights.hpp"
+#include "base/math/vector3.inl"
+#include "base/math/vector4.inl"
+#include "base/thread/thread_pool.hpp"
+#include "core/texture/image.hpp"
+#include "core/texture/path.hpp"
+#include "model.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace model {
+
+using texture::sRGB_to_linear;
+
+struct Emission {
+    texture::Image image;
+
+    float3 mean;
+};
+
+static inline float luminance(float3 const& c) noexcept {
+    return 0.2126f * c[0] + 0.7152f * c[1] + 0.0722f * c[2];
+}
+
+static inline float3 texel(texture::Image const& image, float2 uv) noexcept {
+    int32_t const width  = int32_t(image.width());
+    int32_t const height = int32_t(image.height());
+
+    // Repeating, with v = 0 at the top row like the importer's flipped coordinates
+    int32_t const x = int32_t(std::floor(uv[0] * float(width))) % width;
+    int32_t const y = int32_t(std::floor(uv[1] * float(height))) % height;
+
+    byte4 const p = image.at(x < 0 ? x + width : x, y < 0 ? y + height : y);
+
+    return float3(sRGB_to_linear.values[p[0]], sRGB_to_linear.values[p[1]],
+                  sRGB_to_linear.values[p[2]]);
+}
+
+static float3 image_mean(texture::Image const& image) noexcept {
+    float3 sum(0.f);
+
+    byte4 const* pixels = image.pixels();
+
+    for (uint32_t i = 0, len = image.width() * image.height(); i < len; ++i) {
+        sum += float3(sRGB_to_linear.values[pixels[i][0]], sRGB_to_linear.values[pixels[i][1]],
+                      sRGB_to_linear.values[pixels[i][2]]);
+    }
+
+    return sum / float(std::max(image.width() * image.height(), 1u));
+}
+
+// Mean of the texels at the centers of the n * n congruent sub-triangles of the uv triangle, with
+// n growing with the square root of its texel area
+static float3 triangle_mean(texture::Image const& image, float2 a, float2 b, float2 c) noexcept {
+    float2 const e1 = b - a;
+    float2 const e2 = c - a;
+
+    float const texels = 0.5f * std::abs(e1[0] * e2[1] - e1[1] * e2[0]) * float(image.width()) *
+                         float(image.height());
+
+    uint32_t const n = std::clamp(uint32_t(std::ceil(std::sqrt(texels))), 1u, 64u);
+
+    float const step = 1.f / float(n);
+
+    float3 sum(0.f);
+
+    for (uint32_t i = 0; i < n; ++i) {
+        for (uint32_t j = 0; i + j < n; ++j) {
+            float const u = (float(i) + 1.f / 3.f) * step;
+            float const v = (float(j) + 1.f / 3.f) * step;
+
+            sum += texel(image, a + u * e1 + v * e2);
+
+            if (i + j + 1 < n) {
+                float const iu = (float(i) + 2.f / 3.f) * step;
+                float const iv = (float(j) + 2.f / 3.f) * step;
+
+                sum += texel(image, a + iu * e1 + iv * e2);
+            }
+        }
+    }
+
+    return sum / float(n * n);
+}
+
+Lights gather_lights(Model const& model, std::string const& texture_directory,
+                     bool average_per_triangle, thread::Pool& threads) noexcept {
+    Lights lights;
+
+    Model::Material const* materials = model.materials();
+
+    uint32_t const num_materials = model.num_materials();
+
+    std::vector<Emission> emissions(num_materials);
+
+    std::atomic<uint32_t> current = 0;
+
+    threads.run_parallel([&](uint32_t /*id*/) noexcept {
+        for (;;) {
+            uint32_t const m = current.fetch_add(1, std::memory_order_relaxed);
+
+            if (m >= num_materials) {
+                return;
+            }
+
+            Model::Material const& material = materials[m];
+
+            Emission& e = emissions[m];
+
+            e.mean = material.emissive_color;
+
+            std::string const& path = material.emission_texture;
+
+            if (path.empty() || texture::is_embedded(path) ||
+                !texture::read(texture::resolve(texture_directory, path), e.image)) {
+                continue;
+            }
+
+            e.mean = image_mean(e.image);
+
+            if (!average_per_triangle) {
+                e.image = texture::Image();
+            }
+        }
+    });
+
+    Model::Part const* parts = model.parts();
+
+    uint32_t const num_parts = model.num_parts();
+
+    std::vector<uint32_t> part_offsets(num_parts + 1, 0);
+
+    for (uint32_t p = 0; p < num_parts; ++p) {
+        Model::Part const& part = parts[p];
+
+        float3 const mean = part.material_index < num_materials
+                                ? emissions[part.material_index].mean
+                                : float3(0.f);
+
+        part_offsets[p] = uint32_t(lights.triangles.size());
+
+        if (luminance(mean) <= 0.f) {
+            continue;
+        }
+
+        for (uint32_t i = part.start_index, len = i + part.num_indices; i + 3 <= len; i += 3) {
+            lights.triangles.push_back({i / 3, part.material_index, 0.f, 0.f,
+                                        packed_float3(mean), Lights::No_instance});
+        }
+    }
+
+    part_offsets[num_parts] = uint32_t(lights.triangles.size());
+
+    uint32_t const num_triangles = uint32_t(lights.triangles.size());
+
+    if (0 == num_triangles) {
+        return lights;
+    }
+
+    float3 const*   positions = model.positions();
+    float2 const*   uvs       = model.texture_coordinates();
+    uint32_t const* indices   = model.indices();
+
+    threads.run_range(
+        [&](uint32_t /*id*/, int32_t begin, int32_t end) noexcept {
+            for (int32_t i = begin; i < end; ++i) {
+                Lights::Triangle& t = lights.triangles[i];
+
+                uint32_t const* tri = indices + t.index * 3;
+
+                float3 const a = positions[tri[0]];
+
+                t.area = 0.5f * length(cross(positions[tri[1]] - a, positions[tri[2]] - a));
+
+                texture::Image const& image = emissions[t.material_index].image;
+
+                if (uvs && image.pixels()) {
+                    t.radiance = packed_float3(
+                        triangle_mean(image, uvs[tri[0]], uvs[tri[1]], uvs[tri[2]]));
+                }
+
+                t.power = Pi * t.area * luminance(float3(t.radiance));
+            }
+        },
+        0, int32_t(num_triangles));
+
+    // Instances emit again, rigid transformations keep the area
+    Model::Instance const* instances = model.instances();
+    for (uint32_t i = 0, len = model.num_instances(); i < len; ++i) {
+        uint32_t const p = instances[i].part;
+
+        for (uint32_t t = part_offsets[p], end = part_offsets[p + 1]; t < end; ++t) {
+            Lights::Triangle triangle = lights.triangles[t];
+
+            triangle.instance = i;
+
+            lights.triangles.push_back(triangle);
+        }
+    }
+
+    uint32_t const num_lights = uint32_t(lights.triangles.size());
+
+    lights.cdf.resize(num_lights + 1);
+
+    double total = 0.;
+
+    for (auto const& t : lights.triangles) {
+        total += double(t.power);
+    }
+
+    lights.total_power = float(total);
+
+    double sum = 0.;
+
+    for (uint32_t i = 0; i < num_lights; ++i) {
+        lights.cdf[i] = total > 0. ? float(sum / total) : float(i) / float(num_lights);
+
+        sum += double(lights.triangles[i].power);
+    }
+
+    lights.cdf[num_lights] = 1.f;
+
+    return lights;
+}
+
+}  // namespace model
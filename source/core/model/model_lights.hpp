@@ -0,0 +1,46 @@
+#ifndef SU_CORE_MODEL_MODEL_LIGHTS_HPP
+#define SU_CORE_MODEL_MODEL_LIGHTS_HPP
+
+#include "base/math/vector3.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace thread {
+class Pool;
+}
+
+namespace model {
+
+class Model;
+
+// Triangles with emissive materials, with what a renderer needs to sample them by power
+struct Lights {
+    static uint32_t constexpr No_instance = 0xFFFFFFFF;
+
+    struct Triangle {
+        uint32_t      index;  // Triangle in the index buffer
+        uint32_t      material_index;
+        float         area;
+        float         power;     // Luminance of the flux of a one-sided diffuse emitter
+        packed_float3 radiance;  // Mean over the triangle
+        uint32_t      instance;  // Instance placing the triangle, or No_instance
+    };
+
+    std::vector<Triangle> triangles;
+
+    // One more entry than triangles, rising from 0 to 1
+    std::vector<float> cdf;
+
+    float total_power = 0.f;
+};
+
+// Emission textures are read from texture_directory, and averaged either over every triangle or
+// over the whole texture. Materials without readable emission texture use their emissive color.
+Lights gather_lights(Model const& model, std::string const& texture_directory,
+                     bool average_per_triangle, thread::Pool& threads) noexcept;
+
+}  // namespace model
+
+#endif
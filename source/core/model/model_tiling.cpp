@@ -0,0 +1,435 @@
+#include "model_tiling.hpp"
+#include "base/math/aabb.inl"
+#include "base/math/vector4.inl"
+#include "base/memory/align.hpp"
+#include "base/sort/radix_sort.hpp"
+#include "base/thread/thread_pool.hpp"
+#include "model.hpp"
+#include "model_bounds.hpp"
+#include "rapidjson/ostreamwrapper.h"
+#include "rapidjson/prettywriter.h"
+
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+namespace model {
+
+static uint32_t constexpr No_part = 0xFFFFFFFF;
+
+// Keeps the cell keys of all three axes within 63 bits
+static uint32_t constexpr Max_cells_per_axis = 1 << 21;
+
+static inline float3 centroid(float3 const* positions, uint32_t const* tri) noexcept {
+    return (positions[tri[0]] + positions[tri[1]] + positions[tri[2]]) / 3.f;
+}
+
+Tiling tile(Model const& model, float size, thread::Pool& threads) noexcept {
+    Tiling tiling;
+
+    tiling.size = size;
+
+    uint32_t const num_triangles = model.num_indices() / 3;
+
+    if (!model.positions() || 0 == num_triangles || !(size > 0.f)) {
+        return tiling;
+    }
+
+    float3 const*   positions = model.positions();
+    uint32_t const* indices   = model.indices();
+
+    Model::Part const* parts = model.parts();
+
+    uint32_t const num_parts = model.num_parts();
+
+    // Triangles that don't belong to any part are never rendered and are left out
+    tiling.triangle_parts.assign(num_triangles, No_part);
+
+    uint32_t num_part_triangles = 0;
+
+    for (uint32_t p = 0; p < num_parts; ++p) {
+        uint32_t const begin = parts[p].start_index / 3;
+        uint32_t const end   = begin + parts[p].num_indices / 3;
+
+        for (uint32_t t = begin; t < end; ++t) {
+            tiling.triangle_parts[t] = p;
+        }
+
+        num_part_triangles += end - begin;
+    }
+
+    AABB const box = model.aabb();
+
+    float3 const origin = box.min();
+
+    if (float const max_extent = max_component(box.extent());
+        max_extent / size > float(Max_cells_per_axis - 1)) {
+        float const min_size = max_extent / float(Max_cells_per_axis - 1);
+
+        std::cout << "Tile size " << size << " gives more than " << Max_cells_per_axis
+                  << " tiles per axis, using " << min_size << " instead." << std::endl;
+
+        size = min_size;
+
+        tiling.size = size;
+    }
+
+    float3 const extent = box.extent() / size;
+
+    uint3 const dimensions(std::min(uint32_t(extent[0]) + 1, Max_cells_per_axis),
+                           std::min(uint32_t(extent[1]) + 1, Max_cells_per_axis),
+                           std::min(uint32_t(extent[2]) + 1, Max_cells_per_axis));
+
+    auto const cell_of = [origin, size, dimensions](float3 const& p) noexcept {
+        uint3 c;
+
+        for (uint32_t i = 0; i < 3; ++i) {
+            float const f = std::floor((p[i] - origin[i]) / size);
+
+            c[i] = std::min(uint32_t(std::max(f, 0.f)), dimensions[i] - 1);
+        }
+
+        return uint64_t(c[0]) + uint64_t(dimensions[0]) * (c[1] + uint64_t(dimensions[1]) * c[2]);
+    };
+
+    // Instanced parts go to the cell of their mean triangle centroid
+    std::vector<uint64_t> part_cells(num_parts, ~0ull);
+
+    Model::Instance const* instances = model.instances();
+    for (uint32_t i = 0, len = model.num_instances(); i < len; ++i) {
+        uint32_t const p = instances[i].part;
+
+        if (~0ull != part_cells[p] || parts[p].num_indices < 3) {
+            continue;
+        }
+
+        float3 center(0.f);
+
+        uint32_t const begin = parts[p].start_index / 3;
+        uint32_t const end   = begin + parts[p].num_indices / 3;
+
+        for (uint32_t t = begin; t < end; ++t) {
+            center += centroid(positions, indices + t * 3);
+        }
+
+        part_cells[p] = cell_of(center / float(end - begin));
+    }
+
+    memory::Buffer<uint64_t> keys(num_part_triangles);
+
+    tiling.triangles.resize(num_part_triangles);
+
+    // In part order, so that the stable sort keeps the triangles of a part together
+    for (uint32_t p = 0, current = 0; p < num_parts; ++p) {
+        uint32_t const begin = parts[p].start_index / 3;
+        uint32_t const end   = begin + parts[p].num_indices / 3;
+
+        for (uint32_t t = begin; t < end; ++t, ++current) {
+            tiling.triangles[current] = t;
+        }
+    }
+
+    threads.run_range(
+        [&](uint32_t /*id*/, int32_t begin, int32_t end) noexcept {
+            for (int32_t i = begin; i < end; ++i) {
+                uint32_t const t = tiling.triangles[i];
+                uint32_t const p = tiling.triangle_parts[t];
+
+                keys[i] = ~0ull != part_cells[p] ? part_cells[p]
+                                                  : cell_of(centroid(positions, indices + t * 3));
+            }
+        },
+        0, int32_t(num_part_triangles));
+
+    uint64_t const num_cells = uint64_t(dimensions[0]) * dimensions[1] * dimensions[2];
+
+    uint32_t num_key_bits = 1;
+
+    while (num_key_bits < 64 && (num_cells - 1) >> num_key_bits) {
+        ++num_key_bits;
+    }
+
+    sort::radix_sort(keys.data(), tiling.triangles.data(), num_part_triangles, num_key_bits,
+                     threads);
+
+    for (uint32_t i = 0; i < num_part_triangles;) {
+        uint64_t const key = keys[i];
+
+        uint32_t end = i + 1;
+
+        for (; end < num_part_triangles && key == keys[end]; ++end) {
+        }
+
+        int3 const cell(int32_t(key % dimensions[0]), int32_t(key / dimensions[0] % dimensions[1]),
+                        int32_t(key / dimensions[0] / dimensions[1]));
+
+        tiling.tiles.push_back({cell, i, end});
+
+        i = end;
+    }
+
+    return tiling;
+}
+
+Model* extract_tile(Model const& model, Tiling const& tiling, uint32_t tile) noexcept {
+    Tiling::Tile const& t = tiling.tiles[tile];
+
+    uint32_t const num_triangles = t.triangles_end - t.triangles_begin;
+
+    uint32_t const* triangles = tiling.triangles.data() + t.triangles_begin;
+
+    Model::Part const* parts = model.parts();
+
+    // Runs of the same part become the parts of the tile
+    std::vector<Model::Part>               tile_parts;
+    std::unordered_map<uint32_t, uint32_t> part_ids;
+
+    for (uint32_t i = 0; i < num_triangles; ++i) {
+        uint32_t const p = tiling.triangle_parts[triangles[i]];
+
+        if (0 == i || p != tiling.triangle_parts[triangles[i - 1]]) {
+            part_ids.emplace(p, uint32_t(tile_parts.size()));
+            tile_parts.push_back({i * 3, 0, parts[p].material_index});
+        }
+
+        tile_parts.back().num_indices += 3;
+    }
+
+    // Vertices in the order of their first use
+    uint32_t const* indices = model.indices();
+
+    std::unordered_map<uint32_t, uint32_t> vertex_ids;
+    vertex_ids.reserve(num_triangles * 2);
+
+    std::vector<uint32_t> sources;
+    sources.reserve(num_triangles * 2);
+
+    Model* result = new Model;
+
+    result->allocate_indices(num_triangles * 3);
+
+    for (uint32_t i = 0; i < num_triangles; ++i) {
+        uint32_t const* tri = indices + triangles[i] * 3;
+
+        for (uint32_t j = 0; j < 3; ++j) {
+            auto const v = vertex_ids.try_emplace(tri[j], uint32_t(sources.size()));
+
+            if (v.second) {
+                sources.push_back(tri[j]);
+            }
+
+            result->set_index(i * 3 + j, v.first->second);
+        }
+    }
+
+    uint32_t const num_vertices = uint32_t(sources.size());
+
+    result->set_num_vertices(num_vertices);
+
+    result->allocate_positions();
+
+    for (uint32_t v = 0; v < num_vertices; ++v) {
+        result->set_position(v, model.positions()[sources[v]]);
+    }
+
+    if (model.normals()) {
+        result->allocate_normals();
+
+        for (uint32_t v = 0; v < num_vertices; ++v) {
+            result->set_normal(v, model.normals()[sources[v]]);
+        }
+    }
+
+    if (model.tangents()) {
+        result->allocate_tangents();
+
+        for (uint32_t v = 0; v < num_vertices; ++v) {
+            result->tangents()[v] = model.tangents()[sources[v]];
+        }
+    }
+
+    if (model.texture_coordinates()) {
+        result->allocate_texture_coordinates();
+
+        for (uint32_t v = 0; v < num_vertices; ++v) {
+            result->set_texture_coordinate(v, model.texture_coordinates()[sources[v]]);
+        }
+    }
+
+    result->allocate_parts(uint32_t(tile_parts.size()));
+
+    for (uint32_t p = 0, len = uint32_t(tile_parts.size()); p < len; ++p) {
+        result->set_part(p, tile_parts[p]);
+    }
+
+    if (uint32_t const num_materials = model.num_materials(); num_materials > 0) {
+        result->allocate_materials(num_materials);
+
+        std::copy(model.materials(), model.materials() + num_materials, result->materials());
+    }
+
+    // Instances of parts that ended up in this tile
+    std::vector<Model::Instance> instances;
+
+    for (uint32_t i = 0, len = model.num_instances(); i < len; ++i) {
+        Model::Instance const& instance = model.instances()[i];
+
+        if (auto const p = part_ids.find(instance.part); part_ids.end() != p) {
+            instances.push_back({p->second, instance.transformation});
+        }
+    }
+
+    if (!instances.empty()) {
+        result->allocate_instances(uint32_t(instances.size()));
+
+        for (uint32_t i = 0, len = uint32_t(instances.size()); i < len; ++i) {
+            result->set_instance(i, instances[i]);
+        }
+    }
+
+    return result;
+}
+
+std::vector<std::string> write_tiles(std::string const& name, Model const& model,
+                                     Tiling const& tiling, Exporter_sub::Settings const& settings,
+                                     thread::Pool& threads) noexcept {
+    uint32_t const num_tiles = uint32_t(tiling.tiles.size());
+
+    std::vector<std::string> files(num_tiles);
+
+    std::vector<AABB> boxes(num_tiles);
+
+    std::string const filename = name.substr(name.find_last_of("/\\") + 1);
+
+    for (uint32_t t = 0; t < num_tiles; ++t) {
+        int3 const& c = tiling.tiles[t].cell;
+
+        files[t] = filename + "_" + std::to_string(c[0]) + "_" + std::to_string(c[1]) + "_" +
+                   std::to_string(c[2]) + ".sub";
+    }
+
+    std::string const directory = name.substr(0, name.size() - filename.size());
+
+    Exporter_sub const exporter(settings);
+
+    // Not std::vector<bool>, the tiles are written concurrently
+    std::vector<uint8_t> written(num_tiles, 0);
+
+    std::atomic<uint32_t> current = 0;
+
+    // One tile per thread, the exporter gets a pool of its own because pools don't nest
+    threads.run_parallel([&](uint32_t /*id*/) noexcept {
+        thread::Pool local(1);
+
+        for (;;) {
+            uint32_t const t = current.fetch_add(1, std::memory_order_relaxed);
+
+            if (t >= num_tiles) {
+                return;
+            }
+
+            Model* tile = extract_tile(model, tiling, t);
+
+            tile->localize_parts(0x10000);
+
+            std::vector<Part_bounds> bounds(tile->num_parts());
+
+            compute_part_bounds(*tile, bounds.data(), local);
+
+            boxes[t] = instanced_aabb(*tile, bounds.data());
+
+            std::string const& file = files[t];
+
+            written[t] = exporter.write(directory + file.substr(0, file.size() - 4), *tile,
+                                        local);
+
+            delete tile;
+        }
+    });
+
+    // Failed tiles are left out of the index and of the returned files
+    std::vector<uint32_t> tiles;
+    tiles.reserve(num_tiles);
+
+    for (uint32_t t = 0; t < num_tiles; ++t) {
+        if (written[t]) {
+            tiles.push_back(t);
+        } else {
+            std::cout << "Could not write tile " << directory << files[t] << std::endl;
+        }
+    }
+
+    std::vector<std::string> written_files;
+    written_files.reserve(tiles.size());
+
+    for (uint32_t const t : tiles) {
+        written_files.push_back(files[t]);
+    }
+
+    std::ofstream stream(name + ".tiles");
+
+    if (!stream) {
+        std::cout << "Could not write " << name << ".tiles" << std::endl;
+        return written_files;
+    }
+
+    rapidjson::OStreamWrapper json_stream(stream);
+
+    rapidjson::PrettyWriter<rapidjson::OStreamWrapper> writer(json_stream);
+
+    writer.SetFormatOptions(rapidjson::kFormatSingleLineArray);
+    writer.SetMaxDecimalPlaces(5);
+
+    writer.StartObject();
+
+    writer.Key("tile_size");
+    writer.Double(tiling.size);
+
+    writer.Key("tiles");
+    writer.StartArray();
+
+    for (uint32_t const t : tiles) {
+        Tiling::Tile const& tile = tiling.tiles[t];
+
+        writer.StartObject();
+
+        writer.Key("file");
+        writer.String(files[t].c_str());
+
+        writer.Key("cell");
+        writer.StartArray();
+        writer.Int(tile.cell[0]);
+        writer.Int(tile.cell[1]);
+        writer.Int(tile.cell[2]);
+        writer.EndArray();
+
+        writer.Key("num_triangles");
+        writer.Uint(tile.triangles_end - tile.triangles_begin);
+
+        writer.Key("aabb");
+        writer.StartObject();
+
+        for (uint32_t i = 0; i < 2; ++i) {
+            writer.Key(0 == i ? "min" : "max");
+            writer.StartArray();
+            writer.Double(boxes[t].bounds[i][0]);
+            writer.Double(boxes[t].bounds[i][1]);
+            writer.Double(boxes[t].bounds[i][2]);
+            writer.EndArray();
+        }
+
+        writer.EndObject();
+
+        writer.EndObject();
+    }
+
+    writer.EndArray();
+
+    writer.EndObject();
+
+    return written_files;
+}
+
+}  // namespace model
@@ -0,0 +1,57 @@
+#ifndef SU_CORE_MODEL_MODEL_TILING_HPP
+#define SU_CORE_MODEL_MODEL_TILING_HPP
+
+#include "base/math/vector3.hpp"
+#include "model_exporter_sub.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace thread {
+class Pool;
+}
+
+namespace model {
+
+class Model;
+
+// Triangles of a model partitioned into a uniform grid of cubes. Every triangle belongs to the
+// cell of its centroid, so nothing is clipped and tiles may overlap slightly. Parts referenced by
+// instances move as a whole, to the cell of their mean triangle centroid, and take their instances
+// with them.
+struct Tiling {
+    struct Tile {
+        int3 cell;
+
+        uint32_t triangles_begin;
+        uint32_t triangles_end;
+    };
+
+    // Requested size, raised if it would give more than 2^21 tiles per axis
+    float size;
+
+    std::vector<Tile> tiles;
+
+    // Triangle ids ordered by tile, then by part, then by their order in the model
+    std::vector<uint32_t> triangles;
+
+    // Part of every triangle
+    std::vector<uint32_t> triangle_parts;
+};
+
+Tiling tile(Model const& model, float size, thread::Pool& threads) noexcept;
+
+// New model with the triangles, vertices and instances of one tile, and all materials
+Model* extract_tile(Model const& model, Tiling const& tiling, uint32_t tile) noexcept;
+
+// Writes the tiles in parallel as name_x_y_z.sub, and name.tiles with the file, cell and bounds of
+// every tile. Returns the file names of the tiles that were written, failed ones are reported
+// and left out of name.tiles.
+std::vector<std::string> write_tiles(std::string const& name, Model const& model,
+                                     Tiling const& tiling, Exporter_sub::Settings const& settings,
+                                     thread::Pool& threads) noexcept;
+
+}  // namespace model
+
+#endif
@@ -1,39 +1,51 @@
 #include "triangle_json_handler.hpp"
+#include "base/encoding/base64.hpp"
 #include "base/math/quaternion.inl"
 #include "base/math/vector3.inl"
+#include "base/math/vector4.inl"
+#include "model.hpp"
+
+#include <algorithm>
+#include <cstring>
 
 namespace model {
 
-Json_handler::Json_handler() {
+Json_handler::Json_handler(Model& model, Sizes const& sizes) : model_(model), sizes_(sizes) {
     clear();
 }
 
 void Json_handler::clear(bool read_indices) {
-    read_indices_ = read_indices;
-    object_level_ = 0;
-    top_object_   = Object::Undefined;
+    missing_sizes_ = false;
+    read_indices_  = read_indices;
+    object_level_  = 0;
+    top_object_    = Object::Undefined;
 
-    vertices_.clear();
-    triangles_.clear();
+    instances_.clear();
     parts_.clear();
 
     expected_number_ = Number::Undefined;
     expected_string_ = String_type::Undefined;
     expected_object_ = Object::Undefined;
 
-    current_vertex_           = 0;
-    current_vertex_element_   = 0;
-    current_triangle_         = 0;
-    current_triangle_element_ = 0;
+    current_index_          = 0;
+    current_vertex_         = 0;
+    current_vertex_element_ = 0;
+
+    guessed_num_indices_ = false;
+    num_view_indices_    = 0;
 
     has_positions_           = false;
     has_normals_             = false;
     has_tangents_            = false;
     has_texture_coordinates_ = false;
-}
 
-void Json_handler::create_part() {
-    parts_.emplace_back(Part{0, 0, 3 * uint32_t(triangles_.size())});
+    num_positions_read_           = 0;
+    num_normals_read_             = 0;
+    num_tangents_read_            = 0;
+    num_texture_coordinates_read_ = 0;
+
+    buffer_file_.clear();
+    buffer_views_.clear();
 }
 
 bool Json_handler::Null() {
@@ -61,6 +73,20 @@ bool Json_handler::Uint(unsigned i) {
         case Number::Num_indices:
             parts_.back().num_indices = i;
             break;
+        case Number::Num_vertices:
+            if (0 == sizes_.num_vertices) {
+                sizes_.num_vertices = i;
+            }
+            break;
+        case Number::Instance_part:
+            instances_.back().part = i;
+            break;
+        case Number::Buffer_view_offset:
+            current_view_.offset = i;
+            break;
+        case Number::Buffer_view_size:
+            current_view_.size = i;
+            break;
         case Number::Index:
             add_index(i);
             break;
@@ -78,7 +104,13 @@ bool Json_handler::Int64(int64_t /*i*/) {
     return true;
 }
 
-bool Json_handler::Uint64(uint64_t /*i*/) {
+bool Json_handler::Uint64(uint64_t i) {
+    if (Number::Buffer_view_offset == expected_number_) {
+        current_view_.offset = i;
+    } else if (Number::Buffer_view_size == expected_number_) {
+        current_view_.size = i;
+    }
+
     return true;
 }
 
@@ -92,9 +124,34 @@ bool Json_handler::RawNumber(char const* /*str*/, rapidjson::SizeType /*length*/
     return true;
 }
 
-bool Json_handler::String(char const* str, rapidjson::SizeType /*length*/, bool /*copy*/) {
-    if (String_type::Morph_target == expected_string_) {
-        morph_targets_.emplace_back(str);
+bool Json_handler::String(char const* str, rapidjson::SizeType length, bool /*copy*/) {
+    switch (expected_string_) {
+        case String_type::Morph_target:
+            morph_targets_.emplace_back(str);
+            break;
+        case String_type::Buffer_file:
+            buffer_file_     = std::string(str, length);
+            expected_string_ = String_type::Undefined;
+            break;
+        case String_type::Buffer_view_encoding:
+            current_view_.encoding = std::string(str, length);
+            expected_string_       = String_type::Undefined;
+            break;
+        case String_type::Buffer_view_base64: {
+            current_view_data_.resize(encoding::base64::decoded_size(length));
+
+            uint64_t const size = encoding::base64::decode(str, length, current_view_data_.data());
+
+            expected_string_ = String_type::Undefined;
+
+            if (0 == size && length > 0) {
+                return false;
+            }
+
+            current_view_data_.resize(size);
+        } break;
+        default:
+            break;
     }
 
     return true;
@@ -103,10 +160,29 @@ bool Json_handler::String(char const* str, rapidjson::SizeType /*length*/, bool
 bool Json_handler::StartObject() {
     ++object_level_;
 
+    switch (expected_number_) {
+        case Number::Position:
+        case Number::Texture_coordinate_0:
+        case Number::Normal:
+        case Number::Tangent:
+        case Number::Tangent_space:
+        case Number::Index:
+            expected_object_ = Object::Buffer_view;
+            current_view_    = {expected_number_, "", 0, ~uint64_t(0)};
+
+            current_view_data_.clear();
+            return true;
+        default:
+            break;
+    }
+
     switch (expected_object_) {
         case Object::Part:
             parts_.emplace_back(Part());
             break;
+        case Object::Instance:
+            instances_.push_back({0, float3(0.f), quaternion::identity()});
+            break;
         default:
             break;
     }
@@ -117,6 +193,22 @@ bool Json_handler::StartObject() {
 bool Json_handler::Key(char const* str, rapidjson::SizeType /*length*/, bool /*copy*/) {
     std::string_view const name(str);
 
+    if (Object::Buffer_view == expected_object_) {
+        expected_number_ = Number::Ignore;
+
+        if ("encoding" == name) {
+            expected_string_ = String_type::Buffer_view_encoding;
+        } else if ("base64" == name) {
+            expected_string_ = String_type::Buffer_view_base64;
+        } else if ("offset" == name) {
+            expected_number_ = Number::Buffer_view_offset;
+        } else if ("size" == name) {
+            expected_number_ = Number::Buffer_view_size;
+        }
+
+        return true;
+    }
+
     if (1 == object_level_) {
         if ("geometry" == name) {
             top_object_ = Object::Geometry;
@@ -133,16 +225,27 @@ bool Json_handler::Key(char const* str, rapidjson::SizeType /*length*/, bool /*c
     if (Object::Geometry == top_object_) {
         if ("parts" == name) {
             expected_object_ = Object::Part;
+        } else if ("instances" == name) {
+            expected_object_ = Object::Instance;
+        } else if ("part" == name && Object::Instance == expected_object_) {
+            expected_number_ = Number::Instance_part;
+        } else if ("transformation" == name && Object::Instance == expected_object_) {
+            expected_object_ = Object::Transformation;
+        } else if ("position" == name && Object::Transformation == expected_object_) {
+            expected_number_        = Number::Instance_position;
+            current_vertex_element_ = 0;
+        } else if ("rotation" == name && Object::Transformation == expected_object_) {
+            expected_number_        = Number::Instance_rotation;
+            current_vertex_element_ = 0;
+        } else if ("buffer" == name) {
+            expected_object_ = Object::Buffer;
+        } else if ("file" == name && Object::Buffer == expected_object_) {
+            expected_string_ = String_type::Buffer_file;
+        } else if (Object::Buffer == expected_object_) {
+            expected_number_ = Number::Ignore;
         } else if ("vertices" == name) {
             top_object_      = Object::Vertices;
             expected_object_ = Object::Undefined;
-
-            if (!parts_.empty()) {
-                auto& p = parts_.back();
-
-                uint32_t const num_triangles = (p.start_index + p.num_indices) / 3;
-                vertices_.reserve(size_t(0.7f * float(num_triangles)));
-            }
         } else if ("material_index" == name && Object::Part == expected_object_) {
             expected_number_ = Number::Material_index;
         } else if ("start_index" == name && Object::Part == expected_object_) {
@@ -153,12 +256,7 @@ bool Json_handler::Key(char const* str, rapidjson::SizeType /*length*/, bool /*c
             if (read_indices_) {
                 expected_number_ = Number::Index;
 
-                if (!parts_.empty()) {
-                    auto& p = parts_.back();
-
-                    uint32_t const num_triangles = (p.start_index + p.num_indices) / 3;
-                    triangles_.reserve(num_triangles);
-                }
+                return prepare_indices();
             } else {
                 expected_number_ = Number::Ignore;
             }
@@ -168,35 +266,36 @@ bool Json_handler::Key(char const* str, rapidjson::SizeType /*length*/, bool /*c
     }
 
     if (Object::Vertices == top_object_) {
+        if ("num_vertices" == name) {
+            expected_number_ = Number::Num_vertices;
+            return true;
+        }
+
+        current_vertex_         = 0;
+        current_vertex_element_ = 0;
+
         if ("positions" == name) {
-            expected_number_        = Number::Position;
-            current_vertex_         = 0;
-            current_vertex_element_ = 0;
-            has_positions_          = true;
+            expected_number_ = Number::Position;
+            has_positions_   = true;
         } else if ("texture_coordinates_0" == name) {
             expected_number_         = Number::Texture_coordinate_0;
-            current_vertex_          = 0;
-            current_vertex_element_  = 0;
             has_texture_coordinates_ = true;
         } else if ("normals" == name) {
-            expected_number_        = Number::Normal;
-            current_vertex_         = 0;
-            current_vertex_element_ = 0;
-            has_normals_            = true;
+            expected_number_ = Number::Normal;
+            has_normals_     = true;
         } else if ("tangents_and_bitangent_signs" == name) {
-            expected_number_        = Number::Tangent;
-            current_vertex_         = 0;
-            current_vertex_element_ = 0;
-            has_tangents_           = true;
+            expected_number_ = Number::Tangent;
+            has_tangents_    = true;
         } else if ("tangent_space" == name) {
-            expected_number_        = Number::Tangent_space;
-            current_vertex_         = 0;
-            current_vertex_element_ = 0;
-            has_normals_            = true;
-            has_tangents_           = true;
+            expected_number_ = Number::Tangent_space;
+            has_normals_     = true;
+            has_tangents_    = true;
+        } else {
+            expected_number_ = Number::Ignore;
+            return true;
         }
 
-        return true;
+        return prepare_vertices();
     }
 
     expected_object_ = Object::Undefined;
@@ -205,11 +304,28 @@ bool Json_handler::Key(char const* str, rapidjson::SizeType /*length*/, bool /*c
 }
 
 bool Json_handler::EndObject(size_t /*memberCount*/) {
+    --object_level_;
+
+    if (Object::Buffer_view == expected_object_) {
+        expected_object_ = Object::Undefined;
+        expected_number_ = Number::Undefined;
+
+        return end_buffer_view();
+    }
+
+    if (Object::Buffer == expected_object_) {
+        expected_object_ = Object::Undefined;
+        return true;
+    }
+
     if (Object::Vertices == top_object_) {
         top_object_ = Object::Geometry;
     }
 
-    --object_level_;
+    if (Object::Transformation == expected_object_) {
+        expected_object_ = Object::Instance;
+    }
+
     return true;
 }
 
@@ -218,9 +334,18 @@ bool Json_handler::StartArray() {
 }
 
 bool Json_handler::EndArray(size_t /*elementCount*/) {
+    end_vertex_array();
+
+    // Otherwise a following object could be mistaken for a buffer view
+    expected_number_ = Number::Undefined;
+
     return true;
 }
 
+bool Json_handler::missing_sizes() const {
+    return missing_sizes_;
+}
+
 bool Json_handler::has_positions() const {
     return has_positions_;
 }
@@ -245,42 +370,129 @@ std::vector<Part>& Json_handler::parts() {
     return parts_;
 }
 
-std::vector<Index_triangle> const& Json_handler::triangles() const {
-    return triangles_;
+std::vector<Instance> const& Json_handler::instances() const {
+    return instances_;
 }
 
-std::vector<Index_triangle>& Json_handler::triangles() {
-    return triangles_;
+uint32_t Json_handler::num_indices_read() const {
+    return current_index_;
 }
 
-const std::vector<Vertex>& Json_handler::vertices() const {
-    return vertices_;
+bool Json_handler::complete() const {
+    uint32_t const num_vertices = model_.num_vertices();
+
+    return (!has_positions_ || num_vertices == num_positions_read_) &&
+           (!has_normals_ || num_vertices == num_normals_read_) &&
+           (!has_tangents_ || num_vertices == num_tangents_read_) &&
+           (!has_texture_coordinates_ || num_vertices == num_texture_coordinates_read_) &&
+           model_.num_indices() == current_index_;
 }
 
-std::vector<Vertex>& Json_handler::vertices() {
-    return vertices_;
+bool Json_handler::guessed_num_indices() const {
+    return guessed_num_indices_;
+}
+
+uint32_t Json_handler::num_indices_found() const {
+    return std::max(current_index_, num_view_indices_);
 }
 
 const std::vector<std::string>& Json_handler::morph_targets() const {
     return morph_targets_;
 }
 
-void Json_handler::add_index(uint32_t i) {
-    if (current_triangle_ == triangles_.size()) {
-        triangles_.emplace_back();
+std::string const& Json_handler::buffer_file() const {
+    return buffer_file_;
+}
+
+bool Json_handler::read_buffer(uint8_t const* data, uint64_t size) {
+    for (auto const& v : buffer_views_) {
+        if (v.offset > size || v.size > size - v.offset) {
+            return false;
+        }
+
+        if (!read_buffer_view(v, data + v.offset, v.size)) {
+            return false;
+        }
     }
 
-    triangles_[current_triangle_].i[current_triangle_element_] = i;
+    return true;
+}
 
-    increment_triangle_element();
+bool Json_handler::prepare_vertices() {
+    if (0 == model_.num_vertices()) {
+        if (0 == sizes_.num_vertices) {
+            missing_sizes_ = true;
+            return false;
+        }
+
+        model_.set_num_vertices(sizes_.num_vertices);
+    }
+
+    switch (expected_number_) {
+        case Number::Position:
+            if (!model_.positions()) {
+                model_.allocate_positions();
+            }
+            break;
+        case Number::Texture_coordinate_0:
+            if (!model_.texture_coordinates()) {
+                model_.allocate_texture_coordinates();
+            }
+            break;
+        case Number::Tangent_space:
+            if (!model_.tangents()) {
+                model_.allocate_tangents();
+            }
+            [[fallthrough]];
+        case Number::Normal:
+            if (!model_.normals()) {
+                model_.allocate_normals();
+            }
+            break;
+        case Number::Tangent:
+            if (!model_.tangents()) {
+                model_.allocate_tangents();
+            }
+            break;
+        default:
+            break;
+    }
+
+    return true;
 }
 
-void Json_handler::increment_triangle_element() {
-    ++current_triangle_element_;
-    if (current_triangle_element_ >= 3) {
-        current_triangle_element_ = 0;
-        ++current_triangle_;
+bool Json_handler::prepare_indices() {
+    if (model_.indices()) {
+        return true;
     }
+
+    if (0 == sizes_.num_indices) {
+        for (auto const& p : parts_) {
+            sizes_.num_indices = std::max(sizes_.num_indices, p.start_index + p.num_indices);
+        }
+
+        if (0 == sizes_.num_indices) {
+            missing_sizes_ = true;
+            return false;
+        }
+
+        guessed_num_indices_ = true;
+    }
+
+    model_.allocate_indices(sizes_.num_indices);
+
+    current_index_ = 0;
+
+    return true;
+}
+
+void Json_handler::add_index(uint32_t i) {
+    if (current_index_ < model_.num_indices()) {
+        model_.indices()[current_index_] = i;
+    }
+
+    // Surplus indices are counted as well, so that complete() rejects them
+    ++current_index_;
 }
 
 void Json_handler::handle_vertex(float v) {
@@ -300,57 +512,49 @@ void Json_handler::handle_vertex(float v) {
         case Number::Texture_coordinate_0:
             add_texture_coordinate(v);
             break;
+        case Number::Instance_position:
+            add_instance_position(v);
+            break;
+        case Number::Instance_rotation:
+            add_instance_rotation(v);
+            break;
         default:
             break;
     }
 }
 
 void Json_handler::add_position(float v) {
-    if (vertices_.size() == current_vertex_) {
-        vertices_.emplace_back();
+    if (current_vertex_ < model_.num_vertices()) {
+        model_.positions()[current_vertex_][current_vertex_element_] = v;
     }
 
-    vertices_[current_vertex_].p.v[current_vertex_element_] = v;
-
     increment_vertex_element(3);
 }
 
 void Json_handler::add_normal(float v) {
-    if (vertices_.size() == current_vertex_) {
-        vertices_.emplace_back();
+    if (current_vertex_ < model_.num_vertices()) {
+        model_.normals()[current_vertex_][current_vertex_element_] = v;
     }
 
-    vertices_[current_vertex_].n.v[current_vertex_element_] = v;
-
     increment_vertex_element(3);
 }
 
 void Json_handler::add_tangent(float v) {
-    if (vertices_.size() == current_vertex_) {
-        vertices_.emplace_back();
-    }
-
-    if (current_vertex_element_ < 3) {
-        vertices_[current_vertex_].t.v[current_vertex_element_] = v;
-    } else if (current_vertex_element_ == 3) {
-        vertices_[current_vertex_].bitangent_sign = v > 0.f ? 0 : 1;
-
-        vertices_[current_vertex_].pad[0] = 0;
-        vertices_[current_vertex_].pad[1] = 0;
-        vertices_[current_vertex_].pad[2] = 0;
+    if (current_vertex_ < model_.num_vertices()) {
+        if (current_vertex_element_ < 3) {
+            model_.tangents()[current_vertex_][current_vertex_element_] = v;
+        } else {
+            model_.tangents()[current_vertex_][3] = v > 0.f ? 1.f : -1.f;
+        }
     }
 
     increment_vertex_element(4);
 }
 
 void Json_handler::add_tangent_space(float v) {
-    if (vertices_.size() == current_vertex_) {
-        vertices_.emplace_back();
-    }
-
     ts_[current_vertex_element_] = v;
 
-    if (current_vertex_element_ == 3) {
+    if (current_vertex_element_ == 3 && current_vertex_ < model_.num_vertices()) {
         Quaternion ts = ts_;
 
         bool bts = false;
@@ -362,29 +566,33 @@ void Json_handler::add_tangent_space(float v) {
 
         float3x3 const tbn = quaternion::create_matrix3x3(ts);
 
-        vertices_[current_vertex_].n = packed_float3(tbn.r[2]);
-        vertices_[current_vertex_].t = packed_float3(tbn.r[0]);
-
-        vertices_[current_vertex_].bitangent_sign = bts ? 1 : 0;
-
-        vertices_[current_vertex_].pad[0] = 0;
-        vertices_[current_vertex_].pad[1] = 0;
-        vertices_[current_vertex_].pad[2] = 0;
+        model_.normals()[current_vertex_]  = tbn.r[2];
+        model_.tangents()[current_vertex_] = float4(tbn.r[0], bts ? -1.f : 1.f);
     }
 
     increment_vertex_element(4);
 }
 
 void Json_handler::add_texture_coordinate(float v) {
-    if (vertices_.size() == current_vertex_) {
-        vertices_.emplace_back();
+    if (current_vertex_ < model_.num_vertices()) {
+        model_.texture_coordinates()[current_vertex_][current_vertex_element_] = v;
     }
 
-    vertices_[current_vertex_].uv.v[current_vertex_element_] = v;
-
     increment_vertex_element(2);
 }
 
+void Json_handler::add_instance_position(float v) {
+    if (current_vertex_element_ < 3) {
+        instances_.back().position[current_vertex_element_++] = v;
+    }
+}
+
+void Json_handler::add_instance_rotation(float v) {
+    if (current_vertex_element_ < 4) {
+        instances_.back().rotation[current_vertex_element_++] = v;
+    }
+}
+
 void Json_handler::increment_vertex_element(uint32_t num_elements) {
     ++current_vertex_element_;
     if (current_vertex_element_ >= num_elements) {
@@ -393,4 +601,153 @@ void Json_handler::increment_vertex_element(uint32_t num_elements) {
     }
 }
 
+void Json_handler::end_vertex_array() {
+    // A partial last vertex doesn't count
+    uint32_t const num_read = current_vertex_;
+
+    switch (expected_number_) {
+        case Number::Position:
+            num_positions_read_ = num_read;
+            break;
+        case Number::Normal:
+            num_normals_read_ = num_read;
+            break;
+        case Number::Tangent:
+            num_tangents_read_ = num_read;
+            break;
+        case Number::Tangent_space:
+            num_normals_read_  = num_read;
+            num_tangents_read_ = num_read;
+            break;
+        case Number::Texture_coordinate_0:
+            num_texture_coordinates_read_ = num_read;
+            break;
+        default:
+            break;
+    }
+}
+
+bool Json_handler::end_buffer_view() {
+    if (String_type::Buffer_view_base64 == expected_string_) {
+        return false;
+    }
+
+    if (~uint64_t(0) == current_view_.size) {
+        // Inline
+        return read_buffer_view(current_view_, current_view_data_.data(),
+                                current_view_data_.size());
+    }
+
+    if (Number::Index == current_view_.target) {
+        num_view_indices_ = uint32_t(current_view_.size / 4);
+    }
+
+    buffer_views_.push_back(current_view_);
+
+    return true;
+}
+
+template <typename T>
+static void copy_elements(T* dest, uint8_t const* source, uint32_t count,
+                          uint32_t num_components) {
+    uint32_t const element_size = num_components * sizeof(float);
+
+    for (uint32_t i = 0; i < count; ++i, source += element_size) {
+        std::memcpy(&dest[i], source, element_size);
+    }
+}
+
+bool Json_handler::read_buffer_view(Buffer_view const& view, uint8_t const* data,
+                                    uint64_t size) {
+    uint64_t const num_vertices = model_.num_vertices();
+
+    switch (view.target) {
+        case Number::Position:
+            if ("Float32x3" != view.encoding || num_vertices * 12 != size) {
+                return false;
+            }
+
+            copy_elements(model_.positions(), data, uint32_t(num_vertices), 3);
+
+            num_positions_read_ = uint32_t(num_vertices);
+            return true;
+        case Number::Normal:
+            if ("Float32x3" != view.encoding || num_vertices * 12 != size) {
+                return false;
+            }
+
+            copy_elements(model_.normals(), data, uint32_t(num_vertices), 3);
+
+            num_normals_read_ = uint32_t(num_vertices);
+            return true;
+        case Number::Tangent:
+            if ("Float32x4" != view.encoding || num_vertices * 16 != size) {
+                return false;
+            }
+
+            copy_elements(model_.tangents(), data, uint32_t(num_vertices), 4);
+
+            num_tangents_read_ = uint32_t(num_vertices);
+            return true;
+        case Number::Texture_coordinate_0:
+            if ("Float32x2" != view.encoding || num_vertices * 8 != size) {
+                return false;
+            }
+
+            copy_elements(model_.texture_coordinates(), data, uint32_t(num_vertices), 2);
+
+            num_texture_coordinates_read_ = uint32_t(num_vertices);
+            return true;
+        case Number::Index:
+            num_view_indices_ = uint32_t(size / 4);
+
+            if ("UInt32" != view.encoding || uint64_t(model_.num_indices()) * 4 != size) {
+                return false;
+            }
+
+            std::memcpy(model_.indices(), data, size);
+
+            current_index_ = model_.num_indices();
+            return true;
+        default:
+            // Tangent_space is only supported as text
+            return false;
+    }
+}
+
+bool Json_size_handler::RawNumber(char const* /*str*/, rapidjson::SizeType /*length*/,
+                                  bool /*copy*/) {
+    ++counts_[uint32_t(current_)];
+
+    return true;
+}
+
+bool Json_size_handler::Key(char const* str, rapidjson::SizeType /*length*/, bool /*copy*/) {
+    std::string_view const name(str);
+
+    if ("positions" == name) {
+        current_ = Array::Position;
+    } else if ("normals" == name) {
+        current_ = Array::Normal;
+    } else if ("tangents_and_bitangent_signs" == name || "tangent_space" == name) {
+        current_ = Array::Tangent;
+    } else if ("texture_coordinates_0" == name) {
+        current_ = Array::Texture_coordinate;
+    } else if ("indices" == name) {
+        current_ = Array::Index;
+    } else {
+        current_ = Array::Undefined;
+    }
+
+    return true;
+}
+
+Json_handler::Sizes Json_size_handler::sizes() const {
+    uint64_t const num_vertices = std::max(
+        {counts_[uint32_t(Array::Position)] / 3, counts_[uint32_t(Array::Normal)] / 3,
+         counts_[uint32_t(Array::Tangent)] / 4, counts_[uint32_t(Array::Texture_coordinate)] / 2});
+
+    return {uint32_t(num_vertices), uint32_t(counts_[uint32_t(Array::Index)])};
+}
+
 }  // namespace model
@@ -1,8 +1,9 @@
 #ifndef SU_CORE_SCENE_SHAPE_TRIANGLE_JSON_HANDLER_HPP
 #define SU_CORE_SCENE_SHAPE_TRIANGLE_JSON_HANDLER_HPP
 
+#include "base/math/quaternion.hpp"
+#include "base/math/vector3.hpp"
 #include "rapidjson/reader.h"
-#include "shape_vertex.hpp"
 
 #include <cstdint>
 #include <string>
@@ -10,16 +11,6 @@
 
 namespace model {
 
-struct Index_triangle {
-    Index_triangle() = default;
-
-    Index_triangle(uint32_t a, uint32_t b, uint32_t c, uint32_t p) : i{a, b, c}, part(p) {}
-
-    uint32_t i[3];
-
-    uint32_t part;
-};
-
 struct Part {
     Part() = default;
     Part(uint32_t start_index, uint32_t num_indices, uint32_t material_index)
@@ -30,12 +21,33 @@ struct Part {
     uint32_t material_index;
 };
 
+struct Instance {
+    uint32_t part;
+
+    float3     position;
+    Quaternion rotation;
+};
+
+class Model;
+
+// Writes vertices and indices straight into the arrays of a Model.
+// The arrays are sized from "num_vertices" in "vertices" and from the parts, which can be too
+// few indices; num_indices_found() then tells how many a second pass needs. If either is
+// missing when the first array starts, parsing stops and missing_sizes() returns true;
+// the sizes then have to come from Json_size_handler and a second pass.
+// Instead of a JSON array every vertex array and the indices can be a buffer view,
+// {"encoding", "base64"} inline or {"encoding", "offset", "size"} into the file named by
+// "buffer" in "geometry". The latter are copied by read_buffer() after parsing.
 class Json_handler {
   public:
-    Json_handler();
+    struct Sizes {
+        uint32_t num_vertices = 0;
+        uint32_t num_indices  = 0;
+    };
+
+    Json_handler(Model& model, Sizes const& sizes);
 
     void clear(bool read_indices = true);
-    void create_part();
 
     bool Null();
     bool Bool(bool b);
@@ -52,26 +64,41 @@ class Json_handler {
     bool StartArray();
     bool EndArray(size_t elementCount);
 
+    bool missing_sizes() const;
+
     bool has_positions() const;
     bool has_normals() const;
     bool has_tangents() const;
     bool has_texture_coordinates() const;
 
+    uint32_t num_indices_read() const;
+
+    // Whether the size of the index array came from the parts, and might be wrong
+    bool guessed_num_indices() const;
+
+    // Number of indices in the file, including the ones that didn't fit
+    uint32_t num_indices_found() const;
+
+    // Whether every present vertex attribute supplied exactly num_vertices elements, and the
+    // indices exactly fill the index array
+    bool complete() const;
+
     const std::vector<Part>& parts() const;
     std::vector<Part>&       parts();
 
-    const std::vector<Index_triangle>& triangles() const;
-    std::vector<Index_triangle>&       triangles();
-
-    const std::vector<Vertex>& vertices() const;
-    std::vector<Vertex>&       vertices();
+    const std::vector<Instance>& instances() const;
 
     const std::vector<std::string>& morph_targets() const;
 
+    std::string const& buffer_file() const;
+
+    bool read_buffer(uint8_t const* data, uint64_t size);
+
   private:
-    void add_index(uint32_t i);
+    bool prepare_vertices();
+    bool prepare_indices();
 
-    void increment_triangle_element();
+    void add_index(uint32_t i);
 
     void handle_vertex(float v);
 
@@ -80,26 +107,71 @@ class Json_handler {
     void add_tangent(float v);
     void add_tangent_space(float v);
     void add_texture_coordinate(float v);
+    void add_instance_position(float v);
+    void add_instance_rotation(float v);
 
     void increment_vertex_element(uint32_t num_elements);
 
+    void end_vertex_array();
+
+    bool end_buffer_view();
+
     enum class Number {
         Undefined,
         Material_index,
         Start_index,
         Num_indices,
+        Num_vertices,
+        Instance_part,
+        Instance_position,
+        Instance_rotation,
         Index,
         Position,
         Texture_coordinate_0,
         Normal,
         Tangent,
         Tangent_space,
+        Buffer_view_offset,
+        Buffer_view_size,
         Ignore
     };
 
-    enum class String_type { Undefined, Morph_target };
+    enum class String_type {
+        Undefined,
+        Morph_target,
+        Buffer_file,
+        Buffer_view_encoding,
+        Buffer_view_base64
+    };
 
-    enum class Object { Undefined, Geometry, Morph_targets, Part, Vertices };
+    enum class Object {
+        Undefined,
+        Geometry,
+        Morph_targets,
+        Part,
+        Instance,
+        Transformation,
+        Vertices,
+        Buffer,
+        Buffer_view
+    };
+
+    struct Buffer_view {
+        Number target;
+
+        std::string encoding;
+
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    bool read_buffer_view(Buffer_view const& view, uint8_t const* data, uint64_t size);
+
+    Model& model_;
+
+    Sizes sizes_;
+
+    bool missing_sizes_;
 
     bool read_indices_;
 
@@ -108,16 +180,18 @@ class Json_handler {
 
     std::vector<Part> parts_;
 
-    std::vector<Index_triangle> triangles_;
-
-    std::vector<Vertex> vertices_;
+    std::vector<Instance> instances_;
 
     Number      expected_number_;
     String_type expected_string_;
     Object      expected_object_;
 
-    uint32_t current_triangle_;
-    uint32_t current_triangle_element_;
+    uint32_t current_index_;
+
+    bool guessed_num_indices_;
+
+    // From the size of a buffer view
+    uint32_t num_view_indices_;
 
     uint32_t current_vertex_;
     uint32_t current_vertex_element_;
@@ -129,7 +203,39 @@ class Json_handler {
     bool has_tangents_;
     bool has_texture_coordinates_;
 
+    // Complete elements read per attribute
+    uint32_t num_positions_read_;
+    uint32_t num_normals_read_;
+    uint32_t num_tangents_read_;
+    uint32_t num_texture_coordinates_read_;
+
     std::vector<std::string> morph_targets_;
+
+    std::string buffer_file_;
+
+    std::vector<Buffer_view> buffer_views_;
+
+    Buffer_view current_view_;
+
+    std::vector<uint8_t> current_view_data_;
+};
+
+// Cheap first pass for files without size metadata: counts the numbers of the vertex arrays and
+// the indices, without converting them.
+class Json_size_handler
+    : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, Json_size_handler> {
+  public:
+    bool RawNumber(char const* str, rapidjson::SizeType length, bool copy);
+    bool Key(char const* str, rapidjson::SizeType length, bool copy);
+
+    Json_handler::Sizes sizes() const;
+
+  private:
+    enum class Array { Undefined, Position, Normal, Tangent, Texture_coordinate, Index };
+
+    Array current_ = Array::Undefined;
+
+    uint64_t counts_[6] = {0, 0, 0, 0, 0, 0};
 };
 
 }  // namespace model
@@ -0,0 +1,573 @@
+#include "bc.hpp"
+#include "base/math/vector4.inl"
+#include "image.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace texture {
+
+uint32_t block_size(Format format) noexcept {
+    switch (format) {
+        case Format::BC1:
+        case Format::BC4:
+            return 8;
+        case Format::BC5:
+        case Format::BC7:
+            return 16;
+    }
+
+    return 0;
+}
+
+uint64_t num_bytes(Format format, uint32_t width, uint32_t height) noexcept {
+    return uint64_t((width + 3) / 4) * uint64_t((height + 3) / 4) * block_size(format);
+}
+
+void encode(Image const& image, Format format, uint8_t* destination) noexcept {
+    uint32_t const size = block_size(format);
+
+    uint32_t const num_blocks_x = (image.width() + 3) / 4;
+    uint32_t const num_blocks_y = (image.height() + 3) / 4;
+
+    byte4   block[16];
+    uint8_t values[16];
+
+    for (uint32_t by = 0; by < num_blocks_y; ++by) {
+        for (uint32_t bx = 0; bx < num_blocks_x; ++bx, destination += size) {
+            for (uint32_t y = 0; y < 4; ++y) {
+                for (uint32_t x = 0; x < 4; ++x) {
+                    block[y * 4 + x] = image.at(int32_t(bx * 4 + x), int32_t(by * 4 + y));
+                }
+            }
+
+            switch (format) {
+                case Format::BC1:
+                    bc::encode_bc1(block, destination);
+                    break;
+                case Format::BC4:
+                    for (uint32_t i = 0; i < 16; ++i) {
+                        values[i] = block[i][0];
+                    }
+
+                    bc::encode_bc4(values, destination);
+                    break;
+                case Format::BC5:
+                    bc::encode_bc5(block, destination);
+                    break;
+                case Format::BC7:
+                    bc::encode_bc7(block, destination);
+                    break;
+            }
+        }
+    }
+}
+
+namespace bc {
+
+static float constexpr Max_error = std::numeric_limits<float>::max();
+
+static float squared_distance(float4 const& a, float4 const& b) noexcept {
+    float4 const d = a - b;
+    return dot(d, d);
+}
+
+// Power iteration on the covariance of the first num_channels channels
+static float4 principal_axis(float4 const* points, uint32_t count, float4 const& mean,
+                             uint32_t num_channels) noexcept {
+    float covariance[4][4] = {};
+
+    for (uint32_t i = 0; i < count; ++i) {
+        float4 const d = points[i] - mean;
+
+        for (uint32_t r = 0; r < num_channels; ++r) {
+            for (uint32_t c = 0; c < num_channels; ++c) {
+                covariance[r][c] += d[r] * d[c];
+            }
+        }
+    }
+
+    // Start with the row of the largest variance, it cannot be orthogonal to the axis
+    uint32_t start = 0;
+    for (uint32_t r = 1; r < num_channels; ++r) {
+        if (covariance[r][r] > covariance[start][start]) {
+            start = r;
+        }
+    }
+
+    float4 axis(covariance[start][0], covariance[start][1], covariance[start][2],
+                covariance[start][3]);
+
+    for (uint32_t i = 0; i < 8; ++i) {
+        float4 next(0.f);
+
+        for (uint32_t r = 0; r < num_channels; ++r) {
+            for (uint32_t c = 0; c < num_channels; ++c) {
+                next[r] += covariance[r][c] * axis[c];
+            }
+        }
+
+        float const length = std::sqrt(dot(next, next));
+
+        if (length < 1e-12f) {
+            return float4(0.f);
+        }
+
+        axis = next / length;
+    }
+
+    return axis;
+}
+
+// Endpoints on the principal axis through the extreme projections
+static void initial_endpoints(float4 const* points, uint32_t count, uint32_t num_channels,
+                              float4& a, float4& b) noexcept {
+    float4 mean(0.f);
+    for (uint32_t i = 0; i < count; ++i) {
+        mean += points[i];
+    }
+
+    mean = mean / float(count);
+
+    float4 const axis = principal_axis(points, count, mean, num_channels);
+
+    float min_t = 0.f;
+    float max_t = 0.f;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        float const t = dot(points[i] - mean, axis);
+
+        min_t = std::min(t, min_t);
+        max_t = std::max(t, max_t);
+    }
+
+    a = mean + min_t * axis;
+    b = mean + max_t * axis;
+}
+
+static float4 clamp_255(float4 const& v) noexcept {
+    return float4(std::clamp(v[0], 0.f, 255.f), std::clamp(v[1], 0.f, 255.f),
+                  std::clamp(v[2], 0.f, 255.f), std::clamp(v[3], 0.f, 255.f));
+}
+
+// Least squares endpoints for fixed interpolation weights, texel i ~ (1 - w_i) * a + w_i * b
+static bool fit_endpoints(float4 const* points, float const* weights, uint32_t count, float4& a,
+                          float4& b) noexcept {
+    float  aa = 0.f;
+    float  ab = 0.f;
+    float  bb = 0.f;
+    float4 ap(0.f);
+    float4 bp(0.f);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        float const w  = weights[i];
+        float const iw = 1.f - w;
+
+        aa += iw * iw;
+        ab += iw * w;
+        bb += w * w;
+        ap += iw * points[i];
+        bp += w * points[i];
+    }
+
+    float const det = aa * bb - ab * ab;
+
+    if (std::abs(det) < 1e-6f) {
+        return false;
+    }
+
+    a = clamp_255(((bb * ap) - (ab * bp)) / det);
+    b = clamp_255(((aa * bp) - (ab * ap)) / det);
+
+    return true;
+}
+
+static uint16_t to_565(float4 const& c) noexcept {
+    uint32_t const r = uint32_t(std::clamp(std::lrint(c[0] * (31.f / 255.f)), 0l, 31l));
+    uint32_t const g = uint32_t(std::clamp(std::lrint(c[1] * (63.f / 255.f)), 0l, 63l));
+    uint32_t const b = uint32_t(std::clamp(std::lrint(c[2] * (31.f / 255.f)), 0l, 31l));
+
+    return uint16_t((r << 11) | (g << 5) | b);
+}
+
+static float4 from_565(uint16_t v) noexcept {
+    uint32_t const r = (v >> 11) & 31;
+    uint32_t const g = (v >> 5) & 63;
+    uint32_t const b = v & 31;
+
+    return float4(float((r << 3) | (r >> 2)), float((g << 2) | (g >> 4)),
+                  float((b << 3) | (b >> 2)), 0.f);
+}
+
+// Four color mode, requires c0 >= c1. For c0 == c1 all texels use c0.
+static float bc1_indices(float4 const* colors, uint16_t c0, uint16_t c1,
+                         uint32_t& indices) noexcept {
+    float4 const p0 = from_565(c0);
+    float4 const p1 = from_565(c1);
+
+    float4 const palette[4] = {p0, p1, (2.f * p0 + p1) / 3.f, (p0 + 2.f * p1) / 3.f};
+
+    uint32_t const num_entries = c0 == c1 ? 1 : 4;
+
+    float error = 0.f;
+
+    indices = 0;
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        float    min_d = Max_error;
+        uint32_t index = 0;
+
+        for (uint32_t j = 0; j < num_entries; ++j) {
+            if (float const d = squared_distance(colors[i], palette[j]); d < min_d) {
+                min_d = d;
+                index = j;
+            }
+        }
+
+        error += min_d;
+        indices |= index << (2 * i);
+    }
+
+    return error;
+}
+
+void encode_bc1(byte4 const* block, uint8_t* destination) noexcept {
+    // Alpha is ignored
+    float4 colors[16];
+    for (uint32_t i = 0; i < 16; ++i) {
+        colors[i] = float4(float(block[i][0]), float(block[i][1]), float(block[i][2]), 0.f);
+    }
+
+    float4 a;
+    float4 b;
+    initial_endpoints(colors, 16, 3, a, b);
+
+    static float constexpr Index_weights[4] = {0.f, 1.f, 1.f / 3.f, 2.f / 3.f};
+
+    float    best_error = Max_error;
+    uint16_t best_c0    = 0;
+    uint16_t best_c1    = 0;
+    uint32_t best_indices = 0;
+
+    for (uint32_t iteration = 0; iteration < 3; ++iteration) {
+        uint16_t c0 = to_565(a);
+        uint16_t c1 = to_565(b);
+
+        if (c0 < c1) {
+            std::swap(c0, c1);
+        }
+
+        uint32_t   indices;
+        float const error = bc1_indices(colors, c0, c1, indices);
+
+        if (error < best_error) {
+            best_error   = error;
+            best_c0      = c0;
+            best_c1      = c1;
+            best_indices = indices;
+        }
+
+        if (0.f == best_error || c0 == c1) {
+            break;
+        }
+
+        float weights[16];
+        for (uint32_t i = 0; i < 16; ++i) {
+            weights[i] = Index_weights[(indices >> (2 * i)) & 3];
+        }
+
+        if (!fit_endpoints(colors, weights, 16, a, b)) {
+            break;
+        }
+    }
+
+    destination[0] = uint8_t(best_c0 & 0xFF);
+    destination[1] = uint8_t(best_c0 >> 8);
+    destination[2] = uint8_t(best_c1 & 0xFF);
+    destination[3] = uint8_t(best_c1 >> 8);
+
+    for (uint32_t i = 0; i < 4; ++i) {
+        destination[4 + i] = uint8_t(best_indices >> (8 * i));
+    }
+}
+
+static void bc4_palette(uint32_t r0, uint32_t r1, uint32_t* palette) noexcept {
+    palette[0] = r0;
+    palette[1] = r1;
+
+    if (r0 > r1) {
+        for (uint32_t i = 2; i < 8; ++i) {
+            palette[i] = ((8 - i) * r0 + (i - 1) * r1 + 3) / 7;
+        }
+    } else {
+        for (uint32_t i = 2; i < 6; ++i) {
+            palette[i] = ((6 - i) * r0 + (i - 1) * r1 + 2) / 5;
+        }
+
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+static uint32_t bc4_indices(uint8_t const* values, uint32_t r0, uint32_t r1,
+                            uint64_t& indices) noexcept {
+    uint32_t palette[8];
+    bc4_palette(r0, r1, palette);
+
+    uint32_t error = 0;
+
+    indices = 0;
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t min_d = 0xFFFFFFFF;
+        uint64_t index = 0;
+
+        for (uint32_t j = 0; j < 8; ++j) {
+            int32_t const  d  = int32_t(values[i]) - int32_t(palette[j]);
+            uint32_t const dd = uint32_t(d * d);
+
+            if (dd < min_d) {
+                min_d = dd;
+                index = j;
+            }
+        }
+
+        error += min_d;
+        indices |= index << (3 * i);
+    }
+
+    return error;
+}
+
+void encode_bc4(uint8_t const* values, uint8_t* destination) noexcept {
+    uint32_t min_v = 255;
+    uint32_t max_v = 0;
+
+    // Range without the values that the six value mode represents exactly
+    uint32_t min_inner = 255;
+    uint32_t max_inner = 0;
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        uint32_t const v = values[i];
+
+        min_v = std::min(v, min_v);
+        max_v = std::max(v, max_v);
+
+        if (v > 0 && v < 255) {
+            min_inner = std::min(v, min_inner);
+            max_inner = std::max(v, max_inner);
+        }
+    }
+
+    // Eight values, r0 > r1
+    uint32_t r0 = max_v;
+    uint32_t r1 = min_v;
+
+    uint64_t indices = 0;
+    uint32_t error   = 0;
+
+    if (r0 > r1) {
+        error = bc4_indices(values, r0, r1, indices);
+    }
+
+    // Six values plus 0 and 255, r0 <= r1
+    if (r0 == r1 || (0 == min_v || 255 == max_v)) {
+        uint32_t const s0 = min_inner <= max_inner ? min_inner : min_v;
+        uint32_t const s1 = min_inner <= max_inner ? max_inner : min_v;
+
+        uint64_t   six_indices;
+        uint32_t const six_error = bc4_indices(values, s0, s1, six_indices);
+
+        if (r0 == r1 || six_error < error) {
+            r0      = s0;
+            r1      = s1;
+            indices = six_indices;
+        }
+    }
+
+    destination[0] = uint8_t(r0);
+    destination[1] = uint8_t(r1);
+
+    for (uint32_t i = 0; i < 6; ++i) {
+        destination[2 + i] = uint8_t(indices >> (8 * i));
+    }
+}
+
+void encode_bc5(byte4 const* block, uint8_t* destination) noexcept {
+    uint8_t values[16];
+
+    for (uint32_t c = 0; c < 2; ++c) {
+        for (uint32_t i = 0; i < 16; ++i) {
+            values[i] = block[i][c];
+        }
+
+        encode_bc4(values, destination + 8 * c);
+    }
+}
+
+static int32_t constexpr BC7_weights[16] = {0,  4,  9,  13, 17, 21, 26, 30,
+                                            34, 38, 43, 47, 51, 55, 60, 64};
+
+// Mode 6: one subset, 7 bit RGBA endpoints plus one p-bit per endpoint, 4 bit indices
+struct Mode6 {
+    uint32_t q[2][4];
+    uint32_t p[2];
+
+    uint8_t indices[16];
+};
+
+static float bc7_mode6_indices(float4 const* texels, Mode6& m) noexcept {
+    float4 palette[16];
+
+    int32_t e[2][4];
+    for (uint32_t s = 0; s < 2; ++s) {
+        for (uint32_t c = 0; c < 4; ++c) {
+            e[s][c] = int32_t((m.q[s][c] << 1) | m.p[s]);
+        }
+    }
+
+    for (uint32_t j = 0; j < 16; ++j) {
+        int32_t const w = BC7_weights[j];
+
+        for (uint32_t c = 0; c < 4; ++c) {
+            palette[j][c] = float(((64 - w) * e[0][c] + w * e[1][c] + 32) >> 6);
+        }
+    }
+
+    float4 const line        = palette[15] - palette[0];
+    float const  line_length = dot(line, line);
+
+    float error = 0.f;
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        // Project onto the line, then look at the neighbors to absorb rounding
+        int32_t guess = 0;
+
+        if (line_length > 0.f) {
+            float const t = dot(texels[i] - palette[0], line) / line_length;
+
+            guess = int32_t(std::lrint(std::clamp(t, 0.f, 1.f) * 15.f));
+        }
+
+        float   min_d = Max_error;
+        uint8_t index = 0;
+
+        for (int32_t j = std::max(guess - 1, 0), end = std::min(guess + 1, 15); j <= end; ++j) {
+            if (float const d = squared_distance(texels[i], palette[j]); d < min_d) {
+                min_d = d;
+                index = uint8_t(j);
+            }
+        }
+
+        error += min_d;
+        m.indices[i] = index;
+    }
+
+    return error;
+}
+
+class Bit_writer {
+  public:
+    Bit_writer(uint8_t* destination, uint32_t num_bytes) noexcept
+        : destination_(destination), position_(0) {
+        std::memset(destination, 0, num_bytes);
+    }
+
+    void put(uint32_t value, uint32_t num_bits) noexcept {
+        for (uint32_t i = 0; i < num_bits; ++i, ++position_) {
+            if ((value >> i) & 1) {
+                destination_[position_ >> 3] |= uint8_t(1 << (position_ & 7));
+            }
+        }
+    }
+
+  private:
+    uint8_t* destination_;
+
+    uint32_t position_;
+};
+
+void encode_bc7(byte4 const* block, uint8_t* destination) noexcept {
+    float4 texels[16];
+    for (uint32_t i = 0; i < 16; ++i) {
+        texels[i] = float4(block[i]);
+    }
+
+    float4 a;
+    float4 b;
+    initial_endpoints(texels, 16, 4, a, b);
+
+    float best_error = Max_error;
+    Mode6 best = {};
+
+    for (uint32_t iteration = 0; iteration < 3; ++iteration) {
+        for (uint32_t pbits = 0; pbits < 4; ++pbits) {
+            Mode6 m;
+
+            m.p[0] = pbits & 1;
+            m.p[1] = pbits >> 1;
+
+            for (uint32_t c = 0; c < 4; ++c) {
+                m.q[0][c] = uint32_t(
+                    std::clamp(std::lrint((a[c] - float(m.p[0])) * 0.5f), 0l, 127l));
+                m.q[1][c] = uint32_t(
+                    std::clamp(std::lrint((b[c] - float(m.p[1])) * 0.5f), 0l, 127l));
+            }
+
+            if (float const error = bc7_mode6_indices(texels, m); error < best_error) {
+                best_error = error;
+                best       = m;
+            }
+        }
+
+        if (0.f == best_error) {
+            break;
+        }
+
+        float weights[16];
+        for (uint32_t i = 0; i < 16; ++i) {
+            weights[i] = float(BC7_weights[best.indices[i]]) / 64.f;
+        }
+
+        if (!fit_endpoints(texels, weights, 16, a, b)) {
+            break;
+        }
+    }
+
+    // The most significant index bit of the first texel is implicitly 0
+    if (best.indices[0] >= 8) {
+        for (uint32_t c = 0; c < 4; ++c) {
+            std::swap(best.q[0][c], best.q[1][c]);
+        }
+
+        std::swap(best.p[0], best.p[1]);
+
+        for (uint32_t i = 0; i < 16; ++i) {
+            best.indices[i] = uint8_t(15 - best.indices[i]);
+        }
+    }
+
+    Bit_writer writer(destination, 16);
+
+    writer.put(1 << 6, 7);
+
+    for (uint32_t c = 0; c < 4; ++c) {
+        writer.put(best.q[0][c], 7);
+        writer.put(best.q[1][c], 7);
+    }
+
+    writer.put(best.p[0], 1);
+    writer.put(best.p[1], 1);
+
+    writer.put(best.indices[0], 3);
+
+    for (uint32_t i = 1; i < 16; ++i) {
+        writer.put(best.indices[i], 4);
+    }
+}
+
+}  // namespace bc
+
+}  // namespace texture
@@ -0,0 +1,43 @@
+#ifndef SU_CORE_TEXTURE_BC_HPP
+#define SU_CORE_TEXTURE_BC_HPP
+
+#include "base/math/vector4.hpp"
+
+#include <cstdint>
+
+namespace texture {
+
+class Image;
+
+enum class Format {
+    BC1,  // RGB, 565 endpoints, 4 bpp
+    BC4,  // R, 8 bpp
+    BC5,  // RG, 8 bpp
+    BC7   // RGBA, mode 6 only, 8 bpp
+};
+
+// Bytes per 4 x 4 block
+uint32_t block_size(Format format) noexcept;
+
+uint64_t num_bytes(Format format, uint32_t width, uint32_t height) noexcept;
+
+// Blocks in row-major order. Blocks crossing the right or bottom edge repeat the last column or row.
+void encode(Image const& image, Format format, uint8_t* destination) noexcept;
+
+namespace bc {
+
+// block is 16 texels in row-major order
+
+void encode_bc1(byte4 const* block, uint8_t* destination) noexcept;
+
+void encode_bc4(uint8_t const* values, uint8_t* destination) noexcept;
+
+void encode_bc5(byte4 const* block, uint8_t* destination) noexcept;
+
+void encode_bc7(byte4 const* block, uint8_t* destination) noexcept;
+
+}  // namespace bc
+
+}  // namespace texture
+
+#endif
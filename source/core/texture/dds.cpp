@@ -0,0 +1,131 @@
+#include "dds.hpp"
+#include "bc.hpp"
+
+#include <fstream>
+
+namespace texture::dds {
+
+// https://docs.microsoft.com/en-us/windows/win32/direct3ddds/dds-header
+
+struct Pixel_format {
+    uint32_t size;
+    uint32_t flags;
+    uint32_t four_cc;
+    uint32_t rgb_bit_count;
+    uint32_t r_bit_mask;
+    uint32_t g_bit_mask;
+    uint32_t b_bit_mask;
+    uint32_t a_bit_mask;
+};
+
+struct Header {
+    uint32_t size;
+    uint32_t flags;
+    uint32_t height;
+    uint32_t width;
+    uint32_t pitch_or_linear_size;
+    uint32_t depth;
+    uint32_t mip_map_count;
+    uint32_t reserved1[11];
+
+    Pixel_format pixel_format;
+
+    uint32_t caps;
+    uint32_t caps2;
+    uint32_t caps3;
+    uint32_t caps4;
+    uint32_t reserved2;
+};
+
+struct Header_DXT10 {
+    uint32_t dxgi_format;
+    uint32_t resource_dimension;
+    uint32_t misc_flag;
+    uint32_t array_size;
+    uint32_t misc_flags2;
+};
+
+static_assert(124 == sizeof(Header));
+static_assert(20 == sizeof(Header_DXT10));
+
+static uint32_t constexpr DDSD_caps         = 0x1;
+static uint32_t constexpr DDSD_height       = 0x2;
+static uint32_t constexpr DDSD_width        = 0x4;
+static uint32_t constexpr DDSD_pixel_format = 0x1000;
+static uint32_t constexpr DDSD_mip_count    = 0x20000;
+static uint32_t constexpr DDSD_linear_size  = 0x80000;
+
+static uint32_t constexpr DDPF_four_cc = 0x4;
+
+static uint32_t constexpr DDSCAPS_complex = 0x8;
+static uint32_t constexpr DDSCAPS_texture = 0x1000;
+static uint32_t constexpr DDSCAPS_mip_map = 0x400000;
+
+static uint32_t constexpr Resource_dimension_texture_2D = 3;
+
+static uint32_t constexpr four_cc(char a, char b, char c, char d) noexcept {
+    return uint32_t(a) | (uint32_t(b) << 8) | (uint32_t(c) << 16) | (uint32_t(d) << 24);
+}
+
+static uint32_t dxgi_format(Format format, bool srgb) noexcept {
+    switch (format) {
+        case Format::BC1:
+            return srgb ? 72 : 71;
+        case Format::BC4:
+            return 80;
+        case Format::BC5:
+            return 83;
+        case Format::BC7:
+            return srgb ? 99 : 98;
+    }
+
+    return 0;
+}
+
+bool write(std::string const& name, Format format, bool srgb, uint32_t width, uint32_t height,
+           uint32_t num_levels, uint8_t const* data, uint64_t size) noexcept {
+    std::ofstream stream(name, std::ios::binary);
+
+    if (!stream) {
+        return false;
+    }
+
+    Header header = {};
+
+    header.size   = sizeof(Header);
+    header.flags  = DDSD_caps | DDSD_height | DDSD_width | DDSD_pixel_format | DDSD_linear_size;
+    header.height = height;
+    header.width  = width;
+
+    header.pitch_or_linear_size = uint32_t(num_bytes(format, width, height));
+
+    header.mip_map_count = num_levels;
+
+    header.pixel_format.size    = sizeof(Pixel_format);
+    header.pixel_format.flags   = DDPF_four_cc;
+    header.pixel_format.four_cc = four_cc('D', 'X', '1', '0');
+
+    header.caps = DDSCAPS_texture;
+
+    if (num_levels > 1) {
+        header.flags |= DDSD_mip_count;
+        header.caps |= DDSCAPS_complex | DDSCAPS_mip_map;
+    }
+
+    Header_DXT10 header_dxt10 = {};
+
+    header_dxt10.dxgi_format        = dxgi_format(format, srgb);
+    header_dxt10.resource_dimension = Resource_dimension_texture_2D;
+    header_dxt10.array_size         = 1;
+
+    uint32_t const magic = four_cc('D', 'D', 'S', ' ');
+
+    stream.write(reinterpret_cast<char const*>(&magic), sizeof(uint32_t));
+    stream.write(reinterpret_cast<char const*>(&header), sizeof(Header));
+    stream.write(reinterpret_cast<char const*>(&header_dxt10), sizeof(Header_DXT10));
+    stream.write(reinterpret_cast<char const*>(data), std::streamsize(size));
+
+    return bool(stream);
+}
+
+}  // namespace texture::dds
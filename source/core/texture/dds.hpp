@@ -0,0 +1,21 @@
+#ifndef SU_CORE_TEXTURE_DDS_HPP
+#define SU_CORE_TEXTURE_DDS_HPP
+
+#include <cstdint>
+#include <string>
+
+namespace texture {
+
+enum class Format;
+
+namespace dds {
+
+// 2D texture with DX10 header. data holds num_levels block compressed mip levels, largest first.
+bool write(std::string const& name, Format format, bool srgb, uint32_t width, uint32_t height,
+           uint32_t num_levels, uint8_t const* data, uint64_t size) noexcept;
+
+}  // namespace dds
+
+}  // namespace texture
+
+#endif
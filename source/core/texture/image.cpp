@@ -0,0 +1,134 @@
+#include "image.hpp"
+#include "base/math/vector4.inl"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// Assimp compiles its own copy of stb_image, STB_IMAGE_STATIC keeps the two apart
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#pragma GCC diagnostic ignored "-Wsign-compare"
+#endif
+
+#include "stb_image.h"
+
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+namespace texture {
+
+static float srgb_to_linear(float c) noexcept {
+    if (c <= 0.04045f) {
+        return c / 12.92f;
+    }
+
+    return std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+sRGB_table::sRGB_table() noexcept {
+    for (uint32_t i = 0; i < 256; ++i) {
+        values[i] = srgb_to_linear(float(i) / 255.f);
+    }
+}
+
+sRGB_table const sRGB_to_linear;
+
+Image::Image() noexcept : width_(0), height_(0), pixels_(nullptr) {}
+
+Image::Image(uint32_t width, uint32_t height) noexcept
+    : width_(width), height_(height), pixels_(new byte4[width * height]) {}
+
+Image::Image(Image&& other) noexcept
+    : width_(other.width_), height_(other.height_), pixels_(other.pixels_) {
+    other.width_  = 0;
+    other.height_ = 0;
+    other.pixels_ = nullptr;
+}
+
+Image::~Image() noexcept {
+    delete[] pixels_;
+}
+
+Image& Image::operator=(Image&& other) noexcept {
+    std::swap(width_, other.width_);
+    std::swap(height_, other.height_);
+    std::swap(pixels_, other.pixels_);
+
+    return *this;
+}
+
+uint32_t Image::width() const noexcept {
+    return width_;
+}
+
+uint32_t Image::height() const noexcept {
+    return height_;
+}
+
+byte4 const* Image::pixels() const noexcept {
+    return pixels_;
+}
+
+byte4* Image::pixels() noexcept {
+    return pixels_;
+}
+
+byte4 Image::at(int32_t x, int32_t y) const noexcept {
+    x = std::clamp(x, 0, int32_t(width_) - 1);
+    y = std::clamp(y, 0, int32_t(height_) - 1);
+
+    return pixels_[y * width_ + x];
+}
+
+bool Image::is_grayscale() const noexcept {
+    for (uint32_t i = 0, len = width_ * height_; i < len; ++i) {
+        byte4 const p = pixels_[i];
+
+        if (p[0] != p[1] || p[0] != p[2]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Image::is_opaque() const noexcept {
+    for (uint32_t i = 0, len = width_ * height_; i < len; ++i) {
+        if (255 != pixels_[i][3]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool read(std::string const& name, Image& image) noexcept {
+    int width;
+    int height;
+    int num_channels;
+
+    uint8_t* data = stbi_load(name.c_str(), &width, &height, &num_channels, 4);
+
+    if (!data) {
+        std::cout << "Could not read \"" << name << "\": " << stbi_failure_reason() << std::endl;
+        return false;
+    }
+
+    image = Image(uint32_t(width), uint32_t(height));
+
+    std::memcpy(image.pixels(), data, uint64_t(width) * uint64_t(height) * 4);
+
+    stbi_image_free(data);
+
+    return true;
+}
+
+}  // namespace texture
@@ -0,0 +1,59 @@
+#ifndef SU_CORE_TEXTURE_IMAGE_HPP
+#define SU_CORE_TEXTURE_IMAGE_HPP
+
+#include "base/math/vector4.hpp"
+
+#include <cstdint>
+#include <string>
+
+namespace texture {
+
+// 8 bit RGBA, rows from top to bottom
+class Image {
+  public:
+    Image() noexcept;
+
+    Image(uint32_t width, uint32_t height) noexcept;
+
+    Image(Image&& other) noexcept;
+
+    Image(Image const& other) = delete;
+
+    ~Image() noexcept;
+
+    Image& operator=(Image&& other) noexcept;
+
+    uint32_t width() const noexcept;
+    uint32_t height() const noexcept;
+
+    byte4 const* pixels() const noexcept;
+    byte4*       pixels() noexcept;
+
+    // Coordinates are clamped to the edges
+    byte4 at(int32_t x, int32_t y) const noexcept;
+
+    bool is_grayscale() const noexcept;
+    bool is_opaque() const noexcept;
+
+  private:
+    uint32_t width_;
+    uint32_t height_;
+
+    byte4* pixels_;
+};
+
+// Linear values of all 8 bit sRGB channel values
+struct sRGB_table {
+    sRGB_table() noexcept;
+
+    float values[256];
+};
+
+extern sRGB_table const sRGB_to_linear;
+
+// Everything stb_image decodes (PNG, JPEG, TGA, BMP, PSD, GIF, HDR, PNM), converted to 8 bit RGBA
+bool read(std::string const& name, Image& image) noexcept;
+
+}  // namespace texture
+
+#endif
@@ -0,0 +1,100 @@
+#include "mipmap.hpp"
+#include "base/math/vector3.inl"
+#include "base/math/vector4.inl"
+#include "image.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace texture {
+
+static float linear_to_srgb(float c) noexcept {
+    if (c <= 0.0031308f) {
+        return 12.92f * c;
+    }
+
+    return 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+}
+
+static uint8_t to_byte(float c) noexcept {
+    return uint8_t(std::lrint(std::clamp(c, 0.f, 1.f) * 255.f));
+}
+
+uint32_t num_mip_levels(uint32_t width, uint32_t height) noexcept {
+    uint32_t num_levels = 1;
+
+    for (uint32_t size = std::max(width, height); size > 1; size /= 2) {
+        ++num_levels;
+    }
+
+    return num_levels;
+}
+
+void downsample(Image const& source, Image& target, Filter filter) noexcept {
+    uint32_t const source_width  = source.width();
+    uint32_t const source_height = source.height();
+
+    uint32_t const width  = std::max(source_width / 2, 1u);
+    uint32_t const height = std::max(source_height / 2, 1u);
+
+    target = Image(width, height);
+
+    byte4* pixels = target.pixels();
+
+    for (uint32_t y = 0; y < height; ++y) {
+        uint32_t const y0 = 2 * y;
+        uint32_t const y1 = height - 1 == y ? source_height : std::min(y0 + 2, source_height);
+
+        for (uint32_t x = 0; x < width; ++x) {
+            uint32_t const x0 = 2 * x;
+            uint32_t const x1 = width - 1 == x ? source_width : std::min(x0 + 2, source_width);
+
+            float4 sum(0.f);
+
+            for (uint32_t sy = y0; sy < y1; ++sy) {
+                for (uint32_t sx = x0; sx < x1; ++sx) {
+                    byte4 const p = source.at(int32_t(sx), int32_t(sy));
+
+                    float4 c = float4(p) / 255.f;
+
+                    if (Filter::sRGB == filter) {
+                        c = float4(sRGB_to_linear.values[p[0]], sRGB_to_linear.values[p[1]],
+                                   sRGB_to_linear.values[p[2]], c[3]);
+                    } else if (Filter::Normal == filter) {
+                        float const nx = 2.f * c[0] - 1.f;
+                        float const ny = 2.f * c[1] - 1.f;
+                        float const nz = std::sqrt(std::max(1.f - nx * nx - ny * ny, 0.f));
+
+                        c = float4(nx, ny, nz, c[3]);
+                    }
+
+                    sum += c;
+                }
+            }
+
+            float4 const c = sum / float((x1 - x0) * (y1 - y0));
+
+            byte4 result;
+
+            if (Filter::sRGB == filter) {
+                result = byte4(to_byte(linear_to_srgb(c[0])), to_byte(linear_to_srgb(c[1])),
+                               to_byte(linear_to_srgb(c[2])), to_byte(c[3]));
+            } else if (Filter::Normal == filter) {
+                float const length = std::sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+
+                // Opposing normals cancel out, fall back to the unperturbed one
+                float3 const n = length > 1e-6f ? float3(c[0], c[1], c[2]) / length
+                                                : float3(0.f, 0.f, 1.f);
+
+                result = byte4(to_byte(0.5f * n[0] + 0.5f), to_byte(0.5f * n[1] + 0.5f),
+                               to_byte(0.5f * n[2] + 0.5f), to_byte(c[3]));
+            } else {
+                result = byte4(to_byte(c[0]), to_byte(c[1]), to_byte(c[2]), to_byte(c[3]));
+            }
+
+            pixels[y * width + x] = result;
+        }
+    }
+}
+
+}  // namespace texture
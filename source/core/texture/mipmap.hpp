@@ -0,0 +1,26 @@
+#ifndef SU_CORE_TEXTURE_MIPMAP_HPP
+#define SU_CORE_TEXTURE_MIPMAP_HPP
+
+#include <cstdint>
+
+namespace texture {
+
+class Image;
+
+// How texels are averaged
+enum class Filter {
+    sRGB,    // RGB in linear space, alpha as is
+    Linear,  // All channels as is
+    Normal   // XY in RG, the averaged normal is renormalized
+};
+
+// Down to 1 x 1, including the base level
+uint32_t num_mip_levels(uint32_t width, uint32_t height) noexcept;
+
+// 2 x 2 box filter to max(1, size / 2) in each dimension.
+// The last row or column of odd sizes is folded into the texels next to it.
+void downsample(Image const& source, Image& target, Filter filter) noexcept;
+
+}  // namespace texture
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef SU_CORE_TEXTURE_PATH_HPP
+#define SU_CORE_TEXTURE_PATH_HPP
+
+#include <string>
+
+namespace texture {
+
+// Assimp names textures embedded in the model file "*0", "*1", ...
+static inline bool is_embedded(std::string const& path) noexcept {
+    return !path.empty() && '*' == path[0];
+}
+
+// path relative to directory, unless it is absolute
+static inline std::string resolve(std::string const& directory, std::string const& path) noexcept {
+    bool const absolute = (!path.empty() && '/' == path[0]) || (path.size() > 1 && ':' == path[1]);
+
+    if (directory.empty() || absolute) {
+        return path;
+    }
+
+    return '/' == directory.back() ? directory + path : directory + "/" + path;
+}
+
+}  // namespace texture
+
+#endif
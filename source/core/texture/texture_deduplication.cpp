@@ -0,0 +1,182 @@
+#include "texture_deduplication.hpp"
+#include "base/hash/hash.hpp"
+#include "base/thread/thread_pool.hpp"
+#include "core/model/model.hpp"
+#include "path.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <vector>
+
+namespace texture {
+
+using Material = model::Model::Material;
+
+static std::string Material::*const Texture_members[] = {
+    &Material::mask_texture,      &Material::color_texture,    &Material::normal_texture,
+    &Material::roughness_texture, &Material::specular_texture, &Material::shininess_texture,
+    &Material::emission_texture};
+
+static uint32_t constexpr Chunk_size = 1 << 20;
+
+struct File {
+    std::string path;
+
+    uint64_t size;
+    uint64_t hash;
+
+    uint32_t canonical;
+
+    bool readable;
+};
+
+static bool hash_file(std::string const& name, uint64_t& size, uint64_t& hash) noexcept;
+
+static bool same_content(std::string const& a, std::string const& b) noexcept;
+
+Deduplication deduplicate(model::Model& model, std::string const& source_directory,
+                          thread::Pool& threads) noexcept {
+    Material* materials = model.materials();
+
+    uint32_t const num_materials = model.num_materials();
+
+    // Distinct paths in order of first appearance, that order picks the canonical file
+    std::vector<File> files;
+
+    std::map<std::string, uint32_t> file_ids;
+
+    for (uint32_t i = 0; i < num_materials; ++i) {
+        for (auto const member : Texture_members) {
+            std::string const& path = materials[i].*member;
+
+            if (path.empty() || is_embedded(path) || file_ids.count(path)) {
+                continue;
+            }
+
+            uint32_t const id = uint32_t(files.size());
+
+            file_ids.emplace(path, id);
+            files.push_back({path, 0, 0, id, false});
+        }
+    }
+
+    std::atomic<uint32_t> current = 0;
+
+    threads.run_parallel([&](uint32_t /*id*/) noexcept {
+        for (;;) {
+            uint32_t const f = current.fetch_add(1, std::memory_order_relaxed);
+
+            if (f >= files.size()) {
+                return;
+            }
+
+            File& file = files[f];
+
+            file.readable = hash_file(resolve(source_directory, file.path), file.size, file.hash);
+        }
+    });
+
+    Deduplication result = {0, 0, 0};
+
+    // Canonical files by size and hash, more than one only in case of a collision
+    std::map<std::pair<uint64_t, uint64_t>, std::vector<uint32_t>> canonicals;
+
+    for (uint32_t f = 0, len = uint32_t(files.size()); f < len; ++f) {
+        File& file = files[f];
+
+        if (!file.readable) {
+            continue;
+        }
+
+        ++result.num_files;
+
+        auto& candidates = canonicals[{file.size, file.hash}];
+
+        for (uint32_t const c : candidates) {
+            if (same_content(resolve(source_directory, files[c].path),
+                             resolve(source_directory, file.path))) {
+                file.canonical = c;
+                break;
+            }
+        }
+
+        if (f == file.canonical) {
+            candidates.push_back(f);
+
+            ++result.num_unique;
+        } else {
+            result.bytes_saved += file.size;
+        }
+    }
+
+    for (uint32_t i = 0; i < num_materials; ++i) {
+        for (auto const member : Texture_members) {
+            std::string& path = materials[i].*member;
+
+            if (auto const f = file_ids.find(path); file_ids.end() != f) {
+                path = files[files[f->second].canonical].path;
+            }
+        }
+    }
+
+    return result;
+}
+
+bool hash_file(std::string const& name, uint64_t& size, uint64_t& hash) noexcept {
+    std::ifstream stream(name, std::ios::binary);
+    if (!stream) {
+        return false;
+    }
+
+    std::vector<char> buffer(Chunk_size);
+
+    size = 0;
+    hash = hash::Fnv_offset_basis;
+
+    for (;;) {
+        stream.read(buffer.data(), Chunk_size);
+
+        uint64_t const count = uint64_t(stream.gcount());
+
+        if (0 == count) {
+            break;
+        }
+
+        hash = hash::fnv_1a(buffer.data(), count, hash);
+        size += count;
+    }
+
+    return !stream.bad();
+}
+
+bool same_content(std::string const& a, std::string const& b) noexcept {
+    std::ifstream stream_a(a, std::ios::binary);
+    std::ifstream stream_b(b, std::ios::binary);
+
+    if (!stream_a || !stream_b) {
+        return false;
+    }
+
+    std::vector<char> buffer_a(Chunk_size);
+    std::vector<char> buffer_b(Chunk_size);
+
+    for (;;) {
+        stream_a.read(buffer_a.data(), Chunk_size);
+        stream_b.read(buffer_b.data(), Chunk_size);
+
+        uint64_t const count = uint64_t(stream_a.gcount());
+
+        if (count != uint64_t(stream_b.gcount()) ||
+            0 != std::memcmp(buffer_a.data(), buffer_b.data(), count)) {
+            return false;
+        }
+
+        if (0 == count) {
+            return true;
+        }
+    }
+}
+
+}  // namespace texture
@@ -0,0 +1,32 @@
+#ifndef SU_CORE_TEXTURE_DEDUPLICATION_HPP
+#define SU_CORE_TEXTURE_DEDUPLICATION_HPP
+
+#include <cstdint>
+#include <string>
+
+namespace model {
+class Model;
+}
+
+namespace thread {
+class Pool;
+}
+
+namespace texture {
+
+struct Deduplication {
+    uint32_t num_files;   // Distinct readable paths
+    uint32_t num_unique;  // Distinct contents among them
+
+    uint64_t bytes_saved;  // Size of the files no material references anymore
+};
+
+// Points every texture path of the materials whose file has the same content as an earlier one at
+// that earlier path. Files are hashed in parallel, equal hashes are confirmed byte by byte.
+// Paths are resolved against source_directory, unreadable files are left alone.
+Deduplication deduplicate(model::Model& model, std::string const& source_directory,
+                          thread::Pool& threads) noexcept;
+
+}  // namespace texture
+
+#endif
@@ -0,0 +1,267 @@
+#include "texture_processor.hpp"
+#include "base/thread/thread_pool.hpp"
+#include "bc.hpp"
+#include "core/model/model.hpp"
+#include "dds.hpp"
+#include "image.hpp"
+#include "mipmap.hpp"
+#include "path.hpp"
+
+#include <atomic>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+namespace texture {
+
+enum class Usage { Color, Normal, Data };
+
+struct Job {
+    std::string source;
+    std::string target;
+
+    Usage usage;
+
+    bool converted;
+
+    // Converted for an earlier model
+    bool reused;
+};
+
+static bool convert(Job const& job, std::string const& source_directory,
+                    std::string const& target_directory,
+                    Processor::Settings const& settings) noexcept;
+
+static std::string dds_name(std::string const& path, std::string const& suffix) noexcept;
+
+static std::string extension_suffix(std::string const& path) noexcept;
+
+static std::string normalized(std::string const& path) noexcept;
+
+Processor::Processor(Settings const& settings) noexcept : settings_(settings) {}
+
+uint32_t Processor::process(model::Model& model, std::string const& source_directory,
+                            std::string const& target_directory, thread::Pool& threads) noexcept {
+    std::vector<Job> jobs;
+
+    auto find = [&jobs](std::string const& path, Usage usage) noexcept -> Job* {
+        for (auto& j : jobs) {
+            if (usage == j.usage && path == j.source) {
+                return &j;
+            }
+        }
+
+        return nullptr;
+    };
+
+    auto key = [&source_directory, &target_directory](std::string const& path,
+                                                      Usage usage) noexcept {
+        return normalized(target_directory) + '\n' + normalized(resolve(source_directory, path)) +
+               '\n' + std::to_string(uint32_t(usage));
+    };
+
+    // Other models, earlier jobs of this one, or files that existed before
+    auto taken = [this, &target_directory](std::string const& target) noexcept {
+        std::string const full = normalized(resolve(target_directory, target));
+
+        std::error_code error;
+        return targets_.count(full) > 0 || std::filesystem::exists(full, error);
+    };
+
+    auto add = [&](std::string const& path, Usage usage) noexcept {
+        // Empty, or embedded in the model file
+        if (path.empty() || is_embedded(path) || find(path, usage)) {
+            return;
+        }
+
+        if (auto const i = converted_.find(key(path, usage)); converted_.end() != i) {
+            jobs.push_back({path, i->second, usage, true, true});
+            return;
+        }
+
+        bool shared = false;
+        for (auto const& j : jobs) {
+            shared |= path == j.source;
+        }
+
+        // The same image used in different ways needs one DDS file per use
+        static char const* const Suffixes[] = {"_color", "_normal", "_data"};
+
+        std::string const suffix = shared ? Suffixes[uint32_t(usage)] : "";
+
+        std::string target = dds_name(path, suffix);
+
+        // Different images with the same stem, like wood.png and wood.jpg, keep their extension in
+        // the name, and a number if that is not enough
+        if (taken(target)) {
+            target = dds_name(path, extension_suffix(path) + suffix);
+        }
+
+        for (uint32_t n = 2; taken(target); ++n) {
+            target = dds_name(path, extension_suffix(path) + suffix + "_" + std::to_string(n));
+        }
+
+        targets_.insert(normalized(resolve(target_directory, target)));
+
+        jobs.push_back({path, target, usage, false, false});
+    };
+
+    model::Model::Material* materials = model.materials();
+
+    uint32_t const num_materials = model.num_materials();
+
+    for (uint32_t i = 0; i < num_materials; ++i) {
+        auto const& m = materials[i];
+
+        add(m.color_texture, Usage::Color);
+        add(m.emission_texture, Usage::Color);
+        add(m.normal_texture, Usage::Normal);
+        add(m.mask_texture, Usage::Data);
+        add(m.roughness_texture, Usage::Data);
+        add(m.specular_texture, Usage::Data);
+        add(m.shininess_texture, Usage::Data);
+    }
+
+    std::atomic<uint32_t> current = 0;
+
+    threads.run_parallel([&](uint32_t /*id*/) noexcept {
+        for (;;) {
+            uint32_t const j = current.fetch_add(1, std::memory_order_relaxed);
+
+            if (j >= jobs.size()) {
+                return;
+            }
+
+            if (!jobs[j].reused) {
+                jobs[j].converted = convert(jobs[j], source_directory, target_directory,
+                                            settings_);
+            }
+        }
+    });
+
+    auto rewrite = [&find](std::string& path, Usage usage) noexcept {
+        if (Job const* j = find(path, usage); j && j->converted) {
+            path = j->target;
+        }
+    };
+
+    for (uint32_t i = 0; i < num_materials; ++i) {
+        auto& m = materials[i];
+
+        rewrite(m.color_texture, Usage::Color);
+        rewrite(m.emission_texture, Usage::Color);
+        rewrite(m.normal_texture, Usage::Normal);
+        rewrite(m.mask_texture, Usage::Data);
+        rewrite(m.roughness_texture, Usage::Data);
+        rewrite(m.specular_texture, Usage::Data);
+        rewrite(m.shininess_texture, Usage::Data);
+    }
+
+    uint32_t num_converted = 0;
+    for (auto const& j : jobs) {
+        if (j.converted && !j.reused) {
+            converted_.emplace(key(j.source, j.usage), j.target);
+
+            ++num_converted;
+        }
+    }
+
+    return num_converted;
+}
+
+bool convert(Job const& job, std::string const& source_directory,
+             std::string const& target_directory, Processor::Settings const& settings) noexcept {
+    Image image;
+    if (!read(resolve(source_directory, job.source), image)) {
+        return false;
+    }
+
+    Format format;
+    Filter filter;
+
+    bool srgb = false;
+
+    switch (job.usage) {
+        case Usage::Color:
+            format = settings.bc1_for_opaque_color && image.is_opaque() ? Format::BC1
+                                                                        : Format::BC7;
+            filter = Filter::sRGB;
+            srgb   = true;
+            break;
+        case Usage::Normal:
+            format = Format::BC5;
+            filter = Filter::Normal;
+            break;
+        default:
+            // Colored data keeps all channels
+            format = image.is_grayscale() && image.is_opaque() ? Format::BC4 : Format::BC7;
+            filter = Filter::Linear;
+            break;
+    }
+
+    uint32_t const width      = image.width();
+    uint32_t const height     = image.height();
+    uint32_t const num_levels = num_mip_levels(width, height);
+
+    uint64_t size = 0;
+    for (uint32_t l = 0, w = width, h = height; l < num_levels; ++l) {
+        size += num_bytes(format, w, h);
+
+        w = std::max(w / 2, 1u);
+        h = std::max(h / 2, 1u);
+    }
+
+    std::vector<uint8_t> data(size);
+
+    // Every level is filtered from the one above
+    for (uint64_t l = 0, offset = 0; l < num_levels; ++l) {
+        encode(image, format, data.data() + offset);
+
+        offset += num_bytes(format, image.width(), image.height());
+
+        if (l + 1 < num_levels) {
+            Image next;
+            downsample(image, next, filter);
+            image = std::move(next);
+        }
+    }
+
+    std::string const target = resolve(target_directory, job.target);
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(target).parent_path(), error);
+
+    if (!dds::write(target, format, srgb, width, height, num_levels, data.data(), size)) {
+        std::cout << "Could not write \"" << target << "\"." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+std::string dds_name(std::string const& path, std::string const& suffix) noexcept {
+    size_t const slash = path.find_last_of('/');
+    size_t const dot   = path.find_last_of('.');
+
+    bool const has_extension = std::string::npos != dot &&
+                               (std::string::npos == slash || dot > slash);
+
+    return (has_extension ? path.substr(0, dot) : path) + suffix + ".dds";
+}
+
+std::string extension_suffix(std::string const& path) noexcept {
+    size_t const slash = path.find_last_of('/');
+    size_t const dot   = path.find_last_of('.');
+
+    if (std::string::npos == dot || (std::string::npos != slash && dot < slash)) {
+        return "";
+    }
+
+    return "_" + path.substr(dot + 1);
+}
+
+std::string normalized(std::string const& path) noexcept {
+    return std::filesystem::path(path).lexically_normal().generic_string();
+}
+
+}  // namespace texture
@@ -0,0 +1,53 @@
+#ifndef SU_CORE_TEXTURE_PROCESSOR_HPP
+#define SU_CORE_TEXTURE_PROCESSOR_HPP
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace model {
+class Model;
+}
+
+namespace thread {
+class Pool;
+}
+
+namespace texture {
+
+// Converts every texture referenced by the materials of a model to a DDS file with a full,
+// block compressed mip chain, and points the materials at the new files.
+// Color and emission become BC7 (or BC1) in sRGB, normal maps BC5, and grayscale data such as
+// roughness or masks BC4. Textures are converted in parallel, one task per file.
+// One Processor is meant for a whole run: models that share textures share the DDS files, and
+// no DDS file is written twice or over a file that existed before.
+class Processor {
+  public:
+    struct Settings {
+        // Half the size of BC7, for color textures without alpha
+        bool bc1_for_opaque_color = false;
+    };
+
+    Processor(Settings const& settings) noexcept;
+
+    // Texture paths are resolved against source_directory. The DDS files keep the relative path,
+    // with the extension replaced, below target_directory. Names that are taken get the original
+    // extension and if needed a number appended, e.g. wood_jpg.dds.
+    // Returns the number of converted textures, failures keep their original path.
+    uint32_t process(model::Model& model, std::string const& source_directory,
+                     std::string const& target_directory, thread::Pool& threads) noexcept;
+
+  private:
+    Settings const settings_;
+
+    // Relative DDS name by target directory, source file and usage, of everything converted
+    std::unordered_map<std::string, std::string> converted_;
+
+    // Normalized paths of all DDS files this processor chose
+    std::unordered_set<std::string> targets_;
+};
+
+}  // namespace texture
+
+#endif